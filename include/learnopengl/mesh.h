@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/MeshLod.h>
 
 #include <string>
 #include <vector>
@@ -23,16 +24,53 @@ struct Vertex {
     glm::vec3 Tangent;
     // bitangent
     glm::vec3 Bitangent;
+    // texture array layers of the mesh's diffuse (x) and specular (y) map, -1 when the mesh has none
+    glm::vec2 MaterialLayers = glm::vec2(-1.0f);
+    // up to four bones of the model's skeleton and their weights, all zero for rigid meshes
+    unsigned char BoneIds[4] = {0, 0, 0, 0};
+    glm::vec4 BoneWeights = glm::vec4(0.0f);
 };
 
 
 
 struct Texture {
-    unsigned int id;
+    unsigned int id;    // GL_TEXTURE_2D_ARRAY holding the image
+    unsigned int layer; // layer of the image inside that array
     string type;
     string path;
 };
 
+// binds the texture arrays and points the texture_diffuseN, texture_specularN, ... samplers at them
+inline void bindTextureArrays(Shader &shader, const vector<Texture> &textures, const std::string &glslIdentifierPrefix)
+{
+    unsigned int diffuseNr  = 1;
+    unsigned int specularNr = 1;
+    unsigned int normalNr   = 1;
+    unsigned int heightNr   = 1;
+    for(unsigned int i = 0; i < textures.size(); i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+        // retrieve texture number (the N in diffuse_textureN)
+        string number;
+        string name = textures[i].type;
+        if(name == "texture_diffuse")
+            number = std::to_string(diffuseNr++);
+        else if(name == "texture_specular")
+            number = std::to_string(specularNr++); // transfer unsigned int to stream
+        else if(name == "texture_normal")
+            number = std::to_string(normalNr++); // transfer unsigned int to stream
+        else if(name == "texture_height")
+            number = std::to_string(heightNr++); // transfer unsigned int to stream
+
+        // now set the sampler to the correct texture unit
+        glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
+        // and finally bind the texture
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textures[i].id);
+    }
+    // always good practice to set everything back to defaults once configured.
+    glActiveTexture(GL_TEXTURE0);
+}
+
 class Mesh {
 public:
     // mesh Data
@@ -40,100 +78,88 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
-    unsigned int VAO;
+    // vertex array of the owning model, the mesh's indices start at indexOffset in its element buffer
+    unsigned int VAO = 0;
+    unsigned int indexOffset = 0;
+    // indices of the simplified levels of detail, level 1 first, into the same vertices
+    vector<vector<unsigned int>> lodIndices;
+    // where every level, the imported indices first, lies in the element buffer
+    vector<rg::IndexRange> lods;
     std::string glslIdentifierPrefix;
-    // constructor
+    // constructor, buffers are created by the owning model once all of its meshes are known
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
-
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
     }
 
     // render the mesh
-    void Draw(Shader &shader)
+    void Draw(Shader &shader, int lod = 0)
     {
         // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-
-
-
-        // draw mesh
+        bindTextureArrays(shader, textures, glslIdentifierPrefix);
+        DrawGeometry(lod);
+    }
+
+    // draws the mesh at a level of detail with whatever textures are currently bound
+    void DrawGeometry(int lod = 0)
+    {
+        rg::IndexRange range = Lod(lod);
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, range.count, GL_UNSIGNED_INT, (void*)(range.offset * sizeof(unsigned int)));
         glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
-
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // the level's indices in the element buffer, the imported ones for levels the mesh doesn't have
+    rg::IndexRange Lod(int lod) const
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        if (lod > 0 && lod < (int) lods.size())
+            return lods[lod];
+        rg::IndexRange range;
+        range.offset = indexOffset;
+        range.count = indices.size();
+        return range;
+    }
 
-        glBindVertexArray(0);
+    // true when both meshes sample the same texture arrays on the same units
+    bool SharesTextureArrays(const Mesh &other) const
+    {
+        if (textures.size() != other.textures.size())
+            return false;
+        for (unsigned int i = 0; i < textures.size(); i++)
+            if (textures[i].id != other.textures[i].id || textures[i].type != other.textures[i].type)
+                return false;
+        return true;
     }
 };
-#endif
\ No newline at end of file
+
+// sets the vertex attribute pointers of the Vertex layout for the currently bound array buffer
+inline void setVertexAttributes()
+{
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    // vertex tangent
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+    // vertex bitangent
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    // texture array layers
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, MaterialLayers));
+    // bone indices stay integers
+    glEnableVertexAttribArray(6);
+    glVertexAttribIPointer(6, 4, GL_UNSIGNED_BYTE, sizeof(Vertex), (void*)offsetof(Vertex, BoneIds));
+    // bone weights
+    glEnableVertexAttribArray(7);
+    glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, BoneWeights));
+}
+#endif
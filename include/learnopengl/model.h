@@ -12,18 +12,64 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/Animation.h>
+#include <rg/Morph.h>
+#include <rg/Error.h>
+#include <rg/MeshCache.h>
+#include <rg/MeshLod.h>
+#include <rg/MipChain.h>
+#include <rg/StartupProfiler.h>
 
 #include <string>
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <functional>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
+#include <limits>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// all images of a model that share size and channel count are layers of one GL_TEXTURE_2D_ARRAY
+struct TextureArray {
+    unsigned int id;
+    int width, height, nrComponents;
+    vector<string> files; // layer i is decoded from files[i]
+    int levels = 1;
+    int residentLevel = 0; // finest mip level currently in memory
+};
 
+// A model's first clip, skinned or morphed, baked at import into the position and normal of every vertex
+// at a fixed rate, for models drawn in crowds only (Model::bakeAnimation). Frame f of vertex v is texel
+// (v % width, f * rows + v / width), so a frame takes rows rows of the texture. Crowds sample it by
+// gl_VertexID instead of skinning each instance. Clips too long for GL_MAX_TEXTURE_SIZE are baked at a
+// lower frame rate.
+struct VertexAnimation {
+    int frames = 0;
+    int width = 0, rows = 0;
+    float frameRate = 30.0f;
+    vector<glm::vec4> positions, normals; // until uploaded
+    unsigned int positionTexture = 0, normalTexture = 0;
+
+    // of both textures once uploaded, RGBA32F positions and RGBA16F normals
+    std::size_t Bytes() const {
+        return positionTexture == 0 ? 0 : (std::size_t) width * frames * rows * (16 + 8);
+    }
+};
+
+// Sparse morph targets in buffer textures (see rg::SparseMorphTargets), blended in the vertex shader by
+// the aMorphWeights attribute, so every draw or instance plays the same targets with its own weights.
+struct MorphTargets {
+    int count = 0;
+    rg::SparseMorphTargets sparse; // until uploaded
+    unsigned int rangeBuffer = 0, deltaBuffer = 0;
+    unsigned int rangeTexture = 0, deltaTexture = 0;
+};
 
 class Model
 {
@@ -31,34 +77,51 @@ public:
     // model data
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
+    vector<TextureArray> textureArrays;
     string directory;
     bool gammaCorrection;
+    // axis aligned bounds of all vertices in model space
+    glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    // vertex and element buffers shared by all meshes
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int indexCount = 0;
+    // true when every mesh samples the same texture arrays, the whole model is then a single draw call
+    bool singleDraw = false;
+    // levels of detail, level 0 the imported meshes: where each lies in the element buffer, all meshes in
+    // a row, and how far its simplification strayed from the imported surface, in model space
+    vector<rg::IndexRange> lods;
+    vector<float> lodErrors;
+    // joints and clips of a skinned model, null for rigid ones. Vertices are skinned in the space
+    // the meshes were modeled in, so a skinned model is placed with the same matrix as a rigid one.
+    std::shared_ptr<const rg::Skeleton> skeleton;
+    VertexAnimation vertexAnimation;
+    MorphTargets morphTargets;
+    // set before Load for models drawn in crowds, only those bake their vertexAnimation
+    bool bakeAnimation = false;
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
-        loadModel(path);
+        Load(path);
+        Upload();
+        CreateVertexArray();
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // empty model, filled in steps by Load, Upload and CreateVertexArray so that the first two can run on another thread
+    Model() : gammaCorrection(false)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
     }
 
-    void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
-        }
-    }
-private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // doesn't touch OpenGL.
+    void Load(string const &path)
     {
+        rg::StartupZone zone("assimp import", "model");
+        zone.Arg("path", path);
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_LimitBoneWeights);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -70,7 +133,215 @@ private:
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+        generateLods();
+        if (!boneNames.empty())
+            loadSkeleton(scene);
+        bakeVertexAnimation(scene);
+        sourceMeshes.clear();
+        boneNames.clear();
+        boneOffsets.clear();
+        boneWeights.clear();
+        zone.Arg("meshes", meshes.size()).Arg("textures", textures_loaded.size())
+            .Arg("bones", skeleton ? skeleton->boneNodes.size() : 0);
+    }
+
+    // decodes the textures and uploads them together with the vertex data, needs a current context
+    // that shares objects with the one the model is drawn in. With mipTailOnly the textures start
+    // out with their smallest mips only and rg::TextureStreamer brings in the finer ones.
+    void Upload(bool mipTailOnly = false)
+    {
+        if (meshes.empty())
+            return;
+        uploadTextureArrays(mipTailOnly);
+        uploadBuffers();
+        uploadVertexAnimation();
+        uploadMorphTargets();
+    }
+
+    // vertex arrays aren't shared between contexts, so this runs in the context the model is drawn in
+    void CreateVertexArray()
+    {
+        if (meshes.empty())
+            return;
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        setVertexAttributes();
+        glBindVertexArray(0);
+        rg::labelObject(GL_VERTEX_ARRAY, VAO, directory);
+
+        for (Mesh &mesh : meshes)
+            mesh.VAO = VAO;
+    }
+
+    // deletes the GL objects and drops all data, the model is empty afterwards
+    void Release()
+    {
+        for (TextureArray &array : textureArrays)
+            glDeleteTextures(1, &array.id);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteVertexArrays(1, &VAO);
+        VAO = VBO = EBO = 0;
+        indexCount = 0;
+        singleDraw = false;
+        lods.clear();
+        lodErrors.clear();
+        meshes.clear();
+        textures_loaded.clear();
+        textureArrays.clear();
+        skeleton.reset();
+        glDeleteTextures(1, &vertexAnimation.positionTexture);
+        glDeleteTextures(1, &vertexAnimation.normalTexture);
+        vertexAnimation = VertexAnimation();
+        glDeleteTextures(1, &morphTargets.rangeTexture);
+        glDeleteTextures(1, &morphTargets.deltaTexture);
+        glDeleteBuffers(1, &morphTargets.rangeBuffer);
+        glDeleteBuffers(1, &morphTargets.deltaBuffer);
+        morphTargets = MorphTargets();
+        boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    }
+
+    // false until the model is fully uploaded, and for models that failed to load
+    bool Ready() const
+    {
+        return VAO != 0;
+    }
+
+    // displacement moves a model space position to where the target puts it. Normals are recomputed from
+    // the faces before and after and only their difference is kept, so the imported smoothing stays.
+    // Doesn't touch OpenGL.
+    rg::MorphTarget BakeMorphTarget(const string &name, const std::function<glm::vec3(glm::vec3)> &displacement) const
+    {
+        rg::MorphTarget target;
+        target.name = name;
+        for (const Mesh &mesh : meshes)
+        {
+            vector<glm::vec3> rest(mesh.vertices.size()), moved(mesh.vertices.size());
+            for (size_t i = 0; i < mesh.vertices.size(); i++)
+            {
+                rest[i] = mesh.vertices[i].Position;
+                moved[i] = rest[i] + displacement(rest[i]);
+            }
+            vector<glm::vec3> restNormals = faceNormals(mesh, rest), movedNormals = faceNormals(mesh, moved);
+            for (size_t i = 0; i < mesh.vertices.size(); i++)
+            {
+                // faces wound against the imported normals turn the other way
+                float side = glm::dot(mesh.vertices[i].Normal, restNormals[i]) < 0.0f ? -1.0f : 1.0f;
+                target.positions.push_back(moved[i] - rest[i]);
+                target.normals.push_back(side * (movedNormals[i] - restNormals[i]));
+            }
+        }
+        return target;
+    }
+
+    // call between Load and Upload; only the first rg::MAX_MORPH_TARGETS are kept
+    void SetMorphTargets(const vector<rg::MorphTarget> &targets)
+    {
+        size_t vertexCount = 0;
+        for (const Mesh &mesh : meshes)
+            vertexCount += mesh.vertices.size();
+        morphTargets.sparse = rg::packMorphTargets(targets, vertexCount, 1e-4f * BoundingRadius(), 1e-3f);
+        morphTargets.count = (int) morphTargets.sparse.names.size();
+        size_t moved = 0;
+        for (const glm::ivec2 &range : morphTargets.sparse.ranges)
+            moved += range.y > 0;
+        size_t sparseBytes = morphTargets.sparse.ranges.size() * sizeof(glm::ivec2)
+                           + morphTargets.sparse.deltas.size() * sizeof(glm::vec4);
+        size_t denseBytes = (size_t) morphTargets.count * vertexCount * 2 * sizeof(glm::vec3);
+        cout << "[Morph] " << directory << ": " << morphTargets.count << " targets move " << moved << " of "
+             << vertexCount << " vertices, " << sparseBytes / 1024 << " KiB sparse, " << denseBytes / 1024
+             << " KiB dense" << endl;
+    }
+
+    // points the shader at the morph targets, if there are any
+    void BindMorphTargets(Shader &shader) const
+    {
+        shader.setBool("morphed", morphTargets.rangeTexture != 0);
+        if (morphTargets.rangeTexture == 0)
+            return;
+        glActiveTexture(GL_TEXTURE0 + rg::MORPH_RANGE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, morphTargets.rangeTexture);
+        glActiveTexture(GL_TEXTURE0 + rg::MORPH_DELTA_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, morphTargets.deltaTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // draws the model, and thus all its meshes, at a level of detail
+    void Draw(Shader &shader, int lod = 0)
+    {
+        if (!Ready())
+            return;
+        BindMorphTargets(shader);
+        if (singleDraw)
+        {
+            rg::IndexRange range = Lod(lod);
+            bindTextureArrays(shader, meshes[0].textures, meshes[0].glslIdentifierPrefix);
+            glBindVertexArray(VAO);
+            glDrawElements(GL_TRIANGLES, range.count, GL_UNSIGNED_INT, (void*)(range.offset * sizeof(unsigned int)));
+            glBindVertexArray(0);
+            return;
+        }
+        // meshes pick their images by layer, so textures only need rebinding when the arrays change
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (i == 0 || !meshes[i].SharesTextureArrays(meshes[i - 1]))
+                meshes[i].Draw(shader, lod);
+            else
+                meshes[i].DrawGeometry(lod);
+        }
+    }
+
+    // levels of detail the model has, at least the imported one once it is uploaded
+    int LodCount() const
+    {
+        return (int) lods.size();
+    }
+
+    // all meshes of a level in the element buffer, the imported ones for levels the model doesn't have
+    rg::IndexRange Lod(int lod) const
+    {
+        if (lod > 0 && lod < (int) lods.size())
+            return lods[lod];
+        rg::IndexRange range;
+        range.count = indexCount;
+        return range;
+    }
+
+    // what drawing instances of the model at a level costs, and what it would at full detail
+    rg::TriangleCount Triangles(int lod, long long instances = 1) const
+    {
+        rg::TriangleCount triangles;
+        triangles.submitted = Lod(lod).count / 3 * instances;
+        triangles.full = indexCount / 3 * instances;
+        return triangles;
+    }
+
+    void SetShaderTextureNamePrefix(std::string prefix) {
+        for (Mesh& mesh: meshes) {
+            mesh.glslIdentifierPrefix = prefix;
+        }
+    }
+
+    // center and radius of the sphere enclosing the model space bounds
+    glm::vec3 BoundingCenter() const
+    {
+        return meshes.empty() ? glm::vec3(0.0f) : 0.5f * (boundsMin + boundsMax);
+    }
+
+    float BoundingRadius() const
+    {
+        return meshes.empty() ? 0.0f : 0.5f * glm::length(boundsMax - boundsMin);
     }
+private:
+    // bones of all meshes while loading, a vertex refers to a bone by its index here
+    vector<string> boneNames;
+    vector<glm::mat4> boneOffsets;
+    vector<float> boneWeights; // summed over all vertices, picks the bone that places the mesh
+    // assimp's mesh for each of meshes while loading
+    vector<const aiMesh*> sourceMeshes;
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
     void processNode(aiNode *node, const aiScene *scene)
@@ -82,6 +353,7 @@ private:
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
             meshes.push_back(processMesh(mesh, scene));
+            sourceMeshes.push_back(mesh);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
@@ -108,6 +380,8 @@ private:
             vector.y = mesh->mVertices[i].y;
             vector.z = mesh->mVertices[i].z;
             vertex.Position = vector;
+            boundsMin = glm::min(boundsMin, vector);
+            boundsMax = glm::max(boundsMax, vector);
             // normals
             if (mesh->HasNormals())
             {
@@ -143,6 +417,7 @@ private:
 
 
         }
+        loadBoneWeights(mesh, vertices);
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
@@ -176,12 +451,359 @@ private:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-
+        // the layers travel with the vertices so meshes sharing arrays can be drawn together
+        glm::vec2 materialLayers(-1.0f);
+        if (!diffuseMaps.empty())
+            materialLayers.x = (float) diffuseMaps[0].layer;
+        if (!specularMaps.empty())
+            materialLayers.y = (float) specularMaps[0].layer;
+        for (Vertex &vertex : vertices)
+            vertex.MaterialLayers = materialLayers;
 
         // return a mesh object created from the extracted mesh data
         return Mesh(vertices, indices, textures);
     }
 
+    // gives each vertex the (at most four, see aiProcess_LimitBoneWeights) bones moving it, weights summing up to 1
+    void loadBoneWeights(aiMesh *mesh, vector<Vertex> &vertices)
+    {
+        vector<unsigned char> used(vertices.size(), 0);
+        for (unsigned int i = 0; i < mesh->mNumBones; i++)
+        {
+            const aiBone *bone = mesh->mBones[i];
+            unsigned int index = std::find(boneNames.begin(), boneNames.end(), bone->mName.C_Str()) - boneNames.begin();
+            if (index == boneNames.size())
+            {
+                boneNames.push_back(bone->mName.C_Str());
+                boneOffsets.push_back(toGlm(bone->mOffsetMatrix));
+                boneWeights.push_back(0.0f);
+            }
+            for (unsigned int j = 0; j < bone->mNumWeights; j++)
+            {
+                const aiVertexWeight &weight = bone->mWeights[j];
+                if (weight.mVertexId >= vertices.size() || used[weight.mVertexId] == 4 || weight.mWeight <= 0.0f)
+                    continue;
+                Vertex &vertex = vertices[weight.mVertexId];
+                vertex.BoneIds[used[weight.mVertexId]] = (unsigned char) std::min(index, (unsigned int) rg::MAX_BONES - 1);
+                vertex.BoneWeights[used[weight.mVertexId]++] = weight.mWeight;
+                boneWeights[index] += weight.mWeight;
+            }
+        }
+        if (mesh->mNumBones == 0)
+            return;
+        for (Vertex &vertex : vertices)
+        {
+            float sum = vertex.BoneWeights.x + vertex.BoneWeights.y + vertex.BoneWeights.z + vertex.BoneWeights.w;
+            // a vertex no bone moves would collapse to the origin, it follows the first bone instead
+            if (sum > 0.0f)
+                vertex.BoneWeights /= sum;
+            else
+                vertex.BoneWeights = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+        }
+    }
+
+    // flattens the node tree, finds the bones in it and converts the animations, keys go from ticks to seconds
+    void loadSkeleton(const aiScene *scene)
+    {
+        if (boneNames.size() > (unsigned int) rg::MAX_BONES)
+        {
+            cout << "ERROR::MODEL:: " << directory << " has " << boneNames.size() << " bones, at most "
+                 << rg::MAX_BONES << " are supported, it is drawn rigid" << endl;
+            return;
+        }
+        std::shared_ptr<rg::Skeleton> built = std::make_shared<rg::Skeleton>();
+        addSkeletonNode(scene->mRootNode, -1, *built);
+        for (unsigned int i = 0; i < boneNames.size(); i++)
+        {
+            int node = built->FindNode(boneNames[i]);
+            if (node < 0)
+            {
+                cout << "ERROR::MODEL:: bone " << boneNames[i] << " of " << directory << " has no node" << endl;
+                return;
+            }
+            built->boneNodes.push_back(node);
+            built->inverseBind.push_back(boneOffsets[i]);
+        }
+
+        for (unsigned int i = 0; i < scene->mNumAnimations; i++)
+        {
+            const aiAnimation *animation = scene->mAnimations[i];
+            double ticksPerSecond = animation->mTicksPerSecond != 0.0 ? animation->mTicksPerSecond : 25.0;
+            rg::AnimationClip clip;
+            clip.name = animation->mName.C_Str();
+            clip.duration = (float) (animation->mDuration / ticksPerSecond);
+            for (unsigned int j = 0; j < animation->mNumChannels; j++)
+            {
+                const aiNodeAnim *channel = animation->mChannels[j];
+                rg::AnimationTrack track;
+                track.node = built->FindNode(channel->mNodeName.C_Str());
+                if (track.node < 0)
+                    continue;
+                for (unsigned int k = 0; k < channel->mNumPositionKeys; k++)
+                {
+                    const aiVectorKey &key = channel->mPositionKeys[k];
+                    track.translation.times.push_back((float) (key.mTime / ticksPerSecond));
+                    track.translation.values.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+                }
+                for (unsigned int k = 0; k < channel->mNumRotationKeys; k++)
+                {
+                    const aiQuatKey &key = channel->mRotationKeys[k];
+                    track.rotation.times.push_back((float) (key.mTime / ticksPerSecond));
+                    track.rotation.values.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+                }
+                for (unsigned int k = 0; k < channel->mNumScalingKeys; k++)
+                {
+                    const aiVectorKey &key = channel->mScalingKeys[k];
+                    track.scale.times.push_back((float) (key.mTime / ticksPerSecond));
+                    track.scale.values.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+                }
+                clip.tracks.push_back(std::move(track));
+            }
+            built->compressedClips.push_back(rg::compressClip(clip, built->restPose));
+            // the imported keys go with clip, only the compressed ones stay
+            if (rg::clipReports())
+                rg::printClipReport(directory, *built, clip, built->compressedClips.back());
+        }
+
+        // Exporters tend to put the skin under a few nodes rotating and scaling the armature, and
+        // the mesh's vertices aren't in the root's space then. The bone carrying most of the weight
+        // lands on exactly its vertices in the rest pose, undoing that maps the posed mesh back.
+        vector<glm::mat4> restPalette(boneNames.size());
+        rg::PoseEvaluator().Evaluate(*built, restPalette.data());
+        unsigned int heaviest = std::max_element(boneWeights.begin(), boneWeights.end()) - boneWeights.begin();
+        built->meshFromRoot = glm::inverse(restPalette[heaviest]);
+        skeleton = built;
+    }
+
+    void addSkeletonNode(const aiNode *node, int parent, rg::Skeleton &built)
+    {
+        int index = built.nodeNames.size();
+        aiVector3D scaling, position;
+        aiQuaternion rotation;
+        node->mTransformation.Decompose(scaling, rotation, position);
+        rg::Transform rest;
+        rest.translation = glm::vec3(position.x, position.y, position.z);
+        rest.rotation = glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+        rest.scale = glm::vec3(scaling.x, scaling.y, scaling.z);
+        built.nodeNames.push_back(node->mName.C_Str());
+        built.parents.push_back(parent);
+        built.restPose.push_back(rest);
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+            addSkeletonNode(node->mChildren[i], index, built);
+    }
+
+    // bakes the skeleton's first clip or, for models without one, the first morph target animation
+    void bakeVertexAnimation(const aiScene *scene)
+    {
+        if (!bakeAnimation)
+            return;
+        const aiAnimation *morph = nullptr;
+        for (unsigned int i = 0; i < scene->mNumAnimations && !morph; i++)
+            if (scene->mAnimations[i]->mNumMorphMeshChannels > 0)
+                morph = scene->mAnimations[i];
+        bool skinned = skeleton && !skeleton->compressedClips.empty();
+        if (!skinned && !morph)
+            return;
+        rg::StartupZone zone("bake vertex animation", "model");
+
+        VertexAnimation &baked = vertexAnimation;
+        unsigned int vertexCount = 0;
+        for (const Mesh &mesh : meshes)
+            vertexCount += mesh.vertices.size();
+        double ticksPerSecond = morph && morph->mTicksPerSecond != 0.0 ? morph->mTicksPerSecond : 25.0;
+        float duration = skinned ? skeleton->compressedClips[0].duration : (float) (morph->mDuration / ticksPerSecond);
+        // frames stacked on top of each other have to fit the texture height, a long clip gets fewer
+        const int maxSize = rg::glExtensions().maxTextureSize;
+        baked.width = (int) std::min(vertexCount, (unsigned int) maxSize);
+        baked.rows = (int) ((vertexCount + baked.width - 1) / baked.width);
+        if (baked.rows > maxSize)
+        {
+            cout << "[VertexAnimation] " << directory << ": " << vertexCount << " vertices don't fit a "
+                 << maxSize << "x" << maxSize << " texture, not baked" << endl;
+            return;
+        }
+        baked.frames = std::max(1, (int) std::lround(duration * baked.frameRate));
+        int maxFrames = maxSize / baked.rows;
+        if (baked.frames > maxFrames)
+        {
+            baked.frameRate = maxFrames / std::max(duration, 1e-3f);
+            baked.frames = maxFrames;
+            cout << "[VertexAnimation] " << directory << ": baked at " << baked.frameRate
+                 << " frames per second to fit " << maxSize << " rows" << endl;
+        }
+        baked.positions.assign((size_t) baked.frames * baked.rows * baked.width, glm::vec4(0.0f));
+        baked.normals.assign(baked.positions.size(), glm::vec4(0.0f));
+
+        vector<glm::mat4> palette(skinned ? skeleton->boneNodes.size() : 0);
+        vector<float> weights;
+        rg::PoseEvaluator evaluator;
+        rg::ClipCursor cursor;
+        for (int frame = 0; frame < baked.frames; frame++)
+        {
+            float time = frame / baked.frameRate;
+            glm::vec4 *positions = &baked.positions[(size_t) frame * baked.rows * baked.width];
+            glm::vec4 *normals = &baked.normals[(size_t) frame * baked.rows * baked.width];
+            if (skinned)
+            {
+                evaluator.Evaluate(*skeleton, skeleton->compressedClips[0], cursor, time, palette.data());
+                unsigned int v = 0;
+                for (const Mesh &mesh : meshes)
+                {
+                    for (const Vertex &vertex : mesh.vertices)
+                    {
+                        glm::mat4 skin = vertex.BoneWeights.x * palette[vertex.BoneIds[0]] +
+                                         vertex.BoneWeights.y * palette[vertex.BoneIds[1]] +
+                                         vertex.BoneWeights.z * palette[vertex.BoneIds[2]] +
+                                         vertex.BoneWeights.w * palette[vertex.BoneIds[3]];
+                        positions[v] = skin * glm::vec4(vertex.Position, 1.0f);
+                        normals[v++] = glm::vec4(glm::normalize(glm::mat3(skin) * vertex.Normal), 0.0f);
+                    }
+                }
+                continue;
+            }
+            sampleMorphWeights(morph->mMorphMeshChannels[0], time * ticksPerSecond, weights);
+            unsigned int v = 0;
+            for (unsigned int m = 0; m < meshes.size(); m++)
+            {
+                const aiMesh *source = sourceMeshes[m];
+                for (unsigned int i = 0; i < meshes[m].vertices.size(); i++, v++)
+                {
+                    const Vertex &vertex = meshes[m].vertices[i];
+                    glm::vec3 position = vertex.Position, normal = vertex.Normal;
+                    // assimp's targets hold whole positions, not offsets
+                    for (unsigned int k = 0; k < source->mNumAnimMeshes && k < weights.size(); k++)
+                    {
+                        const aiAnimMesh *target = source->mAnimMeshes[k];
+                        if (weights[k] == 0.0f || i >= target->mNumVertices)
+                            continue;
+                        if (target->mVertices)
+                            position += weights[k] * (glm::vec3(target->mVertices[i].x, target->mVertices[i].y,
+                                                                target->mVertices[i].z) - vertex.Position);
+                        if (target->mNormals)
+                            normal += weights[k] * (glm::vec3(target->mNormals[i].x, target->mNormals[i].y,
+                                                              target->mNormals[i].z) - vertex.Normal);
+                    }
+                    positions[v] = glm::vec4(position, 1.0f);
+                    normals[v] = glm::vec4(glm::normalize(normal), 0.0f);
+                }
+            }
+        }
+        zone.Arg("frames", baked.frames).Arg("vertices", vertexCount);
+    }
+
+    // target weights of a morph channel at time (in ticks), interpolated between its keys
+    static void sampleMorphWeights(const aiMeshMorphAnim *channel, double time, vector<float> &weights)
+    {
+        std::fill(weights.begin(), weights.end(), 0.0f);
+        if (channel->mNumKeys == 0)
+            return;
+        unsigned int next = 0;
+        while (next < channel->mNumKeys && channel->mKeys[next].mTime <= time)
+            next++;
+        unsigned int previous = next == 0 ? 0 : next - 1;
+        next = std::min(next, channel->mNumKeys - 1);
+        double span = channel->mKeys[next].mTime - channel->mKeys[previous].mTime;
+        float t = span > 0.0 ? (float) ((time - channel->mKeys[previous].mTime) / span) : 0.0f;
+        auto addKey = [&weights](const aiMeshMorphKey &key, float keyWeight)
+        {
+            for (unsigned int i = 0; i < key.mNumValuesAndWeights; i++)
+            {
+                if (key.mValues[i] >= weights.size())
+                    weights.resize(key.mValues[i] + 1, 0.0f);
+                weights[key.mValues[i]] += keyWeight * (float) key.mWeights[i];
+            }
+        };
+        addKey(channel->mKeys[previous], previous == next ? 1.0f : 1.0f - t);
+        if (next != previous)
+            addKey(channel->mKeys[next], t);
+    }
+
+    // one texel per vertex and frame, nearest filtering: the shader blends frames itself
+    void uploadVertexAnimation()
+    {
+        VertexAnimation &baked = vertexAnimation;
+        if (baked.positions.empty())
+            return;
+        int height = baked.frames * baked.rows;
+        glGenTextures(1, &baked.positionTexture);
+        glBindTexture(GL_TEXTURE_2D, baked.positionTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, baked.width, height, 0, GL_RGBA, GL_FLOAT, baked.positions.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        rg::labelObject(GL_TEXTURE, baked.positionTexture, directory + " animated positions");
+        glGenTextures(1, &baked.normalTexture);
+        glBindTexture(GL_TEXTURE_2D, baked.normalTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, baked.width, height, 0, GL_RGBA, GL_FLOAT, baked.normals.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        rg::labelObject(GL_TEXTURE, baked.normalTexture, directory + " animated normals");
+        glBindTexture(GL_TEXTURE_2D, 0);
+        vector<glm::vec4>().swap(baked.positions);
+        vector<glm::vec4>().swap(baked.normals);
+    }
+
+    // buffer textures, a vertex shader reads them by gl_VertexID
+    void uploadMorphTargets()
+    {
+        MorphTargets &targets = morphTargets;
+        if (targets.count == 0)
+            return;
+        glGenBuffers(1, &targets.rangeBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, targets.rangeBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, targets.sparse.ranges.size() * sizeof(glm::ivec2),
+                     targets.sparse.ranges.data(), GL_STATIC_DRAW);
+        rg::labelObject(GL_BUFFER, targets.rangeBuffer, directory + " morph ranges");
+        glGenBuffers(1, &targets.deltaBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, targets.deltaBuffer);
+        // a model whose targets move nothing still gets a texel, an empty buffer can't back a texture
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(targets.sparse.deltas.size(), 1) * sizeof(glm::vec4),
+                     targets.sparse.deltas.empty() ? nullptr : targets.sparse.deltas.data(), GL_STATIC_DRAW);
+        rg::labelObject(GL_BUFFER, targets.deltaBuffer, directory + " morph deltas");
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        glGenTextures(1, &targets.rangeTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, targets.rangeTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, targets.rangeBuffer);
+        rg::labelObject(GL_TEXTURE, targets.rangeTexture, directory + " morph ranges");
+        glGenTextures(1, &targets.deltaTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, targets.deltaTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, targets.deltaBuffer);
+        rg::labelObject(GL_TEXTURE, targets.deltaTexture, directory + " morph deltas");
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        targets.sparse.ranges = vector<glm::ivec2>();
+        targets.sparse.deltas = vector<glm::vec4>();
+    }
+
+    // area weighted vertex normals of a mesh at the given positions
+    static vector<glm::vec3> faceNormals(const Mesh &mesh, const vector<glm::vec3> &positions)
+    {
+        vector<glm::vec3> normals(positions.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            unsigned int a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+            glm::vec3 face = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+            normals[a] += face;
+            normals[b] += face;
+            normals[c] += face;
+        }
+        for (glm::vec3 &normal : normals)
+        {
+            float length = glm::length(normal);
+            if (length > 0.0f)
+                normal /= length;
+        }
+        return normals;
+    }
+
+    // assimp's matrices are row major
+    static glm::mat4 toGlm(const aiMatrix4x4 &m)
+    {
+        return glm::mat4(m.a1, m.b1, m.c1, m.d1,
+                         m.a2, m.b2, m.c2, m.d2,
+                         m.a3, m.b3, m.c3, m.d3,
+                         m.a4, m.b4, m.c4, m.d4);
+    }
+
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
     // the required info is returned as a Texture struct.
     vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
@@ -203,9 +825,10 @@ private:
                 }
             }
             if(!skip)
-            {   // if texture hasn't been loaded already, load it
+            {   // if texture hasn't been loaded already, reserve a layer for it, pixels are uploaded once the model is processed
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                if (!reserveTextureLayer(str.C_Str(), texture))
+                    continue;
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -214,6 +837,201 @@ private:
         }
         return textures;
     }
+
+    // finds (or creates) the array matching the image's size and channel count and appends a layer for it
+    bool reserveTextureLayer(const char *path, Texture &texture)
+    {
+        string filename = directory + '/' + string(path);
+        int width, height, nrComponents;
+        if (!stbi_info(filename.c_str(), &width, &height, &nrComponents))
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            return false;
+        }
+
+        TextureArray *array = nullptr;
+        for (TextureArray &candidate : textureArrays)
+        {
+            if (candidate.width == width && candidate.height == height && candidate.nrComponents == nrComponents)
+            {
+                array = &candidate;
+                break;
+            }
+        }
+        if (!array)
+        {
+            TextureArray created;
+            created.id = 0;
+            created.width = width;
+            created.height = height;
+            created.nrComponents = nrComponents;
+            textureArrays.push_back(created);
+            array = &textureArrays.back();
+        }
+
+        // until the arrays are uploaded the id is the index of the array in textureArrays
+        texture.id = array - textureArrays.data();
+        texture.layer = array->files.size();
+        array->files.push_back(filename);
+        return true;
+    }
+
+    // allocates every texture array with all of its layers and decodes the images into them, mip levels are
+    // built on the CPU. With mipTailOnly only the levels up to rg::MIP_TAIL_SIZE are uploaded.
+    void uploadTextureArrays(bool mipTailOnly)
+    {
+        for (TextureArray &array : textureArrays)
+            glGenTextures(1, &array.id);
+        for (Texture &texture : textures_loaded)
+            texture.id = textureArrays[texture.id].id;
+        for (Mesh &mesh : meshes)
+            for (Texture &texture : mesh.textures)
+                texture.id = textureArrays[texture.id].id;
+
+        for (TextureArray &array : textureArrays)
+        {
+            array.levels = rg::mipLevelCount(array.width, array.height);
+            array.residentLevel = mipTailOnly ? rg::mipTailLevel(array.width, array.height) : 0;
+            rg::uploadMipLevels(array.id, array.files, array.width, array.height, array.nrComponents,
+                                array.residentLevel, array.levels - 1);
+            rg::labelObject(GL_TEXTURE, array.id, array.files.size() == 1 ? array.files[0] :
+                            array.files[0] + " +" + to_string(array.files.size() - 1) + " layers");
+
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, array.residentLevel);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levels - 1);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+    }
+
+    // simplified levels of detail of every mesh, from rg::MeshCache or made on the spot and stored there.
+    // A level is made for all meshes at once and only kept while it takes enough triangles off the one
+    // before; its error is the largest of its meshes'. Doesn't touch OpenGL.
+    void generateLods()
+    {
+        rg::StartupZone zone("mesh lods", "model");
+        vector<vector<glm::vec3>> positions(meshes.size());
+        vector<vector<unsigned int>> imported(meshes.size());
+        size_t triangles = 0;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            for (const Vertex &vertex : meshes[i].vertices)
+                positions[i].push_back(vertex.Position);
+            imported[i] = meshes[i].indices;
+            triangles += imported[i].size() / 3;
+        }
+        rg::MeshCache &cache = rg::MeshCache::Instance();
+        std::uint64_t key = cache.Key(positions, imported);
+        vector<float> errors;
+        vector<vector<unsigned int>> levels;
+        bool cached = cache.Load(key, meshes.size(), errors, levels);
+        if (!cached)
+        {
+            auto start = std::chrono::steady_clock::now();
+            vector<rg::MeshSimplifier> simplifiers;
+            simplifiers.reserve(meshes.size());
+            for (size_t i = 0; i < meshes.size(); i++)
+                simplifiers.emplace_back(positions[i], imported[i]);
+            errors.assign(1, 0.0f);
+            size_t previous = triangles;
+            float reduction = 1.0f;
+            for (int level = 1; level < rg::MESH_LOD_COUNT; level++)
+            {
+                reduction *= rg::MESH_LOD_REDUCTION;
+                vector<vector<unsigned int>> levelIndices;
+                size_t left = 0;
+                float error = errors.back();
+                for (size_t i = 0; i < meshes.size(); i++)
+                {
+                    simplifiers[i].Simplify((size_t) (imported[i].size() / 3 * reduction));
+                    levelIndices.push_back(simplifiers[i].Indices());
+                    left += simplifiers[i].Triangles();
+                    error = std::max(error, simplifiers[i].Error());
+                }
+                if (left > rg::MESH_LOD_MIN_REDUCTION * previous)
+                    break;
+                errors.push_back(error);
+                levels.insert(levels.end(), levelIndices.begin(), levelIndices.end());
+                previous = left;
+            }
+            cache.Store(key, meshes.size(), errors, levels, rg::millisecondsSince(start));
+        }
+        lodErrors = errors;
+        std::ostringstream report;
+        for (size_t level = 0; level < errors.size(); level++)
+        {
+            size_t count = 0;
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                if (level > 0)
+                    meshes[i].lodIndices.push_back(levels[(level - 1) * meshes.size() + i]);
+                count += (level == 0 ? meshes[i].indices : meshes[i].lodIndices.back()).size() / 3;
+            }
+            report << (level == 0 ? "" : ", ") << count;
+            if (level > 0)
+                report << " (" << errors[level] << ")";
+        }
+        cout << "[MeshLod] " << directory << ": " << report.str() << " triangles"
+             << (cached ? " from cache" : "") << endl;
+        zone.Arg("path", directory).Arg("levels", errors.size()).Arg("cached", cached ? 1 : 0);
+    }
+
+    // packs the vertices and indices of all meshes into one set of buffers; the imported indices of every
+    // mesh come first, then every level of detail in turn
+    void uploadBuffers()
+    {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        singleDraw = !meshes.empty();
+        vector<unsigned int> baseVertices;
+        for (Mesh &mesh : meshes)
+        {
+            baseVertices.push_back(vertices.size());
+            vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+            singleDraw = singleDraw && mesh.SharesTextureArrays(meshes[0]);
+        }
+        int levels = std::max((int) lodErrors.size(), 1);
+        lods.assign(levels, rg::IndexRange());
+        for (int level = 0; level < levels; level++)
+        {
+            lods[level].offset = indices.size();
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                Mesh &mesh = meshes[i];
+                const vector<unsigned int> &meshIndices = level == 0 ? mesh.indices : mesh.lodIndices[level - 1];
+                if (level == 0)
+                {
+                    mesh.indexOffset = indices.size();
+                    mesh.lods.clear();
+                }
+                rg::IndexRange range;
+                range.offset = indices.size();
+                range.count = meshIndices.size();
+                mesh.lods.push_back(range);
+                for (unsigned int index : meshIndices)
+                    indices.push_back(baseVertices[i] + index);
+            }
+            lods[level].count = indices.size() - lods[level].offset;
+        }
+        indexCount = lods[0].count;
+
+        rg::StartupZone zone("upload buffers", "model");
+        zone.Arg("path", directory).Arg("vertices", vertices.size()).Arg("indices", indices.size())
+            .Arg("bytes", vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int));
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        // no vertex array is bound here, so the element data goes through GL_ARRAY_BUFFER as well
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        rg::labelObject(GL_BUFFER, VBO, directory + " vertices");
+        rg::labelObject(GL_BUFFER, EBO, directory + " indices");
+    }
 };
 
 
@@ -225,10 +1043,18 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    int width = 0, height = 0, nrComponents = 0;
+    unsigned char *data;
+    {
+        rg::StartupZone zone("stbi_load", "texture");
+        data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+        zone.Arg("path", filename).Arg("width", width).Arg("height", height).Arg("channels", nrComponents);
+    }
     if (data)
     {
+        rg::StartupZone zone("upload texture", "texture");
+        zone.Arg("path", filename).Arg("width", width).Arg("height", height)
+            .Arg("bytes", (long long) width * height * nrComponents);
         GLenum format;
         if (nrComponents == 1)
             format = GL_RED;
@@ -238,6 +1064,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
+        rg::labelObject(GL_TEXTURE, textureID, filename);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -8,17 +8,29 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 #include <common.h>
+#include <rg/Error.h>
+#include <rg/ProgramCache.h>
+#include <rg/StartupProfiler.h>
 class Shader
 {
 public:
     unsigned int ID;
     // constructor generates the shader on the fly
+    // defines are injected as '#define X' lines right after the #version directive; the outputs named
+    // in feedbackVaryings are captured interleaved by transform feedback
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::vector<std::string>& defines = {}, const std::vector<std::string>& feedbackVaryings = {})
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
+        sourceName = vertexPathString + " " + fragmentPathString;
+        for (const std::string& define : defines)
+            sourceName += " " + define;
+        rg::StartupZone zone("compile shader", "shader");
+        zone.Arg("program", sourceName);
 
         vertexPath = vertexPathString.c_str();
         fragmentPath= fragmentPathString.c_str();
@@ -64,49 +76,104 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        injectDefines(vertexCode, defines);
+        injectDefines(fragmentCode, defines);
+        injectDefines(geometryCode, defines);
+        // 2. try the program binary cache, the key covers sources, defines and driver
+        rg::ProgramCache& programCache = rg::ProgramCache::Instance();
+        std::vector<std::string> keyParts = defines;
+        for (const std::string& varying : feedbackVaryings)
+            keyParts.push_back("feedback " + varying);
+        cacheKey = programCache.Key({vertexCode, fragmentCode, geometryCode}, keyParts);
+        ID = glCreateProgram();
+        rg::labelObject(GL_PROGRAM, ID, sourceName);
+        if (programCache.Load(cacheKey, ID))
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            zone.Arg("programCache", "hit");
+            return;
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
+        // 3. submit compile and link; status is only queried in finishCompile() so that with
+        // KHR_parallel_shader_compile the driver works on it while the caller loads other assets
+        submitStart = std::chrono::steady_clock::now();
+        pendingShaders.push_back(submitStage(GL_VERTEX_SHADER, vertexCode));
+        pendingShaders.push_back(submitStage(GL_FRAGMENT_SHADER, fragmentCode));
         if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
+            pendingShaders.push_back(submitStage(GL_GEOMETRY_SHADER, geometryCode));
+        // shader Program
+        for (unsigned int stage : pendingShaders)
+            glAttachShader(ID, stage);
+        if (!feedbackVaryings.empty())
+        {
+            std::vector<const char*> names;
+            for (const std::string& varying : feedbackVaryings)
+                names.push_back(varying.c_str());
+            glTransformFeedbackVaryings(ID, (GLsizei) names.size(), names.data(), GL_INTERLEAVED_ATTRIBS);
+        }
+        if (programCache.Enabled())
+            rg::glExtensions().ProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        blockingMs = rg::millisecondsSince(submitStart);
+        submitEnd = std::chrono::steady_clock::now();
+    }
+    // true when finishCompile() won't stall. Without parallel compile support completion
+    // can't be queried without blocking, so the program always reports ready.
+    // ------------------------------------------------------------------------
+    bool isReady() const
+    {
+        if (pendingShaders.empty() || !rg::glExtensions().parallelShaderCompile)
+            return true;
+        GLint completed = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
+    }
+    // finishes the program if the driver is done with it, returns whether it is finished
+    // ------------------------------------------------------------------------
+    bool poll()
+    {
+        if (!pendingShaders.empty() && isReady())
+            finishCompile();
+        return pendingShaders.empty();
+    }
+    // reports compile and link errors, blocks if the driver is still compiling
+    // ------------------------------------------------------------------------
+    void finishCompile()
+    {
+        if (pendingShaders.empty())
+            return;
+        auto finishStart = std::chrono::steady_clock::now();
+        // with parallel compile the link runs on driver threads, if it is already done it finished
+        // somewhere between submitEnd and now, otherwise the status query below waits for it
+        bool alreadyLinked = rg::glExtensions().parallelShaderCompile && isReady();
+        // how long the driver had the program before anyone needed it, and how long we then waited
+        rg::StartupProfiler::Instance().RecordAsync("driver compile", "shader", submitEnd, finishStart,
+                                                    "\"program\": \"" + rg::jsonEscape(sourceName) + "\"");
+        rg::StartupZone zone("link shader", "shader");
+        zone.Arg("program", sourceName);
+        for (unsigned int stage : pendingShaders)
+            checkCompileErrors(stage, stageName(stage));
+        bool linked = checkCompileErrors(ID, "PROGRAM");
+        auto linkEnd = alreadyLinked ? finishStart : std::chrono::steady_clock::now();
         // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        for (unsigned int stage : pendingShaders)
+        {
+            glDetachShader(ID, stage);
+            glDeleteShader(stage);
+        }
+        pendingShaders.clear();
+        blockingMs += rg::millisecondsSince(finishStart);
+        // without parallel compile the driver links inside our calls, so only the main thread
+        // time counts; with it the link took from submit until the driver reported completion
+        double linkMs = blockingMs;
+        if (rg::glExtensions().parallelShaderCompile)
+            linkMs = std::chrono::duration<double, std::milli>(linkEnd - submitStart).count();
+        if (linked)
+            rg::ProgramCache::Instance().Store(cacheKey, ID, linkMs, blockingMs);
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
+        finishCompile();
         glUseProgram(ID); 
     }
     // utility uniform functions
@@ -170,9 +237,52 @@ public:
 
 
 private:
+    // shader objects of a program whose link hasn't been checked yet
+    std::vector<unsigned int> pendingShaders;
+    std::uint64_t cacheKey = 0;
+    // main thread time spent submitting and finishing the program
+    double blockingMs = 0.0;
+    // source files and defines, names the program in the startup profile
+    std::string sourceName;
+    std::chrono::steady_clock::time_point submitStart;
+    std::chrono::steady_clock::time_point submitEnd;
+
+    static unsigned int submitStage(GLenum type, const std::string& code)
+    {
+        const char* source = code.c_str();
+        unsigned int stage = glCreateShader(type);
+        glShaderSource(stage, 1, &source, NULL);
+        glCompileShader(stage);
+        return stage;
+    }
+
+    static std::string stageName(unsigned int stage)
+    {
+        GLint type = 0;
+        glGetShaderiv(stage, GL_SHADER_TYPE, &type);
+        switch (type)
+        {
+            case GL_VERTEX_SHADER: return "VERTEX";
+            case GL_FRAGMENT_SHADER: return "FRAGMENT";
+            case GL_GEOMETRY_SHADER: return "GEOMETRY";
+        }
+        return "UNKNOWN";
+    }
+    // inserts the defines after the first line, which has to be the #version directive
+    // ------------------------------------------------------------------------
+    static void injectDefines(std::string& code, const std::vector<std::string>& defines)
+    {
+        if (code.empty() || defines.empty())
+            return;
+        std::string block;
+        for (const std::string& define : defines)
+            block += "#define " + define + "\n";
+        std::string::size_type lineEnd = code.find('\n');
+        code.insert(lineEnd == std::string::npos ? code.size() : lineEnd + 1, block);
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -194,6 +304,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 
 };
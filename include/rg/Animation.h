@@ -0,0 +1,597 @@
+//
+// Skeletons and animation clips imported with a model, their compressed form, and the evaluation of a
+// pose into a bone palette.
+//
+
+#ifndef PROJECT_BASE_ANIMATION_H
+#define PROJECT_BASE_ANIMATION_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RG_ANIMATION_SSE 1
+#endif
+
+namespace rg {
+
+// bones one draw can be skinned to, the size of the Bones uniform block in model.vs
+const int MAX_BONES = 128;
+
+struct Transform {
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// key times in seconds, ascending
+template<typename T>
+struct AnimationKeys {
+    std::vector<float> times;
+    std::vector<T> values;
+};
+
+// the keys of one node, a channel without keys leaves the node's rest transform alone
+struct AnimationTrack {
+    int node;
+    AnimationKeys<glm::vec3> translation;
+    AnimationKeys<glm::quat> rotation;
+    AnimationKeys<glm::vec3> scale;
+};
+
+struct AnimationClip {
+    std::string name;
+    float duration = 0.0f; // seconds
+    std::vector<AnimationTrack> tracks;
+
+    std::size_t Bytes() const {
+        std::size_t bytes = 0;
+        for (const AnimationTrack& track : tracks) {
+            bytes += sizeof(AnimationTrack);
+            bytes += track.translation.times.size() * (sizeof(float) + sizeof(glm::vec3));
+            bytes += track.rotation.times.size() * (sizeof(float) + sizeof(glm::quat));
+            bytes += track.scale.times.size() * (sizeof(float) + sizeof(glm::vec3));
+        }
+        return bytes;
+    }
+};
+
+// Keys of one channel after reduction, 16 bits per time and per component. Times are fractions of the
+// clip's duration. Translations and scales are fractions of the channel's range, rotations keep their
+// three smallest components in 15 bits each plus which one was left out (see packQuat).
+struct CompressedKeys {
+    std::vector<std::uint16_t> times;
+    std::vector<std::uint16_t> values; // three per key
+    glm::vec3 minimum = glm::vec3(0.0f);
+    glm::vec3 extent = glm::vec3(0.0f);
+
+    std::size_t Bytes() const {
+        return sizeof(CompressedKeys) + (times.size() + values.size()) * sizeof(std::uint16_t);
+    }
+};
+
+// a channel without keys leaves the node at its rest transform, channels that never leave it are dropped
+struct CompressedTrack {
+    int node;
+    CompressedKeys translation;
+    CompressedKeys rotation;
+    CompressedKeys scale;
+};
+
+struct CompressedClip {
+    std::string name;
+    float duration = 0.0f; // seconds
+    std::vector<CompressedTrack> tracks;
+
+    std::size_t Bytes() const {
+        std::size_t bytes = 0;
+        for (const CompressedTrack& track : tracks) {
+            bytes += sizeof(int) + track.translation.Bytes() + track.rotation.Bytes() + track.scale.Bytes();
+        }
+        return bytes;
+    }
+};
+
+// how far a reduced and quantized clip may be off the original at any key
+struct ClipCompression {
+    // of the largest offset the node has from its parent in the clip
+    float translationError = 0.001f;
+    float rotationError = 0.0005f; // radians
+    float scaleError = 0.001f;
+};
+
+// The node hierarchy of a model flattened with every parent ahead of its children, the bones its
+// meshes are skinned to and the clips that animate it, compressed; the imported keys are only kept
+// while the clip is compressed. Built once on the loader thread and only read afterwards, it is shared
+// with the update thread and outlives the model's GL objects.
+struct Skeleton {
+    std::vector<std::string> nodeNames;
+    std::vector<int> parents; // -1 for the root
+    std::vector<Transform> restPose;
+    // node each bone follows and the matrix taking mesh space into the bone's space at bind time
+    std::vector<int> boneNodes;
+    std::vector<glm::mat4> inverseBind;
+    // takes the skinned result from the root's space back into the space the mesh is drawn in
+    glm::mat4 meshFromRoot = glm::mat4(1.0f);
+    std::vector<CompressedClip> compressedClips;
+
+    int FindNode(const std::string& name) const {
+        for (unsigned int i = 0; i < nodeNames.size(); ++i) {
+            if (nodeNames[i] == name) {
+                return (int) i;
+            }
+        }
+        return -1;
+    }
+
+    // the clip called name, the first clip when there is none, -1 without clips
+    int FindClip(const std::string& name) const {
+        for (unsigned int i = 0; i < compressedClips.size(); ++i) {
+            if (compressedClips[i].name == name) {
+                return (int) i;
+            }
+        }
+        return compressedClips.empty() ? -1 : 0;
+    }
+};
+
+// out = a * b for column major matrices, out may be a or b
+inline void multiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#ifdef RG_ANIMATION_SSE
+    const float* left = &a[0][0];
+    const float* right = &b[0][0];
+    float* result = &out[0][0];
+    __m128 column0 = _mm_loadu_ps(left);
+    __m128 column1 = _mm_loadu_ps(left + 4);
+    __m128 column2 = _mm_loadu_ps(left + 8);
+    __m128 column3 = _mm_loadu_ps(left + 12);
+    for (int i = 0; i < 4; ++i) {
+        __m128 sum = _mm_mul_ps(column0, _mm_set1_ps(right[4 * i]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(column1, _mm_set1_ps(right[4 * i + 1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(column2, _mm_set1_ps(right[4 * i + 2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(column3, _mm_set1_ps(right[4 * i + 3])));
+        _mm_storeu_ps(result + 4 * i, sum);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+// normalized linear blend along the shorter arc; close enough to slerp for keys a frame apart
+inline glm::quat nlerp(const glm::quat& a, const glm::quat& b, float t) {
+#ifdef RG_ANIMATION_SSE
+    __m128 from = _mm_set_ps(a.w, a.z, a.y, a.x);
+    __m128 to = _mm_set_ps(b.w, b.z, b.y, b.x);
+    __m128 product = _mm_mul_ps(from, to);
+    product = _mm_add_ps(product, _mm_movehl_ps(product, product));
+    product = _mm_add_ss(product, _mm_shuffle_ps(product, product, 1));
+    float weight = _mm_cvtss_f32(product) < 0.0f ? -t : t;
+    __m128 blend = _mm_add_ps(_mm_mul_ps(from, _mm_set1_ps(1.0f - t)), _mm_mul_ps(to, _mm_set1_ps(weight)));
+    __m128 square = _mm_mul_ps(blend, blend);
+    square = _mm_add_ps(square, _mm_movehl_ps(square, square));
+    square = _mm_add_ss(square, _mm_shuffle_ps(square, square, 1));
+    blend = _mm_div_ps(blend, _mm_sqrt_ps(_mm_shuffle_ps(square, square, 0)));
+    float q[4];
+    _mm_storeu_ps(q, blend);
+    return glm::quat(q[3], q[0], q[1], q[2]);
+#else
+    glm::quat target = glm::dot(a, b) < 0.0f ? -b : b;
+    return glm::normalize(a * (1.0f - t) + target * t);
+#endif
+}
+
+inline glm::vec3 interpolate(const glm::vec3& a, const glm::vec3& b, float t) {
+    return glm::mix(a, b, t);
+}
+
+inline glm::quat interpolate(const glm::quat& a, const glm::quat& b, float t) {
+    return nlerp(a, b, t);
+}
+
+// value of the keys at time, held constant before the first and after the last key
+template<typename T>
+bool sampleKeys(const AnimationKeys<T>& keys, float time, T& value) {
+    if (keys.times.empty()) {
+        return false;
+    }
+    auto next = std::upper_bound(keys.times.begin(), keys.times.end(), time);
+    if (next == keys.times.begin()) {
+        value = keys.values.front();
+    } else if (next == keys.times.end()) {
+        value = keys.values.back();
+    } else {
+        std::size_t i = next - keys.times.begin();
+        float span = keys.times[i] - keys.times[i - 1];
+        float t = span > 0.0f ? (time - keys.times[i - 1]) / span : 0.0f;
+        value = interpolate(keys.values[i - 1], keys.values[i], t);
+    }
+    return true;
+}
+
+inline glm::mat4 composeTransform(const Transform& transform) {
+    glm::mat4 matrix = glm::mat4_cast(transform.rotation);
+    matrix[0] *= transform.scale.x;
+    matrix[1] *= transform.scale.y;
+    matrix[2] *= transform.scale.z;
+    matrix[3] = glm::vec4(transform.translation, 1.0f);
+    return matrix;
+}
+
+// Smallest three: a unit quaternion's largest component follows from the other three, which lie in
+// [-1/sqrt(2), 1/sqrt(2)]. q and -q are the same rotation, so the largest is made positive and left out.
+// Each of the others gets 15 bits, the top bits of the first two hold the index of the one left out.
+inline void packQuat(const glm::quat& rotation, std::uint16_t packed[3]) {
+    glm::quat q = glm::normalize(rotation);
+    float components[4] = {q.x, q.y, q.z, q.w};
+    int largest = 0;
+    for (int i = 1; i < 4; ++i) {
+        if (std::fabs(components[i]) > std::fabs(components[largest])) {
+            largest = i;
+        }
+    }
+    float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+    for (int i = 0, j = 0; i < 4; ++i) {
+        if (i == largest) {
+            continue;
+        }
+        float unit = (components[i] * sign * 1.41421356f + 1.0f) * 0.5f;
+        packed[j++] = (std::uint16_t) std::lround(std::min(std::max(unit, 0.0f), 1.0f) * 32767.0f);
+    }
+    packed[0] |= (std::uint16_t) ((largest >> 1) << 15);
+    packed[1] |= (std::uint16_t) ((largest & 1) << 15);
+}
+
+inline glm::quat unpackQuat(const std::uint16_t packed[3]) {
+    int largest = ((packed[0] >> 15) << 1) | (packed[1] >> 15);
+    float components[4];
+    float sum = 0.0f;
+    for (int i = 0, j = 0; i < 4; ++i) {
+        if (i == largest) {
+            continue;
+        }
+        float value = ((packed[j++] & 0x7fff) * (2.0f / 32767.0f) - 1.0f) * 0.70710678f;
+        components[i] = value;
+        sum += value * value;
+    }
+    components[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+    return glm::quat(components[3], components[0], components[1], components[2]);
+}
+
+inline float keyError(const glm::vec3& a, const glm::vec3& b) {
+    return glm::length(a - b);
+}
+
+// Angle of the rotation from a to b. Taken from the relative rotation's parts with atan2, which doesn't
+// care that float quaternions are only about unit length; acos of the dot product can't resolve the
+// tolerances here.
+inline float keyError(const glm::quat& a, const glm::quat& b) {
+    double w = (double) a.w * b.w + (double) a.x * b.x + (double) a.y * b.y + (double) a.z * b.z;
+    double x = (double) a.w * b.x - (double) b.w * a.x - ((double) a.y * b.z - (double) a.z * b.y);
+    double y = (double) a.w * b.y - (double) b.w * a.y - ((double) a.z * b.x - (double) a.x * b.z);
+    double z = (double) a.w * b.z - (double) b.w * a.z - ((double) a.x * b.y - (double) a.y * b.x);
+    return (float) (2.0 * std::atan2(std::sqrt(x * x + y * y + z * z), std::fabs(w)));
+}
+
+// Indices of the keys to keep: a key goes when interpolating between its kept neighbours reproduces it,
+// and every key dropped before it, within tolerance. A channel that never moves keeps its first key.
+template<typename T>
+std::vector<unsigned int> reduceKeys(const AnimationKeys<T>& keys, float tolerance) {
+    std::vector<unsigned int> kept;
+    unsigned int count = keys.times.size();
+    if (count == 0) {
+        return kept;
+    }
+    kept.push_back(0);
+    unsigned int start = 0;
+    for (unsigned int end = 2; end < count; ++end) {
+        float span = keys.times[end] - keys.times[start];
+        for (unsigned int i = start + 1; i < end; ++i) {
+            float t = span > 0.0f ? (keys.times[i] - keys.times[start]) / span : 0.0f;
+            if (keyError(interpolate(keys.values[start], keys.values[end], t), keys.values[i]) > tolerance) {
+                start = end - 1;
+                kept.push_back(start);
+                break;
+            }
+        }
+    }
+    if (count > 1) {
+        kept.push_back(count - 1);
+    }
+    // two keys left, the same value, and everything between them reproduced: a constant
+    if (kept.size() == 2 && keyError(keys.values.front(), keys.values.back()) <= tolerance) {
+        kept.pop_back();
+    }
+    return kept;
+}
+
+inline void encodeTimes(const std::vector<float>& times, const std::vector<unsigned int>& kept, float duration,
+                        CompressedKeys& out) {
+    for (unsigned int i : kept) {
+        float fraction = duration > 0.0f ? std::min(std::max(times[i] / duration, 0.0f), 1.0f) : 0.0f;
+        out.times.push_back((std::uint16_t) std::lround(fraction * 65535.0f));
+    }
+}
+
+inline void encodeKeys(const AnimationKeys<glm::vec3>& keys, const std::vector<unsigned int>& kept, float duration,
+                       CompressedKeys& out) {
+    encodeTimes(keys.times, kept, duration, out);
+    glm::vec3 maximum(-std::numeric_limits<float>::max());
+    out.minimum = glm::vec3(std::numeric_limits<float>::max());
+    for (unsigned int i : kept) {
+        out.minimum = glm::min(out.minimum, keys.values[i]);
+        maximum = glm::max(maximum, keys.values[i]);
+    }
+    out.extent = maximum - out.minimum;
+    for (unsigned int i : kept) {
+        for (int c = 0; c < 3; ++c) {
+            float fraction = out.extent[c] > 0.0f ? (keys.values[i][c] - out.minimum[c]) / out.extent[c] : 0.0f;
+            out.values.push_back((std::uint16_t) std::lround(fraction * 65535.0f));
+        }
+    }
+}
+
+inline void encodeKeys(const AnimationKeys<glm::quat>& keys, const std::vector<unsigned int>& kept, float duration,
+                       CompressedKeys& out) {
+    encodeTimes(keys.times, kept, duration, out);
+    for (unsigned int i : kept) {
+        std::uint16_t packed[3];
+        packQuat(keys.values[i], packed);
+        out.values.insert(out.values.end(), packed, packed + 3);
+    }
+}
+
+inline void decodeKey(const CompressedKeys& keys, unsigned int key, glm::vec3& value) {
+    const std::uint16_t* packed = &keys.values[3 * key];
+    value = keys.minimum + keys.extent * glm::vec3(packed[0], packed[1], packed[2]) * (1.0f / 65535.0f);
+}
+
+inline void decodeKey(const CompressedKeys& keys, unsigned int key, glm::quat& value) {
+    value = unpackQuat(&keys.values[3 * key]);
+}
+
+// reduces and quantizes a channel, a channel left with a single key at the rest value is dropped
+template<typename T>
+void compressKeys(const AnimationKeys<T>& keys, float tolerance, float duration, const T& rest, CompressedKeys& out) {
+    std::vector<unsigned int> kept = reduceKeys(keys, tolerance);
+    if (kept.empty() || (kept.size() == 1 && keyError(keys.values[kept[0]], rest) <= tolerance)) {
+        return;
+    }
+    encodeKeys(keys, kept, duration, out);
+}
+
+inline float largestLength(const std::vector<glm::vec3>& values) {
+    float largest = 0.0f;
+    for (const glm::vec3& value : values) {
+        largest = std::max(largest, glm::length(value));
+    }
+    return largest;
+}
+
+inline CompressedClip compressClip(const AnimationClip& clip, const std::vector<Transform>& restPose,
+                                   const ClipCompression& settings = ClipCompression()) {
+    CompressedClip compressed;
+    compressed.name = clip.name;
+    compressed.duration = clip.duration;
+    for (const AnimationTrack& track : clip.tracks) {
+        const Transform& rest = restPose[track.node];
+        CompressedTrack reduced;
+        reduced.node = track.node;
+        float translationTolerance = settings.translationError *
+                                     std::max(largestLength(track.translation.values), glm::length(rest.translation));
+        compressKeys(track.translation, translationTolerance, clip.duration, rest.translation, reduced.translation);
+        compressKeys(track.rotation, settings.rotationError, clip.duration, rest.rotation, reduced.rotation);
+        compressKeys(track.scale, settings.scaleError, clip.duration, rest.scale, reduced.scale);
+        if (!reduced.translation.times.empty() || !reduced.rotation.times.empty() || !reduced.scale.times.empty()) {
+            compressed.tracks.push_back(std::move(reduced));
+        }
+    }
+    return compressed;
+}
+
+// Where playback of a compressed clip is: for every channel the pair of keys around the last time,
+// already decoded. Playing forward steps over the keys passed since the last sample instead of searching
+// for them, and keys are decoded once when the cursor reaches them rather than at every sample. Going
+// back in time, which is what a looping clip does, starts over from the first key. One per playing
+// clip instance.
+class ClipCursor {
+public:
+    // overwrites the animated parts of locals
+    void Sample(const CompressedClip& clip, float time, std::vector<Transform>& locals) {
+        float t = clip.duration > 0.0f ? std::fmod(time, clip.duration) : 0.0f;
+        if (t < 0.0f) {
+            t += clip.duration;
+        }
+        float position = clip.duration > 0.0f ? t / clip.duration * 65535.0f : 0.0f;
+        // a clip reloaded at the same address has a different number of tracks more often than not
+        bool changed = &clip != m_Clip || clip.tracks.size() != m_Rotations.size();
+        bool restart = changed || position < m_Position;
+        if (changed) {
+            m_Clip = &clip;
+            m_Translations.assign(clip.tracks.size(), Span<glm::vec3>());
+            m_Rotations.assign(clip.tracks.size(), Span<glm::quat>());
+            m_Scales.assign(clip.tracks.size(), Span<glm::vec3>());
+        }
+        m_Position = position;
+        for (unsigned int i = 0; i < clip.tracks.size(); ++i) {
+            const CompressedTrack& track = clip.tracks[i];
+            Transform& local = locals[track.node];
+            sample(track.translation, m_Translations[i], position, restart, local.translation);
+            sample(track.rotation, m_Rotations[i], position, restart, local.rotation);
+            sample(track.scale, m_Scales[i], position, restart, local.scale);
+        }
+    }
+
+private:
+    template<typename T>
+    struct Span {
+        unsigned int key = 0;
+        bool decoded = false;
+        float from = 0.0f, to = 0.0f;
+        T a, b;
+    };
+
+    const CompressedClip* m_Clip = nullptr;
+    float m_Position = 0.0f;
+    std::vector<Span<glm::vec3>> m_Translations;
+    std::vector<Span<glm::quat>> m_Rotations;
+    std::vector<Span<glm::vec3>> m_Scales;
+
+    template<typename T>
+    static void sample(const CompressedKeys& keys, Span<T>& span, float position, bool restart, T& value) {
+        unsigned int count = keys.times.size();
+        if (count == 0) {
+            return;
+        }
+        unsigned int key = restart || span.key >= count ? 0 : span.key;
+        while (key + 1 < count && keys.times[key + 1] <= position) {
+            ++key;
+        }
+        if (key != span.key || !span.decoded) {
+            unsigned int next = std::min(key + 1, count - 1);
+            decodeKey(keys, key, span.a);
+            decodeKey(keys, next, span.b);
+            span.from = keys.times[key];
+            span.to = keys.times[next];
+            span.key = key;
+            span.decoded = true;
+        }
+        if (span.to <= span.from || position <= span.from) {
+            value = span.a;
+        } else {
+            value = interpolate(span.a, span.b, std::min((position - span.from) / (span.to - span.from), 1.0f));
+        }
+    }
+};
+
+// writes the local transforms of a clip at time, the rest pose for nodes it doesn't animate
+inline void sampleClip(const Skeleton& skeleton, const AnimationClip& clip, float time, std::vector<Transform>& locals) {
+    locals.assign(skeleton.restPose.begin(), skeleton.restPose.end());
+    float t = clip.duration > 0.0f ? std::fmod(time, clip.duration) : 0.0f;
+    if (t < 0.0f) {
+        t += clip.duration;
+    }
+    for (const AnimationTrack& track : clip.tracks) {
+        Transform& local = locals[track.node];
+        sampleKeys(track.translation, t, local.translation);
+        sampleKeys(track.rotation, t, local.rotation);
+        sampleKeys(track.scale, t, local.scale);
+    }
+}
+
+// Walks local transforms through the hierarchy into the root's space and multiplies in the inverse
+// bind matrices. It keeps its scratch memory, so after the first pose nothing is allocated; one per
+// thread.
+class PoseEvaluator {
+public:
+    // writes skeleton.boneNodes.size() matrices to palette, the rest pose
+    void Evaluate(const Skeleton& skeleton, glm::mat4* palette) {
+        m_Locals.assign(skeleton.restPose.begin(), skeleton.restPose.end());
+        finish(skeleton, palette);
+    }
+
+    // the same posed by a clip, the cursor belongs to whatever is playing it
+    void Evaluate(const Skeleton& skeleton, const CompressedClip& clip, ClipCursor& cursor, float time,
+                  glm::mat4* palette) {
+        m_Locals.assign(skeleton.restPose.begin(), skeleton.restPose.end());
+        cursor.Sample(clip, time, m_Locals);
+        finish(skeleton, palette);
+    }
+
+private:
+    std::vector<Transform> m_Locals;
+    std::vector<glm::mat4> m_Globals;
+
+    void finish(const Skeleton& skeleton, glm::mat4* palette) {
+        m_Globals.resize(m_Locals.size());
+        for (unsigned int i = 0; i < m_Locals.size(); ++i) {
+            glm::mat4 local = composeTransform(m_Locals[i]);
+            if (skeleton.parents[i] < 0) {
+                m_Globals[i] = local;
+            } else {
+                multiplyMatrices(m_Globals[skeleton.parents[i]], local, m_Globals[i]);
+            }
+        }
+        for (unsigned int bone = 0; bone < skeleton.boneNodes.size(); ++bone) {
+            multiplyMatrices(m_Globals[skeleton.boneNodes[bone]], skeleton.inverseBind[bone], palette[bone]);
+            multiplyMatrices(skeleton.meshFromRoot, palette[bone], palette[bone]);
+        }
+    }
+};
+
+// whether models compare every clip with its compressed form as they load (printClipReport); set by
+// --clip-report before the first model is requested
+inline bool& clipReports() {
+    static bool enabled = false;
+    return enabled;
+}
+
+// Compares clip and compressed with sequential playback at 60 Hz over two loops: memory, the largest
+// difference in any local translation, rotation and scale, and the time to sample a pose per animated
+// joint, the original binary searching every channel and the compressed one through a cursor. Both
+// start every pose from the rest pose, as playback does.
+inline void printClipReport(const std::string& model, const Skeleton& skeleton, const AnimationClip& original,
+                            const CompressedClip& compressed) {
+    int samples = std::max(2, (int) std::ceil(original.duration * 60.0f) * 2);
+    float step = original.duration * 2.0f / samples;
+
+    std::vector<Transform> expected, actual(skeleton.restPose);
+    ClipCursor cursor;
+    float translationError = 0.0f, rotationError = 0.0f, scaleError = 0.0f;
+    for (int i = 0; i < samples; ++i) {
+        sampleClip(skeleton, original, i * step, expected);
+        cursor.Sample(compressed, i * step, actual);
+        for (const AnimationTrack& track : original.tracks) {
+            translationError = std::max(translationError,
+                                        keyError(expected[track.node].translation, actual[track.node].translation));
+            rotationError = std::max(rotationError, keyError(expected[track.node].rotation, actual[track.node].rotation));
+            scaleError = std::max(scaleError, keyError(expected[track.node].scale, actual[track.node].scale));
+        }
+    }
+
+    // a few rounds each, the checksum keeps the compiler from dropping the work
+    const int rounds = 20;
+    float checksum = 0.0f;
+    auto begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (int i = 0; i < samples; ++i) {
+            sampleClip(skeleton, original, i * step, expected);
+            checksum += expected[i % expected.size()].rotation.w;
+        }
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (int i = 0; i < samples; ++i) {
+            actual.assign(skeleton.restPose.begin(), skeleton.restPose.end());
+            cursor.Sample(compressed, i * step, actual);
+            checksum += actual[i % actual.size()].rotation.w;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    volatile float sink = checksum;
+    (void) sink;
+    // both per joint the compressed clip animates, tracks that stay at the rest pose were dropped from it
+    double joints = (double) rounds * samples * std::max<std::size_t>(compressed.tracks.size(), 1);
+    double originalNs = std::chrono::duration<double, std::nano>(middle - begin).count() / joints;
+    double compressedNs = std::chrono::duration<double, std::nano>(end - middle).count() / joints;
+
+    std::cout << "[Animation] " << model << " \"" << original.name << "\": " << original.tracks.size()
+              << " tracks (" << compressed.tracks.size() << " animated), " << original.Bytes() / 1024.0 << " KiB raw, " << compressed.Bytes() / 1024.0
+              << " KiB compressed (" << 100.0 * compressed.Bytes() / std::max<std::size_t>(original.Bytes(), 1)
+              << "%), error up to " << translationError << " units, " << glm::degrees(rotationError)
+              << " deg and " << scaleError << " in scale, " << originalNs << " ns raw and " << compressedNs
+              << " ns compressed per animated joint" << std::endl;
+}
+
+};
+
+#endif //PROJECT_BASE_ANIMATION_H
@@ -0,0 +1,218 @@
+//
+// Background thread that uploads textures and buffers through a context shared with the render window.
+//
+
+#ifndef PROJECT_BASE_ASSETLOADER_H
+#define PROJECT_BASE_ASSETLOADER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <rg/Error.h>
+#include <rg/FrameProfiler.h>
+#include <rg/SpscQueue.h>
+#include <rg/StartupProfiler.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+// 1x1 mid grey texture of the given target (GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY or GL_TEXTURE_CUBE_MAP),
+// bound in place of an asset that hasn't arrived yet or failed to load
+inline unsigned int createPlaceholderTexture(GLenum target) {
+    const unsigned char pixel[] = {128, 128, 128};
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+    if (target == GL_TEXTURE_2D_ARRAY) {
+        glTexImage3D(target, 0, GL_RGB8, 1, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, pixel);
+    } else if (target == GL_TEXTURE_CUBE_MAP) {
+        for (unsigned int face = 0; face < 6; ++face) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB8, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, pixel);
+        }
+    } else {
+        glTexImage2D(target, 0, GL_RGB8, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, pixel);
+    }
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(target, 0);
+    labelObject(GL_TEXTURE, texture, "placeholder");
+    return texture;
+}
+
+// Jobs are handed to the loader thread over one lock-free queue and come back over another.
+// The loader thread decodes and uploads, then puts a fence behind the uploads; the render thread
+// only polls those fences (zero timeout) once per frame, so it never waits for an upload, and
+// runs a job's ready callback once its objects are complete and visible to the render context.
+// Vertex array objects are not shared between contexts, ready callbacks are where they get built.
+class AssetLoader {
+public:
+    AssetLoader() = default;
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    ~AssetLoader() {
+        Stop();
+    }
+
+    // has to be called on the main thread, window is the render window whose objects the loader shares.
+    // When no shared context can be created jobs simply run synchronously in Submit.
+    bool Start(GLFWwindow* window) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        m_Context = glfwCreateWindow(1, 1, "Seaworld loader", nullptr, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (!m_Context) {
+            std::cout << "[AssetLoader] failed to create a shared context, loading on the render thread" << std::endl;
+            return false;
+        }
+        m_Running.store(true, std::memory_order_release);
+        m_Thread = std::thread(&AssetLoader::run, this);
+        return true;
+    }
+
+    // waits for the job in progress. Every job whose upload ran gets its ready callback, blocking on
+    // its fence, so the objects it created end up with whoever releases them; jobs that haven't
+    // started created nothing and are dropped.
+    void Stop() {
+        if (!m_Context) {
+            return;
+        }
+        m_Running.store(false, std::memory_order_release);
+        m_Thread.join();
+        Job* job;
+        while (m_Finished.Pop(job)) {
+            m_Waiting.push_back(job);
+        }
+        // the loader thread is gone, so the jobs it couldn't hand over are ours now
+        m_Waiting.insert(m_Waiting.end(), m_Stranded.begin(), m_Stranded.end());
+        for (Job* waiting : m_Waiting) {
+            while (glClientWaitSync(waiting->fence, 0, 1000000000) == GL_TIMEOUT_EXPIRED) {
+            }
+            complete(waiting);
+        }
+        while (m_Requests.Pop(job)) {
+            delete job;
+            m_Pending--;
+        }
+        for (Job* queued : m_Backlog) {
+            delete queued;
+            m_Pending--;
+        }
+        m_Waiting.clear();
+        m_Stranded.clear();
+        m_Backlog.clear();
+        glfwDestroyWindow(m_Context);
+        m_Context = nullptr;
+    }
+
+    // render thread; upload runs on the loader thread with the shared context current,
+    // ready runs on the render thread from Poll once everything upload did is complete
+    void Submit(std::function<void()> upload, std::function<void()> ready) {
+        m_Pending++;
+        if (!m_Context) {
+            upload();
+            ready();
+            m_Pending--;
+            return;
+        }
+        Job* job = new Job{std::move(upload), std::move(ready), nullptr, std::chrono::steady_clock::now()};
+        if (!m_Backlog.empty() || !m_Requests.Push(job)) {
+            m_Backlog.push_back(job);
+        }
+    }
+
+    // render thread, once per frame
+    void Poll() {
+        while (!m_Backlog.empty() && m_Requests.Push(m_Backlog.front())) {
+            m_Backlog.erase(m_Backlog.begin());
+        }
+        Job* job;
+        while (m_Finished.Pop(job)) {
+            m_Waiting.push_back(job);
+        }
+        for (unsigned int i = 0; i < m_Waiting.size();) {
+            GLenum status = glClientWaitSync(m_Waiting[i]->fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                ++i;
+                continue;
+            }
+            complete(m_Waiting[i]);
+            m_Waiting.erase(m_Waiting.begin() + i);
+        }
+    }
+
+    // jobs submitted whose ready callback hasn't run yet
+    int Pending() const {
+        return m_Pending;
+    }
+
+private:
+    struct Job {
+        std::function<void()> upload;
+        std::function<void()> ready;
+        GLsync fence;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    GLFWwindow* m_Context = nullptr;
+    std::thread m_Thread;
+    std::atomic<bool> m_Running{false};
+    SpscQueue<Job*> m_Requests; // render thread -> loader thread
+    SpscQueue<Job*> m_Finished; // loader thread -> render thread
+    // render thread only
+    std::vector<Job*> m_Backlog;
+    std::vector<Job*> m_Waiting;
+    int m_Pending = 0;
+    // loader thread until it is joined, uploaded jobs it couldn't push once stopping
+    std::vector<Job*> m_Stranded;
+
+    // render thread, once the job's fence has signaled
+    void complete(Job* job) {
+        glDeleteSync(job->fence);
+        // submit to ready, the time an asset spends in queue, upload and fence together
+        StartupProfiler::Instance().RecordAsync("asset job", "loader", job->submitted,
+                                                std::chrono::steady_clock::now(), "");
+        job->ready();
+        delete job;
+        m_Pending--;
+    }
+
+    void run() {
+        glfwMakeContextCurrent(m_Context);
+        // debug output is per context, errors in uploads are reported like those of the render thread
+        installDebugOutput();
+        StartupProfiler::Instance().NameThread("loader thread");
+        FrameProfiler::Instance().NameThread("loader thread");
+        while (m_Running.load(std::memory_order_acquire)) {
+            Job* job;
+            if (!m_Requests.Pop(job)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            {
+                StartupZone zone("job", "loader");
+                ProfileZone frameZone("loader job");
+                job->upload();
+            }
+            job->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            // the fence has to reach the GPU before another context can wait on it
+            glFlush();
+            while (!m_Finished.Push(job)) {
+                if (!m_Running.load(std::memory_order_acquire)) {
+                    m_Stranded.push_back(job);
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        glfwMakeContextCurrent(nullptr);
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_ASSETLOADER_H
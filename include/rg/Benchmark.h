@@ -0,0 +1,130 @@
+//
+// Fixed-length measurement of frame times and GPU pass times, written as JSON.
+//
+
+#ifndef PROJECT_BASE_BENCHMARK_H
+#define PROJECT_BASE_BENCHMARK_H
+
+#include <rg/GpuTimers.h>
+#include <rg/MeshLod.h>
+#include <rg/StartupProfiler.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// Started once the scene is complete so that loading doesn't skew the numbers. CPU frame times are
+// collected frame by frame, GPU times come from the timers' totals over the same frames. The triangles
+// submitted are averaged next to what full detail would have cost.
+class Benchmark {
+public:
+    std::string Path;
+    double Seconds;
+
+    Benchmark(const std::string& path, double seconds) : Path(path), Seconds(seconds) {
+    }
+
+    bool Running() const {
+        return m_Running;
+    }
+
+    bool Finished() const {
+        return m_Finished;
+    }
+
+    void Start(GpuTimers& gpuTimers) {
+        gpuTimers.ResetStats();
+        m_FrameMs.clear();
+        m_Triangles = TriangleCount();
+        m_Elapsed = 0.0;
+        m_Running = true;
+    }
+
+    // once per frame with the frame's duration and triangles; returns true when the time is up and the file
+    // was written
+    bool Frame(float deltaTime, const GpuTimers& gpuTimers, const TriangleCount& triangles = TriangleCount()) {
+        if (!m_Running) {
+            return false;
+        }
+        m_FrameMs.push_back(deltaTime * 1000.0f);
+        m_Triangles += triangles;
+        m_Elapsed += deltaTime;
+        if (m_Elapsed < Seconds) {
+            return false;
+        }
+        m_Running = false;
+        m_Finished = true;
+        write(gpuTimers);
+        return true;
+    }
+
+private:
+    bool m_Running = false;
+    bool m_Finished = false;
+    double m_Elapsed = 0.0;
+    std::vector<float> m_FrameMs;
+    TriangleCount m_Triangles;
+
+    void write(const GpuTimers& gpuTimers) const {
+        std::ofstream out(Path);
+        if (!out) {
+            std::cout << "[Benchmark] failed to write " << Path << std::endl;
+            return;
+        }
+        std::vector<float> sorted = m_FrameMs;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (float ms : sorted) {
+            sum += ms;
+        }
+        auto percentile = [&sorted](double p) {
+            return sorted.empty() ? 0.0f : sorted[std::min(sorted.size() - 1, (std::size_t) (p * sorted.size()))];
+        };
+
+        // average per frame over all frames, a model that wasn't always drawn counts as 0 when it wasn't
+        int frames = std::max(gpuTimers.Frames(), 1);
+        GLint contextFlags = 0;
+        glGetIntegerv(GL_CONTEXT_FLAGS, &contextFlags);
+        out << "{\n  \"seconds\": " << m_Elapsed << ",\n  \"frames\": " << sorted.size() << ",\n";
+        out << "  \"debugContext\": " << (contextFlags & GL_CONTEXT_FLAG_DEBUG_BIT ? "true" : "false") << ",\n";
+        out << "  \"cpuFrameMs\": {\"average\": " << (sorted.empty() ? 0.0 : sum / sorted.size())
+            << ", \"median\": " << percentile(0.5) << ", \"p95\": " << percentile(0.95) << ", \"p99\": "
+            << percentile(0.99) << ", \"max\": " << (sorted.empty() ? 0.0f : sorted.back()) << "},\n";
+        out << "  \"gpuPassMs\": {";
+        double gpuTotal = 0.0;
+        bool first = true;
+        for (const char* pass : gpuTimers.Passes()) {
+            double passTotal = 0.0;
+            for (const GpuTimers::Timer& timer : gpuTimers.Timers()) {
+                if (std::string(timer.pass) == pass) {
+                    passTotal += timer.totalMs;
+                }
+            }
+            gpuTotal += passTotal;
+            out << (first ? "" : ", ") << "\"" << jsonEscape(pass) << "\": " << passTotal / frames;
+            first = false;
+        }
+        out << "},\n  \"gpuTimerMs\": {";
+        first = true;
+        for (const GpuTimers::Timer& timer : gpuTimers.Timers()) {
+            out << (first ? "" : ", ") << "\"" << jsonEscape(timer.name) << "\": " << timer.totalMs / frames;
+            first = false;
+        }
+        long long cpuFrames = std::max<long long>((long long) sorted.size(), 1);
+        out << "},\n  \"gpuFrameMs\": " << gpuTotal / frames << ",\n  \"gpuSamplesDropped\": "
+            << gpuTimers.Dropped() << ",\n";
+        out << "  \"trianglesPerFrame\": {\"submitted\": " << m_Triangles.submitted / cpuFrames
+            << ", \"fullDetail\": " << m_Triangles.full / cpuFrames << "}\n}\n";
+        std::cout << "[Benchmark] " << sorted.size() << " frames, " << sum / std::max<std::size_t>(sorted.size(), 1)
+                  << " ms average, " << m_Triangles.submitted / cpuFrames << " triangles per frame ("
+                  << m_Triangles.full / cpuFrames << " at full detail), written to " << Path << std::endl;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_BENCHMARK_H
@@ -0,0 +1,80 @@
+//
+// Uniform buffer holding the bone palettes of every skinned draw in a frame.
+//
+
+#ifndef PROJECT_BASE_BONEBUFFER_H
+#define PROJECT_BASE_BONEBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/Animation.h>
+#include <rg/Error.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace rg {
+
+// uniform block binding point of the Bones block in model.vs
+const unsigned int BONES_BINDING = 0;
+// bytes of one draw's palette in the buffer
+const GLsizeiptr BONE_SLOT_BYTES = MAX_BONES * sizeof(glm::mat4);
+
+// A frame's palettes are uploaded in one go, each in a slot of MAX_BONES matrices (8 KiB, a multiple of
+// any uniform buffer offset alignment), and a draw binds the range of its slot. The skinning then costs
+// the vertex shader a few matrix reads in every pass that draws the model, nothing is skinned twice on
+// the CPU and nothing waits on the GPU: the buffer is orphaned before each upload.
+class BoneBuffer {
+public:
+    BoneBuffer() = default;
+    BoneBuffer(const BoneBuffer&) = delete;
+    BoneBuffer& operator=(const BoneBuffer&) = delete;
+
+    ~BoneBuffer() {
+        Release();
+    }
+
+    // needs the context current, call before it goes away
+    void Release() {
+        glDeleteBuffers(1, &m_Buffer);
+        m_Buffer = 0;
+    }
+
+    // palettes holds whole slots, MAX_BONES matrices each; an empty frame still gets one slot so the
+    // block is always backed
+    void Upload(const std::vector<glm::mat4>& palettes) {
+        if (m_Buffer == 0) {
+            glGenBuffers(1, &m_Buffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+            labelObject(GL_BUFFER, m_Buffer, "bone palettes");
+        } else {
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+        }
+        GLsizeiptr bytes = std::max<GLsizeiptr>(palettes.size() * sizeof(glm::mat4), BONE_SLOT_BYTES);
+        glBufferData(GL_UNIFORM_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        if (!palettes.empty()) {
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, palettes.size() * sizeof(glm::mat4), palettes.data());
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        Bind(0);
+    }
+
+    void Bind(int slot) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, BONES_BINDING, m_Buffer, slot * BONE_SLOT_BYTES, BONE_SLOT_BYTES);
+    }
+
+    // points a program's Bones block at the binding, programs without one are left alone
+    static void BindBlock(unsigned int program) {
+        unsigned int block = glGetUniformBlockIndex(program, "Bones");
+        if (block != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, block, BONES_BINDING);
+        }
+    }
+
+private:
+    unsigned int m_Buffer = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_BONEBUFFER_H
@@ -0,0 +1,380 @@
+//
+// Schools of one model drawn instanced, every instance playing the model's baked vertex animation and swimming.
+//
+
+#ifndef PROJECT_BASE_CROWD_H
+#define PROJECT_BASE_CROWD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/Impostor.h>
+#include <rg/MeshLod.h>
+#include <rg/Morph.h>
+#include <rg/Swim.h>
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// texture units of the baked animation, above the ones a model's texture arrays take
+const int ANIMATION_POSITION_UNIT = 14;
+const int ANIMATION_NORMAL_UNIT = 15;
+
+struct CrowdInstance {
+    glm::mat4 transform;
+    glm::vec2 playback; // phase in seconds, playback rate
+    glm::vec4 swim; // SwimMotion::Attribute
+};
+
+// Instances are scattered over a box with random headings and never move; all the motion is the baked
+// animation each plays from its own phase and at its own rate, and the swim wave each bends its body
+// with from its own phase. A crowd of any size is then one instanced draw per mesh (one for most
+// models) and nothing per frame on the CPU. What animation costs over static instancing is four texel
+// fetches per vertex in the vertex shader, the position and normal of the two frames it blends between.
+// Models without a baked animation only swim.
+// Models with morph targets blend them with weights from a MorphCycle, whose keys are uniforms the vertex
+// shader samples for each instance at its own phase and rate, so pulsing costs nothing per frame either.
+// Every instance picks its own level of detail of the model. The instances are kept in the buffer in
+// order of level, so each level is one instanced draw (per mesh) with the instance attributes pointed at
+// its first instance; they are only sorted and uploaded again when an instance changes level.
+// With impostors enabled, the last level is the model's impostor, baked a few views a frame by BakeImpostor:
+// the far instances are one instanced draw of a quad each, two triangles however detailed the model. The
+// impostor shows the rest pose, past its distance neither the animation nor the swim are made out.
+class Crowd {
+public:
+    // swim is the motion of an average instance, each varies it a little
+    Crowd(const std::string& name, glm::vec3 center, glm::vec3 extent, unsigned int seed,
+          const SwimMotion& swim = SwimMotion())
+            : m_Name(name), m_Center(center), m_Extent(extent), m_Seed(seed), m_Swim(swim) {
+    }
+
+    Crowd(const Crowd&) = delete;
+    Crowd& operator=(const Crowd&) = delete;
+
+    ~Crowd() {
+        Release();
+    }
+
+    // needs the context current, call before it goes away
+    void Release() {
+        glDeleteVertexArrays(1, &m_VAO);
+        glDeleteBuffers(1, &m_InstanceBuffer);
+        glDeleteVertexArrays(1, &m_ImpostorVAO);
+        glDeleteBuffers(1, &m_CornerBuffer);
+        m_VAO = m_InstanceBuffer = m_ImpostorVAO = m_CornerBuffer = 0;
+        m_Impostor.Release();
+        m_Model = nullptr;
+        m_Uploaded = -1;
+    }
+
+    // instances come from the seed in order, so the ones already there stay where they are
+    void SetCount(int count) {
+        if (count == (int) m_Instances.size()) {
+            return;
+        }
+        std::mt19937 random(m_Seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        m_Instances.resize(count);
+        for (CrowdInstance& instance : m_Instances) {
+            glm::vec3 position = m_Center + (glm::vec3(unit(random), unit(random), unit(random)) - 0.5f) * m_Extent;
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+            transform = glm::rotate(transform, unit(random) * 6.2831853f, glm::vec3(0.0f, 1.0f, 0.0f));
+            transform = glm::rotate(transform, (unit(random) - 0.5f) * 0.3f, glm::vec3(1.0f, 0.0f, 0.0f));
+            transform = glm::scale(transform, glm::vec3(0.8f + 0.4f * unit(random)));
+            instance.transform = transform;
+            instance.playback = glm::vec2(unit(random) * 10.0f, 0.85f + 0.3f * unit(random));
+            // a faster animation goes with faster tail beats
+            SwimMotion swim = m_Swim;
+            swim.amplitude *= 0.8f + 0.4f * unit(random);
+            swim.frequency *= instance.playback.y;
+            swim.phase = unit(random) * 6.2831853f;
+            instance.swim = swim.Attribute();
+        }
+    }
+
+    // instances placed by the caller instead, still and without animation; placed again every frame
+    // they are streamed
+    void Place(const std::vector<glm::mat4>& transforms) {
+        m_Instances.resize(transforms.size());
+        for (size_t i = 0; i < transforms.size(); i++) {
+            m_Instances[i].transform = transforms[i];
+            m_Instances[i].playback = glm::vec2(0.0f, 1.0f);
+            m_Instances[i].swim = glm::vec4(0.0f);
+        }
+        m_Placed = true;
+        m_Uploaded = -1;
+    }
+
+    int Count() const {
+        return (int) m_Instances.size();
+    }
+
+    // what instances of a model with morph targets play, they stay in their rest shape without one
+    void SetMorphCycle(const MorphCycle* cycle) {
+        m_Cycle = cycle;
+    }
+
+    // far instances are drawn as the model's impostor, baked with bakeShader (impostor_bake.vs/.fs) and
+    // drawn with drawShader (impostor.vs/.fs), which needs its lights and camera set before Draw
+    void EnableImpostors(Shader& bakeShader, Shader& drawShader) {
+        m_BakeShader = &bakeShader;
+        m_ImpostorShader = &drawShader;
+    }
+
+    // bakes up to views more views of the model's impostor, the far instances stay at the meshes' last level
+    // until it is Ready. Called every frame outside of any pass, it spreads the bake over a few frames from
+    // when the model is loaded instead of stalling the first frame that draws the crowd.
+    void BakeImpostor(Model& model, int views) {
+        if (!m_ImpostorShader || m_Instances.empty() || !model.Ready()) {
+            return;
+        }
+        prepare(model);
+        m_Impostor.Bake(model, *m_BakeShader, views);
+    }
+
+    // with the VERTEX_ANIMATION variant of the model shader, orientation turns the model's mesh the way
+    // the instances should face. Nothing is drawn until the model is loaded.
+    void Draw(Shader& shader, Model& model, const SwimBody& body, const glm::mat4& orientation, float time,
+              const MeshLodSelector& lods) {
+        const VertexAnimation& animation = model.vertexAnimation;
+        m_Triangles = TriangleCount();
+        if (m_Instances.empty() || !model.Ready()) {
+            return;
+        }
+        prepare(model);
+        upload(selectLods(model, orientation, lods));
+
+        shader.use();
+        shader.setMat4("model", orientation);
+        shader.setFloat("time", time);
+        body.SetUniforms(shader, model);
+        model.BindMorphTargets(shader);
+        setMorphCycle(shader, model.morphTargets.count > 0 ? m_Cycle : nullptr);
+        shader.setInt("animationFrames", animation.positionTexture != 0 ? animation.frames : 0);
+        shader.setInt("animationWidth", animation.width);
+        shader.setInt("animationRows", animation.rows);
+        shader.setFloat("animationFrameRate", animation.frameRate);
+        glActiveTexture(GL_TEXTURE0 + ANIMATION_POSITION_UNIT);
+        glBindTexture(GL_TEXTURE_2D, animation.positionTexture);
+        glActiveTexture(GL_TEXTURE0 + ANIMATION_NORMAL_UNIT);
+        glBindTexture(GL_TEXTURE_2D, animation.normalTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBindVertexArray(m_VAO);
+        if (model.singleDraw) {
+            bindTextureArrays(shader, model.meshes[0].textures, model.meshes[0].glslIdentifierPrefix);
+        }
+        for (int level = 0; level < MESH_LOD_COUNT; level++) {
+            GLsizei count = (GLsizei) (m_LevelStart[level + 1] - m_LevelStart[level]);
+            if (count == 0) {
+                continue;
+            }
+            pointInstances(m_LevelStart[level]);
+            m_Triangles += model.Triangles(level, count);
+            if (model.singleDraw) {
+                IndexRange range = model.Lod(level);
+                glDrawElementsInstanced(GL_TRIANGLES, range.count, GL_UNSIGNED_INT,
+                                        (void*) (range.offset * sizeof(unsigned int)), count);
+                continue;
+            }
+            for (unsigned int i = 0; i < model.meshes.size(); i++) {
+                const Mesh& mesh = model.meshes[i];
+                if (i == 0 || !mesh.SharesTextureArrays(model.meshes[i - 1])) {
+                    bindTextureArrays(shader, mesh.textures, mesh.glslIdentifierPrefix);
+                }
+                IndexRange range = mesh.Lod(level);
+                glDrawElementsInstanced(GL_TRIANGLES, range.count, GL_UNSIGNED_INT,
+                                        (void*) (range.offset * sizeof(unsigned int)), count);
+            }
+        }
+        glBindVertexArray(0);
+        drawImpostors(model, orientation);
+    }
+
+    // of the last Draw
+    const TriangleCount& Triangles() const {
+        return m_Triangles;
+    }
+
+    // the samplers of the baked animation, once per program
+    static void SetSamplers(Shader& shader) {
+        shader.use();
+        shader.setInt("animationPositions", ANIMATION_POSITION_UNIT);
+        shader.setInt("animationNormals", ANIMATION_NORMAL_UNIT);
+        setMorphSamplers(shader);
+        // the warm-up draw reads no animation
+        shader.setInt("animationFrames", 0);
+        shader.setInt("animationWidth", 1);
+        shader.setInt("animationRows", 1);
+    }
+
+private:
+    // the meshes' levels and the impostor
+    static const int LEVELS = IMPOSTOR_LOD + 1;
+
+    std::string m_Name;
+    glm::vec3 m_Center;
+    glm::vec3 m_Extent;
+    unsigned int m_Seed;
+    SwimMotion m_Swim;
+    std::vector<CrowdInstance> m_Instances;
+    // level of detail of every instance; the instances in order of level as uploaded, and where each
+    // level starts among them
+    std::vector<unsigned char> m_Levels;
+    std::vector<unsigned int> m_Order;
+    std::vector<CrowdInstance> m_Sorted;
+    std::size_t m_LevelStart[LEVELS + 1] = {};
+    TriangleCount m_Triangles;
+    unsigned int m_VAO = 0;
+    unsigned int m_InstanceBuffer = 0;
+    int m_Uploaded = -1;
+    bool m_Placed = false;
+    const MorphCycle* m_Cycle = nullptr;
+    // the vertex array reads the buffers of this model, a streamed out and reloaded model needs a new one
+    const Model* m_Model = nullptr;
+    unsigned int m_ModelVAO = 0;
+    unsigned int m_ModelVBO = 0;
+    Impostor m_Impostor;
+    Shader* m_BakeShader = nullptr;
+    Shader* m_ImpostorShader = nullptr;
+    // the quad's corners, and a vertex array reading them and the instances
+    unsigned int m_ImpostorVAO = 0;
+    unsigned int m_CornerBuffer = 0;
+
+    // true when an instance changed level, the instances are then in a new order
+    bool selectLods(const Model& model, const glm::mat4& orientation, const MeshLodSelector& selector) {
+        bool changed = m_Levels.size() != m_Instances.size();
+        m_Levels.resize(m_Instances.size(), 0);
+        glm::vec3 center = model.BoundingCenter();
+        float radius = model.BoundingRadius();
+        bool impostor = m_Impostor.Ready();
+        for (std::size_t i = 0; i < m_Instances.size(); i++) {
+            int level = selector.Select(m_Levels[i], m_Instances[i].transform * orientation, center, radius,
+                                        model.lodErrors, impostor);
+            changed = changed || level != m_Levels[i];
+            m_Levels[i] = (unsigned char) level;
+        }
+        if (!changed && m_Order.size() == m_Instances.size()) {
+            return false;
+        }
+        std::fill(m_LevelStart, m_LevelStart + LEVELS + 1, 0);
+        for (unsigned char level : m_Levels) {
+            m_LevelStart[level + 1]++;
+        }
+        for (int level = 0; level < LEVELS; level++) {
+            m_LevelStart[level + 1] += m_LevelStart[level];
+        }
+        std::size_t fill[LEVELS];
+        std::copy(m_LevelStart, m_LevelStart + LEVELS, fill);
+        m_Order.resize(m_Instances.size());
+        for (std::size_t i = 0; i < m_Instances.size(); i++) {
+            m_Order[fill[m_Levels[i]]++] = (unsigned int) i;
+        }
+        return true;
+    }
+
+    // the instance attributes start at the first instance of a level; with the vertex array bound
+    void pointInstances(std::size_t first) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+        const char* base = (const char*) (first * sizeof(CrowdInstance));
+        for (int column = 0; column < 4; column++) {
+            glEnableVertexAttribArray(8 + column);
+            glVertexAttribPointer(8 + column, 4, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance),
+                                  base + offsetof(CrowdInstance, transform) + column * sizeof(glm::vec4));
+            glVertexAttribDivisor(8 + column, 1);
+        }
+        glEnableVertexAttribArray(12);
+        glVertexAttribPointer(12, 2, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance), base + offsetof(CrowdInstance, playback));
+        glVertexAttribDivisor(12, 1);
+        glEnableVertexAttribArray(SWIM_ATTRIBUTE);
+        glVertexAttribPointer(SWIM_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance),
+                              base + offsetof(CrowdInstance, swim));
+        glVertexAttribDivisor(SWIM_ATTRIBUTE, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void prepare(const Model& model) {
+        if (&model != m_Model || model.VAO != m_ModelVAO || model.VBO != m_ModelVBO) {
+            glDeleteVertexArrays(1, &m_VAO);
+            if (m_InstanceBuffer == 0) {
+                glGenBuffers(1, &m_InstanceBuffer);
+                glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+                labelObject(GL_BUFFER, m_InstanceBuffer, m_Name + " instances");
+            }
+            glGenVertexArrays(1, &m_VAO);
+            glBindVertexArray(m_VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, model.VBO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.EBO);
+            setVertexAttributes();
+            glBindVertexArray(0);
+            labelObject(GL_VERTEX_ARRAY, m_VAO, m_Name);
+            m_Model = &model;
+            m_ModelVAO = model.VAO;
+            m_ModelVBO = model.VBO;
+            // baked again from the model as it is now
+            m_Impostor.Release();
+        }
+        if (m_ImpostorShader && m_ImpostorVAO == 0) {
+            const glm::vec2 corners[4] = {glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(-1.0f, 1.0f),
+                                          glm::vec2(1.0f, 1.0f)};
+            glGenBuffers(1, &m_CornerBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, m_CornerBuffer);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+            glGenVertexArrays(1, &m_ImpostorVAO);
+            glBindVertexArray(m_ImpostorVAO);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*) 0);
+            glBindVertexArray(0);
+            labelObject(GL_VERTEX_ARRAY, m_ImpostorVAO, m_Name + " impostors");
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void upload(bool reordered) {
+        if (m_Uploaded != (int) m_Instances.size() || reordered) {
+            m_Sorted.resize(m_Instances.size());
+            for (std::size_t i = 0; i < m_Order.size(); i++) {
+                m_Sorted[i] = m_Instances[m_Order[i]];
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+            glBufferData(GL_ARRAY_BUFFER, m_Sorted.size() * sizeof(CrowdInstance), m_Sorted.data(),
+                         m_Placed ? GL_STREAM_DRAW : GL_DYNAMIC_DRAW);
+            m_Uploaded = (int) m_Instances.size();
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // the instances at the impostor level, with the model program's vertex array unbound
+    void drawImpostors(const Model& model, const glm::mat4& orientation) {
+        GLsizei count = (GLsizei) (m_LevelStart[IMPOSTOR_LOD + 1] - m_LevelStart[IMPOSTOR_LOD]);
+        if (count == 0) {
+            return;
+        }
+        Shader& shader = *m_ImpostorShader;
+        shader.use();
+        shader.setMat4("model", orientation);
+        m_Impostor.Bind(shader);
+        // the quad faces the camera whichever way the instance is turned, its winding doesn't
+        glDisable(GL_CULL_FACE);
+        glBindVertexArray(m_ImpostorVAO);
+        pointInstances(m_LevelStart[IMPOSTOR_LOD]);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+        glBindVertexArray(0);
+        glEnable(GL_CULL_FACE);
+        TriangleCount triangles;
+        triangles.submitted = 2LL * count;
+        triangles.full = model.Triangles(0, count).full;
+        m_Triangles += triangles;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_CROWD_H
@@ -0,0 +1,202 @@
+//
+// Offscreen scene target whose resolution follows the measured GPU time, and the controller picking it.
+//
+
+#ifndef PROJECT_BASE_DYNAMICRESOLUTION_H
+#define PROJECT_BASE_DYNAMICRESOLUTION_H
+
+#include <glad/glad.h>
+#include <rg/Error.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace rg {
+
+// Color texture and depth buffer allocated at the window's size, the scene is drawn into the lower
+// left corner at whatever scale is current. Changing the scale is just a different viewport, only a
+// window resize reallocates. Passes that fade against the scene's depth read a copy of it, taken with
+// CopyDepth, as the depth buffer itself is still being tested against.
+class ScaledRenderTarget {
+public:
+    ScaledRenderTarget() = default;
+    ScaledRenderTarget(const ScaledRenderTarget&) = delete;
+    ScaledRenderTarget& operator=(const ScaledRenderTarget&) = delete;
+
+    ~ScaledRenderTarget() {
+        Release();
+    }
+
+    // needs the context current, call before it goes away
+    void Release() {
+        glDeleteFramebuffers(1, &m_Framebuffer);
+        glDeleteTextures(1, &m_Color);
+        glDeleteRenderbuffers(1, &m_Depth);
+        glDeleteFramebuffers(1, &m_DepthCopyFramebuffer);
+        glDeleteTextures(1, &m_DepthCopy);
+        m_Framebuffer = m_Color = m_Depth = 0;
+        m_DepthCopyFramebuffer = m_DepthCopy = 0;
+        m_Width = m_Height = 0;
+    }
+
+    // a minimized window reports 0 x 0, the old buffers are kept then
+    void Resize(int width, int height) {
+        if (width <= 0 || height <= 0 || (width == m_Width && height == m_Height)) {
+            return;
+        }
+        Release();
+        m_Width = width;
+        m_Height = height;
+
+        glGenTextures(1, &m_Color);
+        glBindTexture(GL_TEXTURE_2D, m_Color);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        labelObject(GL_TEXTURE, m_Color, "scene color");
+
+        glGenRenderbuffers(1, &m_Depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_Depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        labelObject(GL_RENDERBUFFER, m_Depth, "scene depth");
+
+        glGenFramebuffers(1, &m_Framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Color, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_Depth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "[ScaledRenderTarget] framebuffer of " << width << "x" << height << " is not complete"
+                      << std::endl;
+        }
+        labelObject(GL_FRAMEBUFFER, m_Framebuffer, "scene");
+
+        // same format as the depth buffer, blits between them are plain copies
+        glGenTextures(1, &m_DepthCopy);
+        glBindTexture(GL_TEXTURE_2D, m_DepthCopy);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL,
+                     GL_UNSIGNED_INT_24_8, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        labelObject(GL_TEXTURE, m_DepthCopy, "scene depth copy");
+        glGenFramebuffers(1, &m_DepthCopyFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_DepthCopyFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_DepthCopy, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        labelObject(GL_FRAMEBUFFER, m_DepthCopyFramebuffer, "scene depth copy");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds the target with the viewport covering scale of it in each direction
+    void Bind(float scale) {
+        m_ScaledWidth = std::max(1, (int) std::lround(m_Width * scale));
+        m_ScaledHeight = std::max(1, (int) std::lround(m_Height * scale));
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        glViewport(0, 0, m_ScaledWidth, m_ScaledHeight);
+    }
+
+    unsigned int Texture() const {
+        return m_Color;
+    }
+
+    // copies the depth of the region the last Bind drew into, leaves the target bound
+    void CopyDepth() {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_Framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_DepthCopyFramebuffer);
+        glBlitFramebuffer(0, 0, m_ScaledWidth, m_ScaledHeight, 0, 0, m_ScaledWidth, m_ScaledHeight,
+                          GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+    }
+
+    // of the last CopyDepth, window sized like the target
+    unsigned int DepthTexture() const {
+        return m_DepthCopy;
+    }
+
+    int Width() const {
+        return m_Width;
+    }
+
+    int Height() const {
+        return m_Height;
+    }
+
+    // size of the region the last Bind drew into
+    int ScaledWidth() const {
+        return m_ScaledWidth;
+    }
+
+    int ScaledHeight() const {
+        return m_ScaledHeight;
+    }
+
+private:
+    unsigned int m_Framebuffer = 0;
+    unsigned int m_Color = 0;
+    unsigned int m_Depth = 0;
+    unsigned int m_DepthCopy = 0;
+    unsigned int m_DepthCopyFramebuffer = 0;
+    int m_Width = 0;
+    int m_Height = 0;
+    int m_ScaledWidth = 0;
+    int m_ScaledHeight = 0;
+};
+
+// Picks the render scale from the smoothed GPU time of the passes that scale with resolution. Pixel
+// cost goes with the square of the scale, so the scale moves by the square root of how far the time
+// is off. It only moves when the time leaves a band around the budget and then at most every
+// Interval frames, which gives the timers (a few frames late, smoothed over about a second) time to
+// show the effect of the last change; without that it would oscillate.
+class DynamicResolution {
+public:
+    bool Enabled = true;
+    float BudgetMs = 14.0f;
+    float MinScale = 0.5f;
+    float MaxScale = 1.0f;
+    int Interval = 30;
+    // of the upscale, it fades out towards scale 1 where there is nothing to make up for
+    float Sharpness = 0.6f;
+
+    // once per frame, returns the scale to render at
+    float Update(float gpuMs) {
+        if (!Enabled) {
+            m_Scale = MaxScale;
+            return m_Scale;
+        }
+        if (++m_Frames < Interval || gpuMs <= 0.0f) {
+            return m_Scale;
+        }
+        bool over = gpuMs > BudgetMs * 0.95f;
+        bool under = gpuMs < BudgetMs * 0.75f && m_Scale < MaxScale;
+        if (over || under) {
+            float wanted = m_Scale * std::sqrt(BudgetMs * 0.85f / gpuMs);
+            wanted = std::min(std::max(wanted, m_Scale * 0.9f), m_Scale * 1.1f);
+            m_Scale = std::min(std::max(wanted, MinScale), MaxScale);
+            m_Frames = 0;
+        }
+        return m_Scale;
+    }
+
+    float Scale() const {
+        return m_Scale;
+    }
+
+    // full Sharpness from an upscale of 1.5x on
+    float UpscaleSharpness() const {
+        return Sharpness * std::min(std::max((1.0f / m_Scale - 1.0f) * 2.0f, 0.0f), 1.0f);
+    }
+
+private:
+    float m_Scale = 1.0f;
+    int m_Frames = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_DYNAMICRESOLUTION_H
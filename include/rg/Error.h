@@ -5,28 +5,37 @@
 #ifndef PROJECT_BASE_ERROR_H
 #define PROJECT_BASE_ERROR_H
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
 #include <glad/glad.h>
+#include <rg/GLExtensions.h>
 
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
-#define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+
+// Debug builds get GL errors from the debug output callback (installDebugOutput) without stalling, and
+// poll glGetError once a frame (pollOpenGLErrors) when the context has no KHR_debug. Release builds
+// (NDEBUG) check nothing.
 
 namespace rg {
 
-    
-void clearAllOpenGlErrors();
-const char* openGLErrorToString(GLenum error);
-bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call);
+    // set once the callback is installed on the render context; the loader's context installs it too
+    inline std::atomic<bool>& debugOutputInstalled() {
+        static std::atomic<bool> installed(false);
+        return installed;
+    }
 
-    void clearAllOpenGlErrors() {
+    inline void clearAllOpenGlErrors() {
         while (glGetError() != GL_NO_ERROR) {
             ;
         }
     }
-    const char* openGLErrorToString(GLenum error) {
+    inline const char* openGLErrorToString(GLenum error) {
         switch(error) {
             case GL_NO_ERROR: return "GL_NO_ERROR";
             case GL_INVALID_ENUM: return "GL_INVALID_ENUM";
@@ -37,7 +46,7 @@ bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* cal
         ASSERT(false, "Passed something that is not an error code");
         return "THIS_SHOULD_NEVER_HAPPEN";
     }
-    bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call) {
+    inline bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call) {
         bool success = true;
         while (GLenum error = glGetError()) {
             std::cerr << "[OpenGL error] " << error << " " << openGLErrorToString(error)
@@ -50,5 +59,100 @@ bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* cal
         return success;
     }
 
+    inline const char* debugSourceToString(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API: return "api";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION: return "application";
+        }
+        return "other";
+    }
+    inline const char* debugTypeToString(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR: return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+        }
+        return "other";
+    }
+    inline const char* debugSeverityToString(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH: return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+            case GL_DEBUG_SEVERITY_LOW: return "low";
+        }
+        return "notification";
+    }
+
+    // Output is synchronous, so this runs on the thread of the offending call and a breakpoint here
+    // stops right at it. The same performance warning tends to come every frame, so each message
+    // is only reported a few times.
+    inline void APIENTRY debugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                              GLsizei length, const GLchar* message, const void* userParam) {
+        static std::mutex mutex;
+        static std::map<std::uint64_t, int> reported;
+        int count;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::uint64_t key = ((std::uint64_t) source << 48) ^ ((std::uint64_t) type << 32) ^ id;
+            count = ++reported[key];
+        }
+        if (count > 5) {
+            return;
+        }
+        std::cerr << "[OpenGL " << debugTypeToString(type) << ", " << debugSeverityToString(severity) << ", "
+        << debugSourceToString(source) << "] " << message << (count == 5 ? " (not reported again)" : "") << '\n';
+    }
+
+    // on the current context, the render context and the loader's each need it. Returns false when
+    // errors have to be polled: no KHR_debug, or a release build where nothing is checked at all.
+    inline bool installDebugOutput() {
+#ifdef NDEBUG
+        return false;
+#else
+        const GLExtensionFunctions& ext = glExtensions();
+        if (!ext.debugOutput) {
+            return false;
+        }
+        glEnable(GL_DEBUG_OUTPUT);
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        ext.DebugMessageCallback(debugMessageCallback, nullptr);
+        ext.DebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+        GLint flags = 0;
+        glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+        if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT) && !debugOutputInstalled()) {
+            std::cout << "[OpenGL] not a debug context, the driver may report little" << std::endl;
+        }
+        debugOutputInstalled() = true;
+        return true;
+#endif
+    }
+
+    // reports the errors of everything since the last call, once a frame on the render thread of a debug
+    // build without debug output; where the callback reports them, or in release builds, it does nothing
+    inline void pollOpenGLErrors(const char* file, int line) {
+#ifndef NDEBUG
+        if (!debugOutputInstalled()) {
+            wasPreviousOpenGLCallSuccessful(file, line, "the frame's calls");
+        }
+#endif
+    }
+
+    // names an object in debug messages and graphics debuggers; it has to exist, i.e. have been bound once
+    inline void labelObject(GLenum identifier, GLuint name, const std::string& label) {
+#ifndef NDEBUG
+        if (name == 0 || !glExtensions().debugOutput) {
+            return;
+        }
+        // GL_MAX_LABEL_LENGTH is at least 256, the end of a long path is the telling part
+        std::string text = label.size() > 255 ? label.substr(label.size() - 255) : label;
+        glExtensions().ObjectLabel(identifier, name, (GLsizei) text.size(), text.c_str());
+#endif
+    }
+
 };
 #endif //PROJECT_BASE_ERROR_H
@@ -0,0 +1,71 @@
+//
+// Simulation clock that advances in fixed steps no matter how fast frames are rendered.
+//
+
+#ifndef PROJECT_BASE_FIXEDTIMESTEP_H
+#define PROJECT_BASE_FIXEDTIMESTEP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace rg {
+
+// Frame time goes into an accumulator and comes out as whole steps, the remainder is carried over.
+// Rendering draws the state between the last two steps, Alpha of the way, so motion stays smooth at
+// any frame rate while the simulation itself only ever sees the same step length. A long stall (a
+// breakpoint, a resize) would otherwise ask for hundreds of steps at once, anything beyond MaxSteps
+// in one frame is dropped and the simulation falls behind the wall clock instead.
+class FixedTimestep {
+public:
+    explicit FixedTimestep(double stepSeconds, int maxSteps = 8)
+            : m_StepSeconds(stepSeconds), m_MaxSteps(maxSteps) {
+    }
+
+    // adds one frame's time, returns how many steps to simulate now
+    int Advance(double frameSeconds) {
+        m_Accumulator += std::max(frameSeconds, 0.0);
+        // a hair of tolerance so that frames summing up to exactly one step give one step
+        int steps = (int) std::min(std::floor(m_Accumulator / m_StepSeconds + 1e-6), (double) m_MaxSteps);
+        m_Accumulator = std::max(m_Accumulator - steps * m_StepSeconds, 0.0);
+        if (steps == m_MaxSteps && m_Accumulator >= m_StepSeconds) {
+            m_DroppedSeconds += m_Accumulator;
+            m_Accumulator = 0.0;
+        }
+        m_Steps += steps;
+        return steps;
+    }
+
+    // how far between the previous and the latest step the rendered state is, in [0, 1)
+    float Alpha() const {
+        return (float) (m_Accumulator / m_StepSeconds);
+    }
+
+    // simulation time of the rendered state, one step behind the latest at most
+    double Time() const {
+        return std::max((m_Steps - 1) * m_StepSeconds + m_Accumulator, 0.0);
+    }
+
+    double StepSeconds() const {
+        return m_StepSeconds;
+    }
+
+    std::int64_t Steps() const {
+        return m_Steps;
+    }
+
+    double DroppedSeconds() const {
+        return m_DroppedSeconds;
+    }
+
+private:
+    double m_StepSeconds;
+    int m_MaxSteps;
+    double m_Accumulator = 0.0;
+    double m_DroppedSeconds = 0.0;
+    std::int64_t m_Steps = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_FIXEDTIMESTEP_H
@@ -0,0 +1,120 @@
+//
+// Worker thread that builds the next frame's packet while the render thread draws the current one.
+//
+
+#ifndef PROJECT_BASE_FRAMEPIPELINE_H
+#define PROJECT_BASE_FRAMEPIPELINE_H
+
+#include <rg/FrameProfiler.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace rg {
+
+// Two packets: the render thread only reads the current one, the worker only writes the other.
+// Kick copies the input for the next frame and wakes the worker, Wait blocks until that packet is
+// done and makes it current, so Kick and Wait have to alternate. Packets are reused, containers in
+// them keep their capacity and a steady frame allocates nothing. Without a worker thread (before
+// Start, or after Stop) Kick runs the update right away.
+template<typename Input, typename Packet>
+class FramePipeline {
+public:
+    typedef std::function<void(const Input&, Packet&)> Update;
+
+    explicit FramePipeline(Update update) : m_Update(std::move(update)) {
+    }
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    ~FramePipeline() {
+        Stop();
+    }
+
+    void Start(const std::string& threadName) {
+        m_Running = true;
+        m_Thread = std::thread(&FramePipeline::run, this, threadName);
+    }
+
+    // finishes the packet in progress first
+    void Stop() {
+        if (!m_Thread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Running = false;
+        }
+        m_Wake.notify_one();
+        m_Thread.join();
+    }
+
+    // render thread, starts the next packet
+    void Kick(const Input& input) {
+        if (!m_Thread.joinable()) {
+            m_Input = input;
+            m_Update(m_Input, m_Packets[1 - m_Current]);
+            m_Kicked = true;
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Input = input;
+            m_Kicked = true;
+        }
+        m_Wake.notify_one();
+    }
+
+    // render thread, the packet from the last Kick becomes current
+    void Wait() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Done.wait(lock, [this]() { return !m_Kicked || !m_Thread.joinable(); });
+        m_Kicked = false;
+        m_Current = 1 - m_Current;
+    }
+
+    const Packet& Current() const {
+        return m_Packets[m_Current];
+    }
+
+private:
+    Update m_Update;
+    Input m_Input;
+    Packet m_Packets[2];
+    int m_Current = 0;
+    bool m_Kicked = false;
+    bool m_Running = false;
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::condition_variable m_Done;
+
+    void run(std::string threadName) {
+        FrameProfiler::Instance().NameThread(threadName);
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (true) {
+            m_Wake.wait(lock, [this]() { return m_Kicked || !m_Running; });
+            if (!m_Running) {
+                return;
+            }
+            // the render thread doesn't touch the input or the other packet until Wait
+            Packet& packet = m_Packets[1 - m_Current];
+            lock.unlock();
+            {
+                ProfileZone zone("update");
+                m_Update(m_Input, packet);
+            }
+            lock.lock();
+            m_Kicked = false;
+            m_Done.notify_one();
+        }
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_FRAMEPIPELINE_H
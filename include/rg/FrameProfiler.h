@@ -0,0 +1,257 @@
+//
+// Always-on hierarchical CPU timing zones kept in per-thread ring buffers.
+//
+
+#ifndef PROJECT_BASE_FRAMEPROFILER_H
+#define PROJECT_BASE_FRAMEPROFILER_H
+
+#include <rg/StartupProfiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// events each thread keeps, about a minute of frames at 60 fps with ~20 zones each
+const std::size_t PROFILE_RING_SIZE = 1 << 16;
+// frame boundaries the render thread keeps, for the frame time graph
+const int PROFILE_FRAME_HISTORY = 512;
+
+struct ProfileEvent {
+    const char* name;
+    std::int64_t start; // ns since FrameProfiler::Now's epoch
+    std::int64_t end;
+    int depth;
+};
+
+// Every thread that opens a zone gets its own ring, registered once under a mutex. After that a zone
+// only writes into the ring of its own thread and publishes it with a release store of the head,
+// no locks and no allocations. Readers (the overlay, the trace export) copy events with acquire and
+// drop whatever the writer may have overwritten while they were copying, old events simply fall off
+// the end. Every slot is also a seqlock: it holds the index of the event in it plus one, zero while
+// the writer is in the middle of it, so a copy torn by the writer is never taken for an event.
+// Zones are written when they close, so children come before their parents.
+class FrameProfiler {
+public:
+    struct Slot {
+        std::atomic<std::uint64_t> sequence{0};
+        ProfileEvent event;
+    };
+
+    struct ThreadBuffer {
+        std::string name;
+        std::vector<Slot> slots = std::vector<Slot>(PROFILE_RING_SIZE);
+        std::atomic<std::uint64_t> head{0};
+        int depth = 0; // owning thread only
+    };
+
+    static FrameProfiler& Instance() {
+        static FrameProfiler profiler;
+        return profiler;
+    }
+
+    static std::int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // ring of the calling thread, created on first use
+    ThreadBuffer& LocalBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Buffers.emplace_back(new ThreadBuffer());
+            buffer = m_Buffers.back().get();
+            buffer->name = "thread " + std::to_string(m_Buffers.size());
+        }
+        return *buffer;
+    }
+
+    void NameThread(const std::string& name) {
+        ThreadBuffer& buffer = LocalBuffer();
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        buffer.name = name;
+    }
+
+    void Write(ThreadBuffer& buffer, const ProfileEvent& event) {
+        std::uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        Slot& slot = buffer.slots[head & (PROFILE_RING_SIZE - 1)];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.event = event;
+        slot.sequence.store(head + 1, std::memory_order_release);
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    // render thread, first thing every frame
+    void BeginFrame() {
+        m_Frames[m_FrameCount % PROFILE_FRAME_HISTORY] = Now();
+        m_FrameCount++;
+    }
+
+    int FrameCount() const {
+        return m_FrameCount;
+    }
+
+    // start of the frame index frames back (0 is the frame in progress), -1 when it isn't kept anymore
+    std::int64_t FrameStart(int framesBack) const {
+        if (framesBack + 1 > m_FrameCount || framesBack + 1 > PROFILE_FRAME_HISTORY) {
+            return -1;
+        }
+        return m_Frames[(m_FrameCount - 1 - framesBack) % PROFILE_FRAME_HISTORY];
+    }
+
+    // durations of the last count completed frames in ms, oldest first
+    std::vector<float> FrameTimes(int count) const {
+        std::vector<float> times;
+        for (int back = std::min(count, m_FrameCount - 1); back >= 1; --back) {
+            std::int64_t start = FrameStart(back), end = FrameStart(back - 1);
+            if (start >= 0) {
+                times.push_back((float) ((end - start) / 1.0e6));
+            }
+        }
+        return times;
+    }
+
+    // calls visitor with the ring of every thread that ever opened a zone
+    template<typename Visitor>
+    void ForEachThread(Visitor visitor) {
+        std::vector<ThreadBuffer*> buffers;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for (auto& buffer : m_Buffers) {
+                buffers.push_back(buffer.get());
+            }
+        }
+        for (ThreadBuffer* buffer : buffers) {
+            visitor(*buffer);
+        }
+    }
+
+    // copies the events of one thread that overlap [from, to), in start order
+    static std::vector<ProfileEvent> Events(const ThreadBuffer& buffer, std::int64_t from, std::int64_t to) {
+        std::vector<ProfileEvent> events;
+        std::uint64_t head = buffer.head.load(std::memory_order_acquire);
+        std::uint64_t first = head > PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE : 0;
+        std::vector<std::uint64_t> indices;
+        // events are written as they close, so end times only grow and the walk back can stop early; a
+        // slot no longer holding its event means the writer has lapped us, everything older is gone too
+        for (std::uint64_t i = head; i > first; --i) {
+            ProfileEvent event;
+            if (!readSlot(buffer.slots[(i - 1) & (PROFILE_RING_SIZE - 1)], i - 1, event)) {
+                break;
+            }
+            if (event.end < from) {
+                break;
+            }
+            if (event.start < to) {
+                events.push_back(event);
+                indices.push_back(i - 1);
+            }
+        }
+        // anything the writer could have reached while we were copying is unreliable, including the slot
+        // of the event it may be writing now, which is the one of index head - PROFILE_RING_SIZE
+        std::uint64_t overwritten = buffer.head.load(std::memory_order_acquire);
+        bool lapped = overwritten >= PROFILE_RING_SIZE;
+        overwritten = lapped ? overwritten - PROFILE_RING_SIZE : 0;
+        std::vector<ProfileEvent> valid;
+        for (unsigned int i = 0; i < events.size(); ++i) {
+            if (!lapped || indices[i] > overwritten) {
+                valid.push_back(events[i]);
+            }
+        }
+        std::sort(valid.begin(), valid.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+            return a.start < b.start || (a.start == b.start && a.depth < b.depth);
+        });
+        return valid;
+    }
+
+    // writes the zones of the last seconds of every thread as Chrome trace JSON
+    bool ExportTrace(const std::string& path, double seconds) {
+        std::int64_t to = Now();
+        std::int64_t from = to - (std::int64_t) (seconds * 1.0e9);
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "[FrameProfiler] failed to write " << path << std::endl;
+            return false;
+        }
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        bool first = true;
+        int thread = 0, count = 0;
+        ForEachThread([&](const ThreadBuffer& buffer) {
+            thread++;
+            std::string name = ThreadName(buffer);
+            out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+                << thread << ", \"args\": {\"name\": \"" << jsonEscape(name) << "\"}}";
+            first = false;
+            for (const ProfileEvent& event : Events(buffer, from, to)) {
+                out << ",\n{\"name\": \"" << jsonEscape(event.name) << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                    << thread << ", \"ts\": " << (event.start - from) / 1000.0 << ", \"dur\": "
+                    << (event.end - event.start) / 1000.0 << "}";
+                count++;
+            }
+        });
+        out << "\n]}\n";
+        std::cout << "[FrameProfiler] " << count << " zones of the last " << seconds << " s written to " << path
+                  << std::endl;
+        return true;
+    }
+
+    std::string ThreadName(const ThreadBuffer& buffer) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return buffer.name;
+    }
+
+private:
+    std::mutex m_Mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_Buffers;
+    // render thread only
+    std::int64_t m_Frames[PROFILE_FRAME_HISTORY] = {};
+    int m_FrameCount = 0;
+
+    FrameProfiler() = default;
+
+    // the event of the given index if the slot holds all of it
+    static bool readSlot(const Slot& slot, std::uint64_t index, ProfileEvent& event) {
+        std::uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        event = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+        return before == index + 1 && after == index + 1;
+    }
+};
+
+// Times the enclosing scope on the calling thread; name has to outlive the profiler, i.e. be a literal.
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name)
+            : m_Buffer(FrameProfiler::Instance().LocalBuffer()), m_Name(name), m_Depth(m_Buffer.depth++),
+              m_Start(FrameProfiler::Now()) {
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+    ~ProfileZone() {
+        m_Buffer.depth--;
+        FrameProfiler::Instance().Write(m_Buffer, {m_Name, m_Start, FrameProfiler::Now(), m_Depth});
+    }
+
+private:
+    FrameProfiler::ThreadBuffer& m_Buffer;
+    const char* m_Name;
+    int m_Depth;
+    std::int64_t m_Start;
+};
+
+};
+
+#endif //PROJECT_BASE_FRAMEPROFILER_H
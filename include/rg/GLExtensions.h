@@ -0,0 +1,167 @@
+//
+// Entry points and tokens that are not part of the GL 3.3 core profile glad was generated for.
+// They are loaded at runtime and left null when the driver doesn't expose them.
+//
+
+#ifndef PROJECT_BASE_GLEXTENSIONS_H
+#define PROJECT_BASE_GLEXTENSIONS_H
+
+#include <glad/glad.h>
+#include <cstring>
+
+// GL 4.1 / ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// GL 4.3 / KHR_debug
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_SOURCE_OTHER 0x824B
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_OTHER 0x8251
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_BUFFER 0x82E0
+#define GL_SHADER 0x82E1
+#define GL_PROGRAM 0x82E2
+#define GL_MAX_LABEL_LENGTH 0x82E8
+#endif
+// GL 4.4 / ARB_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+// compatibility profile token that KHR_debug reuses to label vertex array objects
+#ifndef GL_VERTEX_ARRAY
+#define GL_VERTEX_ARRAY 0x8074
+#endif
+
+typedef void (APIENTRYP PFNRGMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+typedef void (APIENTRYP PFNRGGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length,
+                                                   GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNRGPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary,
+                                                GLsizei length);
+typedef void (APIENTRYP PFNRGPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNRGDEBUGMESSAGECALLBACKPROC)(GLDEBUGPROC callback, const void *userParam);
+typedef void (APIENTRYP PFNRGDEBUGMESSAGECONTROLPROC)(GLenum source, GLenum type, GLenum severity, GLsizei count,
+                                                      const GLuint *ids, GLboolean enabled);
+typedef void (APIENTRYP PFNRGOBJECTLABELPROC)(GLenum identifier, GLuint name, GLsizei length, const GLchar *label);
+typedef void (APIENTRYP PFNRGBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+namespace rg {
+
+struct GLExtensionFunctions {
+    int versionMajor = 0;
+    int versionMinor = 0;
+    // width and height a 2D texture may have, GL 3.3 guarantees 1024
+    int maxTextureSize = 1024;
+
+    bool programBinary = false;
+    PFNRGGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+    PFNRGPROGRAMBINARYPROC ProgramBinary = nullptr;
+    PFNRGPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+    bool parallelShaderCompile = false;
+    PFNRGMAXSHADERCOMPILERTHREADSPROC MaxShaderCompilerThreads = nullptr;
+
+    bool debugOutput = false;
+    PFNRGDEBUGMESSAGECALLBACKPROC DebugMessageCallback = nullptr;
+    PFNRGDEBUGMESSAGECONTROLPROC DebugMessageControl = nullptr;
+    PFNRGOBJECTLABELPROC ObjectLabel = nullptr;
+
+    bool bufferStorage = false;
+    PFNRGBUFFERSTORAGEPROC BufferStorage = nullptr;
+};
+
+inline GLExtensionFunctions& glExtensions() {
+    static GLExtensionFunctions extensions;
+    return extensions;
+}
+
+inline bool hasGLExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* extension = (const char*) glGetStringi(GL_EXTENSIONS, i);
+        if (extension && std::strcmp(extension, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool hasGLVersion(int major, int minor) {
+    const GLExtensionFunctions& ext = glExtensions();
+    return ext.versionMajor > major || (ext.versionMajor == major && ext.versionMinor >= minor);
+}
+
+// has to be called once, after gladLoadGLLoader, with the context current
+inline void loadGLExtensions(GLADloadproc load) {
+    GLExtensionFunctions& ext = glExtensions();
+    glGetIntegerv(GL_MAJOR_VERSION, &ext.versionMajor);
+    glGetIntegerv(GL_MINOR_VERSION, &ext.versionMinor);
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &ext.maxTextureSize);
+
+    if (hasGLVersion(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) {
+        ext.GetProgramBinary = (PFNRGGETPROGRAMBINARYPROC) load("glGetProgramBinary");
+        ext.ProgramBinary = (PFNRGPROGRAMBINARYPROC) load("glProgramBinary");
+        ext.ProgramParameteri = (PFNRGPROGRAMPARAMETERIPROC) load("glProgramParameteri");
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        ext.programBinary = ext.GetProgramBinary && ext.ProgramBinary && ext.ProgramParameteri && formats > 0;
+    }
+
+    if (hasGLExtension("GL_KHR_parallel_shader_compile")) {
+        ext.MaxShaderCompilerThreads = (PFNRGMAXSHADERCOMPILERTHREADSPROC) load("glMaxShaderCompilerThreadsKHR");
+    } else if (hasGLExtension("GL_ARB_parallel_shader_compile")) {
+        ext.MaxShaderCompilerThreads = (PFNRGMAXSHADERCOMPILERTHREADSPROC) load("glMaxShaderCompilerThreadsARB");
+    }
+    if (ext.MaxShaderCompilerThreads) {
+        // let the driver pick how many threads compile in the background
+        ext.MaxShaderCompilerThreads(0xFFFFFFFF);
+        ext.parallelShaderCompile = true;
+    }
+
+    // desktop KHR_debug uses the unsuffixed core names
+    if (hasGLVersion(4, 3) || hasGLExtension("GL_KHR_debug")) {
+        ext.DebugMessageCallback = (PFNRGDEBUGMESSAGECALLBACKPROC) load("glDebugMessageCallback");
+        ext.DebugMessageControl = (PFNRGDEBUGMESSAGECONTROLPROC) load("glDebugMessageControl");
+        ext.ObjectLabel = (PFNRGOBJECTLABELPROC) load("glObjectLabel");
+        ext.debugOutput = ext.DebugMessageCallback && ext.DebugMessageControl && ext.ObjectLabel;
+    }
+
+    if (hasGLVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage")) {
+        ext.BufferStorage = (PFNRGBUFFERSTORAGEPROC) load("glBufferStorage");
+        ext.bufferStorage = ext.BufferStorage != nullptr;
+    }
+}
+
+};
+
+#endif //PROJECT_BASE_GLEXTENSIONS_H
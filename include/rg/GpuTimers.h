@@ -0,0 +1,234 @@
+//
+// GL_TIME_ELAPSED queries per draw, read back a few frames later so the CPU never waits for them.
+//
+
+#ifndef PROJECT_BASE_GPUTIMERS_H
+#define PROJECT_BASE_GPUTIMERS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// frames a query result may take to arrive before its slot is reused
+const int GPU_TIMER_LATENCY = 3;
+// a timer not issued for this many frames (a model streamed out, a level of detail nobody is at) counts
+// as gone: its average is 0 and the profiler leaves it out
+const int GPU_TIMER_IDLE_FRAMES = 60;
+
+// Each named timer owns one query per frame in flight. A frame's queries are read back when their
+// slot comes around again, GPU_TIMER_LATENCY frames later, by which time the GPU is normally done;
+// a result that still isn't available is dropped rather than waited for. Time elapsed queries can't
+// nest, so only leaves (a model, the skybox) are timed and a pass is the sum of the timers filed
+// under it. Render thread only.
+class GpuTimers {
+public:
+    struct Timer {
+        const char* name;
+        const char* pass;
+        GLuint queries[GPU_TIMER_LATENCY];
+        bool issued[GPU_TIMER_LATENCY];
+        float lastMs;     // latest frame it was drawn in
+        float averageMs;  // smoothed over roughly the last second
+        double totalMs;   // since ResetStats, for benchmarks
+        int samples;
+        int idleFrames;   // read back in a row without having been issued
+
+        bool Idle() const {
+            return idleFrames >= GPU_TIMER_IDLE_FRAMES;
+        }
+    };
+
+    GpuTimers() = default;
+    GpuTimers(const GpuTimers&) = delete;
+    GpuTimers& operator=(const GpuTimers&) = delete;
+
+    ~GpuTimers() {
+        Release();
+    }
+
+    // needs the context current, call before it goes away
+    void Release() {
+        for (Timer& timer : m_Timers) {
+            glDeleteQueries(GPU_TIMER_LATENCY, timer.queries);
+        }
+        m_Timers.clear();
+    }
+
+    // first thing every frame, collects what the frame GPU_TIMER_LATENCY ago measured. A timer that
+    // frame didn't issue took no time in it, so its average decays towards 0 rather than holding on to
+    // what it last measured, which would keep counting in FrameAverageMs and the dynamic resolution.
+    void BeginFrame() {
+        m_Frame++;
+        int slot = m_Frame % GPU_TIMER_LATENCY;
+        for (Timer& timer : m_Timers) {
+            if (!timer.issued[slot]) {
+                timer.idleFrames++;
+                timer.averageMs = timer.Idle() ? 0.0f : 0.95f * timer.averageMs;
+                continue;
+            }
+            timer.issued[slot] = false;
+            timer.idleFrames = 0;
+            GLint available = 0;
+            glGetQueryObjectiv(timer.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                m_Dropped++;
+                continue;
+            }
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(timer.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+            // no draw takes a second, some drivers return garbage for the first query of a context
+            if (nanoseconds > 1000000000ull) {
+                m_Dropped++;
+                continue;
+            }
+            timer.lastMs = (float) (nanoseconds / 1.0e6);
+            if (timer.samples == 0) {
+                timer.averageMs = timer.lastMs;
+            }
+            timer.averageMs += 0.05f * (timer.lastMs - timer.averageMs);
+            timer.totalMs += timer.lastMs;
+            timer.samples++;
+        }
+    }
+
+    // returns false (and times nothing) while another timer is running
+    bool Begin(const char* name, const char* pass) {
+        if (m_Active) {
+            return false;
+        }
+        m_Active = &timerFor(name, pass);
+        int slot = m_Frame % GPU_TIMER_LATENCY;
+        glBeginQuery(GL_TIME_ELAPSED, m_Active->queries[slot]);
+        m_Active->issued[slot] = true;
+        return true;
+    }
+
+    void End() {
+        if (m_Active) {
+            glEndQuery(GL_TIME_ELAPSED);
+            m_Active = nullptr;
+        }
+    }
+
+    const std::vector<Timer>& Timers() const {
+        return m_Timers;
+    }
+
+    // passes in the order their first timer was created
+    std::vector<const char*> Passes() const {
+        std::vector<const char*> passes;
+        for (const Timer& timer : m_Timers) {
+            bool known = false;
+            for (const char* pass : passes) {
+                known = known || std::strcmp(pass, timer.pass) == 0;
+            }
+            if (!known) {
+                passes.push_back(timer.pass);
+            }
+        }
+        return passes;
+    }
+
+    // every timer of the pass is Idle
+    bool PassIdle(const char* pass) const {
+        for (const Timer& timer : m_Timers) {
+            if (!timer.Idle() && std::strcmp(timer.pass, pass) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    float PassAverageMs(const char* pass) const {
+        float sum = 0.0f;
+        for (const Timer& timer : m_Timers) {
+            if (std::strcmp(timer.pass, pass) == 0) {
+                sum += timer.averageMs;
+            }
+        }
+        return sum;
+    }
+
+    // smoothed time of a whole frame, leaving out the passes listed
+    float FrameAverageMs(std::initializer_list<const char*> excluded = {}) const {
+        float sum = 0.0f;
+        for (const Timer& timer : m_Timers) {
+            bool skip = false;
+            for (const char* pass : excluded) {
+                skip = skip || std::strcmp(pass, timer.pass) == 0;
+            }
+            if (!skip) {
+                sum += timer.averageMs;
+            }
+        }
+        return sum;
+    }
+
+    // starts the totals over, e.g. once a benchmark begins
+    void ResetStats() {
+        for (Timer& timer : m_Timers) {
+            timer.totalMs = 0.0;
+            timer.samples = 0;
+        }
+        m_StatsFrame = m_Frame;
+        m_Dropped = 0;
+    }
+
+    // frames since ResetStats
+    int Frames() const {
+        return m_Frame - m_StatsFrame;
+    }
+
+    int Dropped() const {
+        return m_Dropped;
+    }
+
+private:
+    std::vector<Timer> m_Timers;
+    Timer* m_Active = nullptr;
+    int m_Frame = 0;
+    int m_StatsFrame = 0;
+    int m_Dropped = 0;
+
+    Timer& timerFor(const char* name, const char* pass) {
+        for (Timer& timer : m_Timers) {
+            if (timer.name == name || std::strcmp(timer.name, name) == 0) {
+                return timer;
+            }
+        }
+        Timer timer = {name, pass, {}, {}, 0.0f, 0.0f, 0.0, 0, 0};
+        glGenQueries(GPU_TIMER_LATENCY, timer.queries);
+        m_Timers.push_back(timer);
+        return m_Timers.back();
+    }
+};
+
+// times the enclosing scope on the GPU; name and pass have to be literals
+class GpuZone {
+public:
+    GpuZone(GpuTimers& timers, const char* name, const char* pass)
+            : m_Timers(timers), m_Started(timers.Begin(name, pass)) {
+    }
+
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+
+    ~GpuZone() {
+        if (m_Started) {
+            m_Timers.End();
+        }
+    }
+
+private:
+    GpuTimers& m_Timers;
+    bool m_Started;
+};
+
+};
+
+#endif //PROJECT_BASE_GPUTIMERS_H
@@ -0,0 +1,221 @@
+//
+// Octahedral impostors: a model baked from views all around it, drawn far away as a single quad.
+//
+
+#ifndef PROJECT_BASE_IMPOSTOR_H
+#define PROJECT_BASE_IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace rg {
+
+// texture units of the atlas in the draw program
+const int IMPOSTOR_ALBEDO_UNIT = 0;
+const int IMPOSTOR_NORMAL_UNIT = 1;
+
+// The atlas is a FRAMES x FRAMES grid of views of the model in its rest pose, one per point of a grid over
+// the octahedral map of the sphere, so the model is seen from every direction about evenly. Each view is
+// an orthographic projection of the bounding sphere onto a CELL x CELL cell, with the diffuse color in one
+// texture and the model space normal and the height above the plane through the center, in radii, in the
+// other. Both are premultiplied by coverage (1 where the model is, 0 around it), so the mip levels average
+// into something that can be divided out again.
+// The draw program (impostor.vs/.fs) turns a quad towards the camera, finds the three views around the
+// direction it is seen from and blends them by closeness. Every view is sampled where the ray through the
+// fragment meets the plane it was baked on, which keeps the blend from smearing as the camera moves, and
+// the blended normal and height are lit like the model itself would be.
+class Impostor {
+public:
+    static const int FRAMES = 12;
+    static const int CELL = 64;
+    // mip levels below a few texels per cell only bleed the views into each other
+    static const int MAX_LEVEL = 4;
+
+    Impostor() = default;
+
+    Impostor(const Impostor&) = delete;
+    Impostor& operator=(const Impostor&) = delete;
+
+    ~Impostor() {
+        Release();
+    }
+
+    // needs the context current, call before it goes away
+    void Release() {
+        glDeleteTextures(1, &m_Albedo);
+        glDeleteTextures(1, &m_Normals);
+        glDeleteFramebuffers(1, &m_Framebuffer);
+        glDeleteRenderbuffers(1, &m_Depth);
+        m_Albedo = m_Normals = m_Framebuffer = m_Depth = 0;
+        m_Baked = 0;
+    }
+
+    // every view is baked
+    bool Ready() const {
+        return m_Albedo != 0 && m_Baked == FRAMES * FRAMES;
+    }
+
+    // the direction from the model's center towards the camera of the view in cell (x, y)
+    static glm::vec3 FrameDirection(int x, int y) {
+        glm::vec2 p = glm::vec2((float) x, (float) y) / (float) (FRAMES - 1) * 2.0f - 1.0f;
+        glm::vec3 direction(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+        if (direction.z < 0.0f) {
+            float folded = direction.x;
+            direction.x = (1.0f - std::abs(direction.y)) * (folded >= 0.0f ? 1.0f : -1.0f);
+            direction.y = (1.0f - std::abs(folded)) * (direction.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return glm::normalize(direction);
+    }
+
+    // the cell's right and up, the same as frameBasis in impostor.vs
+    static void FrameBasis(glm::vec3 direction, glm::vec3& right, glm::vec3& up) {
+        glm::vec3 worldUp = std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        right = glm::normalize(glm::cross(worldUp, direction));
+        up = glm::cross(direction, right);
+    }
+
+    // renders up to views more of the views with the bake program (impostor_bake.vs/.fs), from where the
+    // last call stopped, so a bake can be spread over several frames; the model has to stay the same until
+    // the impostor is Ready. The framebuffer, viewport and blending it changes are put back.
+    void Bake(Model& model, Shader& bakeShader, int views = FRAMES * FRAMES) {
+        if (Ready()) {
+            return;
+        }
+        const int size = FRAMES * CELL;
+        GLint previousFramebuffer = 0;
+        GLint previousViewport[4];
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        GLboolean blend = glIsEnabled(GL_BLEND);
+
+        if (m_Albedo == 0) {
+            m_Center = model.BoundingCenter();
+            m_Radius = std::max(model.BoundingRadius(), 1e-4f);
+            m_Albedo = createTexture(GL_RGBA8, GL_UNSIGNED_BYTE, size, model.directory + " impostor albedo");
+            m_Normals = createTexture(GL_RGBA16F, GL_FLOAT, size, model.directory + " impostor normals");
+            glGenFramebuffers(1, &m_Framebuffer);
+            glGenRenderbuffers(1, &m_Depth);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_Depth);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Albedo, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_Normals, 0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_Depth);
+            GLenum buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+            glDrawBuffers(2, buffers);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cout << "[Impostor] " << model.directory << ": framebuffer incomplete" << std::endl;
+            }
+            glViewport(0, 0, size, size);
+            const float clear[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            const float far = 1.0f;
+            glClearBufferfv(GL_COLOR, 0, clear);
+            glClearBufferfv(GL_COLOR, 1, clear);
+            glClearBufferfv(GL_DEPTH, 0, &far);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        glDisable(GL_BLEND);
+
+        bakeShader.use();
+        bakeShader.setVec3("impostorCenter", m_Center);
+        bakeShader.setFloat("impostorRadius", m_Radius);
+        bakeShader.setMat4("projection", glm::ortho(-m_Radius, m_Radius, -m_Radius, m_Radius, m_Radius, 3.0f * m_Radius));
+        int last = std::min(m_Baked + std::max(views, 1), FRAMES * FRAMES);
+        for (; m_Baked < last; m_Baked++) {
+            int x = m_Baked % FRAMES, y = m_Baked / FRAMES;
+            glm::vec3 direction = FrameDirection(x, y), right, up;
+            FrameBasis(direction, right, up);
+            glm::vec3 eye = m_Center + 2.0f * m_Radius * direction;
+            glm::mat4 view(1.0f);
+            for (int i = 0; i < 3; i++) {
+                view[i][0] = right[i];
+                view[i][1] = up[i];
+                view[i][2] = direction[i];
+            }
+            view[3] = glm::vec4(-glm::dot(right, eye), -glm::dot(up, eye), -glm::dot(direction, eye), 1.0f);
+            bakeShader.setMat4("view", view);
+            bakeShader.setVec3("frameDirection", direction);
+            glViewport(x * CELL, y * CELL, CELL, CELL);
+            model.Draw(bakeShader);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+        if (blend) {
+            glEnable(GL_BLEND);
+        }
+        if (!Ready()) {
+            return;
+        }
+        glDeleteFramebuffers(1, &m_Framebuffer);
+        glDeleteRenderbuffers(1, &m_Depth);
+        m_Framebuffer = m_Depth = 0;
+        for (unsigned int texture : {m_Albedo, m_Normals}) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        std::cout << "[Impostor] " << model.directory << ": " << FRAMES * FRAMES << " views into " << size << "x"
+                  << size << std::endl;
+    }
+
+    // the atlas and where the model sits in it, with the draw program in use
+    void Bind(Shader& shader) const {
+        shader.setVec3("impostorCenter", m_Center);
+        shader.setFloat("impostorRadius", m_Radius);
+        shader.setInt("impostorFrames", FRAMES);
+        glActiveTexture(GL_TEXTURE0 + IMPOSTOR_ALBEDO_UNIT);
+        glBindTexture(GL_TEXTURE_2D, m_Albedo);
+        glActiveTexture(GL_TEXTURE0 + IMPOSTOR_NORMAL_UNIT);
+        glBindTexture(GL_TEXTURE_2D, m_Normals);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // the samplers of the atlas, once per draw program
+    static void SetSamplers(Shader& shader) {
+        shader.use();
+        shader.setInt("impostorAlbedo", IMPOSTOR_ALBEDO_UNIT);
+        shader.setInt("impostorNormals", IMPOSTOR_NORMAL_UNIT);
+        // the warm-up draw reads no atlas
+        shader.setInt("impostorFrames", FRAMES);
+        shader.setFloat("impostorRadius", 1.0f);
+    }
+
+private:
+    unsigned int m_Albedo = 0;
+    unsigned int m_Normals = 0;
+    // of a bake that is not finished yet
+    unsigned int m_Framebuffer = 0;
+    unsigned int m_Depth = 0;
+    int m_Baked = 0;
+    glm::vec3 m_Center = glm::vec3(0.0f);
+    float m_Radius = 1.0f;
+
+    static unsigned int createTexture(GLenum format, GLenum type, int size, const std::string& label) {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, size, size, 0, GL_RGBA, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MAX_LEVEL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        labelObject(GL_TEXTURE, texture, label);
+        return texture;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_IMPOSTOR_H
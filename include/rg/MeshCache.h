@@ -0,0 +1,170 @@
+//
+// On-disk cache of the levels of detail simplified from imported meshes.
+//
+
+#ifndef PROJECT_BASE_MESHCACHE_H
+#define PROJECT_BASE_MESHCACHE_H
+
+#include <glm/glm.hpp>
+#include <rg/ProgramCache.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+namespace rg {
+
+// bump when the simplifier changes what it makes of the same mesh
+const std::uint32_t MESH_LOD_VERSION = 1;
+
+// The levels of a model are stored as <directory>/<key>.bin, where the key hashes the positions and indices
+// of all its meshes, which is everything the simplifier looks at, so a re-exported model simply misses. An
+// entry holds the error of every level and the indices of every mesh at every level but the first, which is
+// the imported mesh itself; each remembers how long the simplification took, which is what a hit reports
+// as saved. Models are loaded on the loader threads, so every call may come from any of them.
+class MeshCache {
+public:
+    static MeshCache& Instance() {
+        static MeshCache cache;
+        return cache;
+    }
+
+    // before the first model is loaded
+    void SetDirectory(const std::string& directory) {
+        m_Directory = directory;
+    }
+
+    std::uint64_t Key(const std::vector<std::vector<glm::vec3>>& positions,
+                      const std::vector<std::vector<unsigned int>>& indices) const {
+        std::uint64_t hash = hashBytes(&MESH_LOD_VERSION, sizeof(MESH_LOD_VERSION));
+        for (std::size_t i = 0; i < positions.size(); i++) {
+            std::uint64_t sizes[2] = {positions[i].size(), indices[i].size()};
+            hash = hashBytes(sizes, sizeof(sizes), hash);
+            hash = hashBytes(positions[i].data(), positions[i].size() * sizeof(glm::vec3), hash);
+            hash = hashBytes(indices[i].data(), indices[i].size() * sizeof(unsigned int), hash);
+        }
+        return hash;
+    }
+
+    // errors gets one entry per level, levels (errors.size() - 1) * meshes index lists, level by level; on
+    // any mismatch the entry is dropped and false returned
+    bool Load(std::uint64_t key, std::size_t meshes, std::vector<float>& errors,
+              std::vector<std::vector<unsigned int>>& levels) {
+        auto start = std::chrono::steady_clock::now();
+        std::ifstream in(entryPath(key), std::ios::binary);
+        if (!in) {
+            count(m_Misses);
+            return false;
+        }
+        Header header;
+        in.read((char*) &header, sizeof(header));
+        bool valid = in && header.magic == MAGIC && header.key == key && header.meshes == meshes
+                     && header.levels >= 1 && header.levels <= 16;
+        if (valid) {
+            errors.resize(header.levels);
+            in.read((char*) errors.data(), errors.size() * sizeof(float));
+            levels.resize((header.levels - 1) * meshes);
+            for (std::vector<unsigned int>& level : levels) {
+                std::uint32_t size = 0;
+                in.read((char*) &size, sizeof(size));
+                if (!in || size % 3 != 0 || size > (1u << 28)) {
+                    valid = false;
+                    break;
+                }
+                level.resize(size);
+                in.read((char*) level.data(), size * sizeof(unsigned int));
+            }
+            valid = valid && in;
+        }
+        if (!valid) {
+            errors.clear();
+            levels.clear();
+            std::remove(entryPath(key).c_str());
+            count(m_Misses);
+            return false;
+        }
+
+        double loadMs = millisecondsSince(start);
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Hits++;
+        m_SavedMs += header.simplifyMs - loadMs;
+        m_LoadMs += loadMs;
+        return true;
+    }
+
+    void Store(std::uint64_t key, std::size_t meshes, const std::vector<float>& errors,
+               const std::vector<std::vector<unsigned int>>& levels, double simplifyMs) {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_SimplifyMs += simplifyMs;
+        }
+        Header header;
+        header.key = key;
+        header.meshes = (std::uint32_t) meshes;
+        header.levels = (std::uint32_t) errors.size();
+        header.simplifyMs = simplifyMs;
+        // written under another name first, another thread or process never reads half an entry
+        mkdir(m_Directory.c_str(), 0755);
+        std::string path = entryPath(key), partial = path + ".partial";
+        {
+            std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+            out.write((const char*) &header, sizeof(header));
+            out.write((const char*) errors.data(), errors.size() * sizeof(float));
+            for (const std::vector<unsigned int>& level : levels) {
+                std::uint32_t size = (std::uint32_t) level.size();
+                out.write((const char*) &size, sizeof(size));
+                out.write((const char*) level.data(), size * sizeof(unsigned int));
+            }
+        }
+        std::rename(partial.c_str(), path.c_str());
+    }
+
+    void PrintReport() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::cout << "[MeshCache] " << m_Hits << " models' levels from cache in " << m_LoadMs << " ms, "
+                  << m_Misses << " simplified in " << m_SimplifyMs << " ms, simplification time saved: "
+                  << m_SavedMs << " ms" << std::endl;
+    }
+
+private:
+    static const std::uint32_t MAGIC = 0x4c4d5753; // "SWML"
+
+    struct Header {
+        std::uint32_t magic = MAGIC;
+        std::uint32_t meshes = 0;
+        std::uint64_t key = 0;
+        std::uint32_t levels = 0;
+        double simplifyMs = 0.0;
+    };
+
+    std::mutex m_Mutex;
+    std::string m_Directory = "resources/mesh_cache";
+    int m_Hits = 0;
+    int m_Misses = 0;
+    double m_SavedMs = 0.0;
+    double m_LoadMs = 0.0;
+    double m_SimplifyMs = 0.0;
+
+    MeshCache() = default;
+
+    std::string entryPath(std::uint64_t key) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+        return m_Directory + "/" + name;
+    }
+
+    void count(int& counter) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        counter++;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_MESHCACHE_H
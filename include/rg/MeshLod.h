@@ -0,0 +1,568 @@
+//
+// Levels of detail of a mesh by quadric edge collapse, and picking one by its error on screen.
+//
+
+#ifndef PROJECT_BASE_MESHLOD_H
+#define PROJECT_BASE_MESHLOD_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+// the imported mesh and up to three simplified ones, each with about half the triangles of the one before
+const int MESH_LOD_COUNT = 4;
+const float MESH_LOD_REDUCTION = 0.5f;
+// a level that doesn't get below this share of the one before isn't worth its indices
+const float MESH_LOD_MIN_REDUCTION = 0.8f;
+// the level past the coarsest mesh: a quad showing the model's impostor (rg/Impostor.h)
+const int IMPOSTOR_LOD = MESH_LOD_COUNT;
+
+// where a level of detail lies in a model's element buffer
+struct IndexRange {
+    unsigned int offset = 0;
+    unsigned int count = 0;
+};
+
+// triangles submitted in a frame, and what the same draws would have cost at full detail
+struct TriangleCount {
+    long long submitted = 0;
+    long long full = 0;
+
+    TriangleCount& operator+=(const TriangleCount& other) {
+        submitted += other.submitted;
+        full += other.full;
+        return *this;
+    }
+};
+
+// Garland and Heckbert's quadric error metric, every collapse moves one corner onto a neighbouring one so the
+// levels only need new indices and share the vertices. Vertices at the same position are the wedges of one
+// corner: they differ in texture coordinates or normals, and the edges where they part are seams. A corner
+// is collapsed as a whole, all its wedges onto the matching wedges of the other corner, and
+// - an interior corner (one wedge, every edge shared by two triangles) may move along any edge
+// - a corner on the open border may only slide along the border, and one on a seam only along the seam,
+//   onto another corner of it; either way the seam or border keeps its course and the UVs on both sides of
+//   a seam stay attached to each other
+// - anything else (where seams or borders meet, more than two wedges) stays where it is
+// Borders and seams also weigh in their own planes, perpendicular to the surface along them, so that
+// sliding along one costs as much as it bends its course. A collapse that would turn a triangle over, or
+// nearly so, is skipped.
+// Collapses run in passes over the cheapest candidate of every corner, sorted by cost, each corner taking
+// part in at most one per pass; the simplifier keeps its state, so levels are made one after the other,
+// each from the one before.
+class MeshSimplifier {
+public:
+    // positions of the vertices indices refers to, three indices a triangle
+    MeshSimplifier(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+            : m_Positions(positions), m_Indices(indices) {
+        groupWedges();
+        m_Remap.resize(positions.size());
+        std::iota(m_Remap.begin(), m_Remap.end(), 0u);
+        initQuadrics();
+    }
+
+    // collapses until at most targetTriangles are left, or nothing can be collapsed for less than maxError
+    void Simplify(std::size_t targetTriangles, float maxError = std::numeric_limits<float>::max()) {
+        while (Triangles() > targetTriangles) {
+            if (!pass(targetTriangles, (double) maxError * maxError)) {
+                break;
+            }
+        }
+    }
+
+    const std::vector<unsigned int>& Indices() const {
+        return m_Indices;
+    }
+
+    std::size_t Triangles() const {
+        return m_Indices.size() / 3;
+    }
+
+    // how far the simplified surface strays from the original one: the root mean square distance to the
+    // planes merged into the costliest corner collapsed so far, in the units of the positions
+    float Error() const {
+        return (float) std::sqrt(m_Error);
+    }
+
+private:
+    enum Kind : unsigned char {
+        KIND_MANIFOLD,
+        KIND_BORDER,
+        KIND_SEAM,
+        KIND_LOCKED
+    };
+
+    // sum of squared distances to planes, each weighted by the area it came from
+    struct Quadric {
+        double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+        double weight = 0.0;
+
+        void AddPlane(glm::dvec3 n, double d, double w) {
+            a00 += w * n.x * n.x;
+            a11 += w * n.y * n.y;
+            a22 += w * n.z * n.z;
+            a01 += w * n.x * n.y;
+            a02 += w * n.x * n.z;
+            a12 += w * n.y * n.z;
+            b0 += w * n.x * d;
+            b1 += w * n.y * d;
+            b2 += w * n.z * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        Quadric& operator+=(const Quadric& q) {
+            a00 += q.a00;
+            a11 += q.a11;
+            a22 += q.a22;
+            a01 += q.a01;
+            a02 += q.a02;
+            a12 += q.a12;
+            b0 += q.b0;
+            b1 += q.b1;
+            b2 += q.b2;
+            c += q.c;
+            weight += q.weight;
+            return *this;
+        }
+
+        // mean squared distance of p to the planes
+        double Error(glm::dvec3 p) const {
+            double r = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                     + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                     + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return weight > 0.0 ? std::max(r, 0.0) / weight : 0.0;
+        }
+    };
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+
+    // how much more a border or seam plane counts than the surface next to it
+    static constexpr double EDGE_WEIGHT = 10.0;
+
+    const std::vector<glm::vec3>& m_Positions;
+    std::vector<unsigned int> m_Indices;
+    // corner of every vertex, and the vertices (wedges) of every corner
+    std::vector<unsigned int> m_Corner;
+    std::vector<unsigned int> m_WedgeStart;
+    std::vector<unsigned int> m_Wedges;
+    // what a vertex was collapsed onto, itself while it is still there
+    std::vector<unsigned int> m_Remap;
+    std::vector<Quadric> m_Quadrics;
+    double m_Error = 0.0;
+
+    // per pass
+    std::vector<Kind> m_Kinds;
+    std::unordered_map<std::uint64_t, int> m_VertexEdges;
+    std::unordered_map<std::uint64_t, int> m_CornerEdges;
+    std::vector<unsigned int> m_TriangleStart;
+    std::vector<unsigned int> m_CornerTriangles;
+
+    static std::uint64_t edgeKey(unsigned int a, unsigned int b) {
+        return a < b ? ((std::uint64_t) a << 32) | b : ((std::uint64_t) b << 32) | a;
+    }
+
+    glm::dvec3 position(unsigned int vertex) const {
+        return glm::dvec3(m_Positions[vertex]);
+    }
+
+    unsigned int resolve(unsigned int vertex) {
+        unsigned int root = vertex;
+        while (m_Remap[root] != root) {
+            root = m_Remap[root];
+        }
+        while (m_Remap[vertex] != root) {
+            unsigned int next = m_Remap[vertex];
+            m_Remap[vertex] = root;
+            vertex = next;
+        }
+        return root;
+    }
+
+    // vertices sorted by position, equal runs become corners
+    void groupWedges() {
+        std::vector<unsigned int> order(m_Positions.size());
+        std::iota(order.begin(), order.end(), 0u);
+        auto less = [this](unsigned int a, unsigned int b) {
+            const glm::vec3 &p = m_Positions[a], &q = m_Positions[b];
+            return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+        };
+        std::sort(order.begin(), order.end(), less);
+        m_Corner.resize(m_Positions.size());
+        m_Wedges = order;
+        for (std::size_t i = 0; i < order.size(); i++) {
+            if (i == 0 || less(order[i - 1], order[i])) {
+                m_WedgeStart.push_back((unsigned int) i);
+            }
+            m_Corner[order[i]] = (unsigned int) m_WedgeStart.size() - 1;
+        }
+        m_WedgeStart.push_back((unsigned int) order.size());
+    }
+
+    void initQuadrics() {
+        m_Quadrics.assign(m_WedgeStart.size() - 1, Quadric());
+        countEdges();
+        for (std::size_t t = 0; t + 2 < m_Indices.size(); t += 3) {
+            glm::dvec3 p[3] = {position(m_Indices[t]), position(m_Indices[t + 1]), position(m_Indices[t + 2])};
+            glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+            double length = glm::length(normal);
+            if (length <= 0.0) {
+                continue;
+            }
+            normal /= length;
+            Quadric face;
+            face.AddPlane(normal, -glm::dot(normal, p[0]), 0.5 * length);
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = m_Indices[t + k], b = m_Indices[t + (k + 1) % 3];
+                m_Quadrics[m_Corner[a]] += face;
+                // borders and seams hold on to the plane standing on them
+                if (m_VertexEdges[edgeKey(a, b)] != 1) {
+                    continue;
+                }
+                glm::dvec3 edge = p[(k + 1) % 3] - p[k];
+                glm::dvec3 side = glm::cross(edge, normal);
+                double sideLength = glm::length(side);
+                if (sideLength <= 0.0) {
+                    continue;
+                }
+                side /= sideLength;
+                Quadric wall;
+                wall.AddPlane(side, -glm::dot(side, p[k]), EDGE_WEIGHT * glm::dot(edge, edge));
+                m_Quadrics[m_Corner[a]] += wall;
+                m_Quadrics[m_Corner[b]] += wall;
+            }
+        }
+    }
+
+    // triangles sharing each edge, of vertices and of corners
+    void countEdges() {
+        m_VertexEdges.clear();
+        m_CornerEdges.clear();
+        for (std::size_t t = 0; t + 2 < m_Indices.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = m_Indices[t + k], b = m_Indices[t + (k + 1) % 3];
+                m_VertexEdges[edgeKey(a, b)]++;
+                m_CornerEdges[edgeKey(m_Corner[a], m_Corner[b])]++;
+            }
+        }
+    }
+
+    bool borderEdge(unsigned int cornerA, unsigned int cornerB) const {
+        auto found = m_CornerEdges.find(edgeKey(cornerA, cornerB));
+        return found != m_CornerEdges.end() && found->second == 1;
+    }
+
+    // shared by two triangles as corners but not as vertices
+    bool seamEdge(unsigned int a, unsigned int b) const {
+        auto corners = m_CornerEdges.find(edgeKey(m_Corner[a], m_Corner[b]));
+        auto vertices = m_VertexEdges.find(edgeKey(a, b));
+        return corners != m_CornerEdges.end() && corners->second == 2 && vertices->second == 1;
+    }
+
+    void classify() {
+        std::size_t corners = m_WedgeStart.size() - 1;
+        std::vector<int> wedges(corners, 0), borders(corners, 0), seams(corners, 0);
+        std::vector<unsigned char> used(m_Positions.size(), 0);
+        for (unsigned int index : m_Indices) {
+            if (!used[index]) {
+                used[index] = 1;
+                wedges[m_Corner[index]]++;
+            }
+        }
+        m_Kinds.assign(corners, KIND_MANIFOLD);
+        for (const auto& edge : m_CornerEdges) {
+            unsigned int a = (unsigned int) (edge.first >> 32), b = (unsigned int) edge.first;
+            if (edge.second == 1) {
+                borders[a]++;
+                borders[b]++;
+            } else if (edge.second > 2) {
+                m_Kinds[a] = m_Kinds[b] = KIND_LOCKED;
+            }
+        }
+        // every seam edge is open on both sides, as vertices; count it once per corner edge
+        for (const auto& edge : m_VertexEdges) {
+            unsigned int a = (unsigned int) (edge.first >> 32), b = (unsigned int) edge.first;
+            if (edge.second == 1 && m_CornerEdges[edgeKey(m_Corner[a], m_Corner[b])] == 2) {
+                seams[m_Corner[a]]++;
+                seams[m_Corner[b]]++;
+            }
+        }
+        for (std::size_t corner = 0; corner < corners; corner++) {
+            if (m_Kinds[corner] == KIND_LOCKED) {
+                continue;
+            }
+            // seam edges were counted from both sides
+            int seamEdges = seams[corner] / 2;
+            if (wedges[corner] == 1 && borders[corner] == 0 && seamEdges == 0) {
+                m_Kinds[corner] = KIND_MANIFOLD;
+            } else if (wedges[corner] == 1 && borders[corner] == 2 && seamEdges == 0) {
+                m_Kinds[corner] = KIND_BORDER;
+            } else if (wedges[corner] == 2 && borders[corner] == 0 && seamEdges == 2) {
+                m_Kinds[corner] = KIND_SEAM;
+            } else {
+                m_Kinds[corner] = KIND_LOCKED;
+            }
+        }
+    }
+
+    void buildAdjacency() {
+        std::size_t corners = m_WedgeStart.size() - 1;
+        m_TriangleStart.assign(corners + 1, 0);
+        for (unsigned int index : m_Indices) {
+            m_TriangleStart[m_Corner[index] + 1]++;
+        }
+        std::partial_sum(m_TriangleStart.begin(), m_TriangleStart.end(), m_TriangleStart.begin());
+        m_CornerTriangles.resize(m_Indices.size());
+        std::vector<unsigned int> fill(m_TriangleStart.begin(), m_TriangleStart.end() - 1);
+        for (std::size_t i = 0; i < m_Indices.size(); i++) {
+            m_CornerTriangles[fill[m_Corner[m_Indices[i]]]++] = (unsigned int) (i / 3);
+        }
+    }
+
+    bool allowed(unsigned int a, unsigned int b) const {
+        unsigned int from = m_Corner[a], to = m_Corner[b];
+        switch (m_Kinds[from]) {
+            case KIND_MANIFOLD: return true;
+            case KIND_BORDER: return borderEdge(from, to);
+            case KIND_SEAM: return seamEdge(a, b);
+            default: return false;
+        }
+    }
+
+    double cost(unsigned int from, unsigned int to) const {
+        Quadric merged = m_Quadrics[from];
+        merged += m_Quadrics[to];
+        return merged.Error(glm::dvec3(m_Positions[m_Wedges[m_WedgeStart[to]]]));
+    }
+
+    // the cheapest allowed collapse out of every corner
+    std::vector<Collapse> candidates() {
+        std::size_t corners = m_WedgeStart.size() - 1;
+        std::vector<Collapse> best(corners, Collapse{0, 0, std::numeric_limits<double>::max()});
+        for (std::size_t t = 0; t + 2 < m_Indices.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = m_Indices[t + k], b = m_Indices[t + (k + 1) % 3];
+                for (int direction = 0; direction < 2; direction++) {
+                    unsigned int from = direction == 0 ? a : b, to = direction == 0 ? b : a;
+                    unsigned int fromCorner = m_Corner[from], toCorner = m_Corner[to];
+                    if (fromCorner == toCorner || !allowed(from, to)) {
+                        continue;
+                    }
+                    double c = cost(fromCorner, toCorner);
+                    if (c < best[fromCorner].cost) {
+                        best[fromCorner] = Collapse{fromCorner, toCorner, c};
+                    }
+                }
+            }
+        }
+        best.erase(std::remove_if(best.begin(), best.end(), [](const Collapse& collapse) {
+            return collapse.cost == std::numeric_limits<double>::max();
+        }), best.end());
+        std::sort(best.begin(), best.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+        return best;
+    }
+
+    // the wedge of to that each wedge of from shares an edge with; false if one has none
+    bool matchWedges(unsigned int from, unsigned int to, std::vector<std::pair<unsigned int, unsigned int>>& moves) {
+        moves.clear();
+        for (unsigned int w = m_WedgeStart[from]; w < m_WedgeStart[from + 1]; w++) {
+            unsigned int wedge = m_Wedges[w];
+            if (resolve(wedge) != wedge) {
+                continue;
+            }
+            unsigned int target = wedge;
+            for (unsigned int i = m_TriangleStart[from]; i < m_TriangleStart[from + 1] && target == wedge; i++) {
+                unsigned int t = m_CornerTriangles[i] * 3;
+                unsigned int v[3] = {resolve(m_Indices[t]), resolve(m_Indices[t + 1]), resolve(m_Indices[t + 2])};
+                for (int k = 0; k < 3; k++) {
+                    if (v[k] == wedge) {
+                        for (int j = 1; j < 3; j++) {
+                            if (m_Corner[v[(k + j) % 3]] == to) {
+                                target = v[(k + j) % 3];
+                            }
+                        }
+                    }
+                }
+            }
+            if (target == wedge) {
+                // a wedge without triangles any more doesn't need to go anywhere
+                bool used = false;
+                for (unsigned int i = m_TriangleStart[from]; i < m_TriangleStart[from + 1] && !used; i++) {
+                    unsigned int t = m_CornerTriangles[i] * 3;
+                    used = resolve(m_Indices[t]) == wedge || resolve(m_Indices[t + 1]) == wedge
+                           || resolve(m_Indices[t + 2]) == wedge;
+                }
+                if (used) {
+                    return false;
+                }
+                continue;
+            }
+            moves.push_back({wedge, target});
+        }
+        return !moves.empty();
+    }
+
+    // false if moving the corner turns one of its remaining triangles over, or nearly so; removed is set to
+    // the triangles that collapse with the edge
+    bool keepsOrientation(unsigned int from, unsigned int to, std::size_t& removed) {
+        glm::dvec3 target = position(m_Wedges[m_WedgeStart[to]]);
+        removed = 0;
+        for (unsigned int i = m_TriangleStart[from]; i < m_TriangleStart[from + 1]; i++) {
+            unsigned int t = m_CornerTriangles[i] * 3;
+            unsigned int v[3] = {resolve(m_Indices[t]), resolve(m_Indices[t + 1]), resolve(m_Indices[t + 2])};
+            unsigned int c[3] = {m_Corner[v[0]], m_Corner[v[1]], m_Corner[v[2]]};
+            if (c[0] == c[1] || c[1] == c[2] || c[0] == c[2]) {
+                continue;
+            }
+            if (c[0] == to || c[1] == to || c[2] == to) {
+                removed++;
+                continue;
+            }
+            glm::dvec3 p[3] = {position(v[0]), position(v[1]), position(v[2])};
+            glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            for (int k = 0; k < 3; k++) {
+                if (c[k] == from) {
+                    p[k] = target;
+                }
+            }
+            glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+            if (glm::dot(before, after) <= 0.25 * glm::length(before) * glm::length(after)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // one round of collapses; false when none was possible
+    bool pass(std::size_t targetTriangles, double maxError) {
+        countEdges();
+        classify();
+        buildAdjacency();
+        std::vector<Collapse> collapses = candidates();
+        std::vector<unsigned char> touched(m_WedgeStart.size() - 1, 0);
+        std::vector<std::pair<unsigned int, unsigned int>> moves;
+        std::size_t triangles = Triangles();
+        int collapsed = 0;
+        for (const Collapse& collapse : collapses) {
+            if (triangles <= targetTriangles || collapse.cost > maxError) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+            std::size_t removed = 0;
+            if (!keepsOrientation(collapse.from, collapse.to, removed)
+                || !matchWedges(collapse.from, collapse.to, moves)) {
+                continue;
+            }
+            for (const auto& move : moves) {
+                m_Remap[move.first] = move.second;
+            }
+            m_Quadrics[collapse.to] += m_Quadrics[collapse.from];
+            m_Error = std::max(m_Error, collapse.cost);
+            touched[collapse.from] = touched[collapse.to] = 1;
+            triangles -= std::min(removed, triangles);
+            collapsed++;
+        }
+        if (collapsed == 0) {
+            return false;
+        }
+        // triangles that lost a corner are gone
+        std::size_t kept = 0;
+        for (std::size_t t = 0; t + 2 < m_Indices.size(); t += 3) {
+            unsigned int v[3] = {resolve(m_Indices[t]), resolve(m_Indices[t + 1]), resolve(m_Indices[t + 2])};
+            if (m_Corner[v[0]] == m_Corner[v[1]] || m_Corner[v[1]] == m_Corner[v[2]]
+                || m_Corner[v[0]] == m_Corner[v[2]]) {
+                continue;
+            }
+            m_Indices[kept++] = v[0];
+            m_Indices[kept++] = v[1];
+            m_Indices[kept++] = v[2];
+        }
+        m_Indices.resize(kept);
+        return true;
+    }
+};
+
+// Picks the coarsest level whose error stays under Threshold pixels on screen. A coarser level is only
+// taken once its error is below Threshold * (1 - Hysteresis), and the current one only given up for a
+// finer one once it is above Threshold * (1 + Hysteresis), so an object at a boundary doesn't flicker
+// between two. The level itself is kept by the caller, one per object or instance.
+// Objects with an impostor become one once their bounding sphere is less than ImpostorPixels across, with
+// the same hysteresis, whether levels of detail are enabled or not.
+class MeshLodSelector {
+public:
+    bool Enabled = true;
+    float Threshold = 1.0f;
+    float Hysteresis = 0.25f;
+    bool Impostors = true;
+    float ImpostorPixels = 48.0f;
+
+    // the camera of the frame; fovy in radians, viewport height in pixels
+    void SetView(glm::vec3 cameraPosition, float fovyRadians, int viewportHeight) {
+        m_CameraPosition = cameraPosition;
+        m_PixelsPerUnit = 0.5f * (float) viewportHeight / std::tan(0.5f * fovyRadians);
+    }
+
+    // errors per level in model space, errors[0] = 0; model places the model's bounding sphere in the
+    // world; IMPOSTOR_LOD only comes back when the object has an impostor to draw
+    int Select(int current, const glm::mat4& model, glm::vec3 center, float radius, const std::vector<float>& errors,
+               bool impostor = false) const {
+        int levels = (int) errors.size();
+        glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(model[0])),
+                               std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float distance = std::max(glm::length(worldCenter - m_CameraPosition), 1e-3f);
+        // pixels per model space unit at the object
+        float pixels = scale * m_PixelsPerUnit / distance;
+        if (impostor && Impostors) {
+            float diameter = 2.0f * radius * pixels;
+            float limit = ImpostorPixels * (current == IMPOSTOR_LOD ? 1.0f + Hysteresis : 1.0f - Hysteresis);
+            if (diameter < limit) {
+                return IMPOSTOR_LOD;
+            }
+        }
+        if (!Enabled || levels <= 1) {
+            return 0;
+        }
+        // back from an impostor through the coarsest mesh, finer ones follow if its error is too large
+        current = std::min(current, levels - 1);
+        int coarser = 0, fits = 0;
+        for (int level = 1; level < levels; level++) {
+            if (errors[level] * pixels <= Threshold * (1.0f - Hysteresis)) {
+                coarser = level;
+            }
+            if (errors[level] * pixels <= Threshold) {
+                fits = level;
+            }
+        }
+        if (coarser > current) {
+            return coarser;
+        }
+        if (errors[current] * pixels > Threshold * (1.0f + Hysteresis)) {
+            return fits;
+        }
+        return current;
+    }
+
+private:
+    glm::vec3 m_CameraPosition = glm::vec3(0.0f);
+    float m_PixelsPerUnit = 1.0f;
+};
+
+};
+
+#endif //PROJECT_BASE_MESHLOD_H
@@ -0,0 +1,141 @@
+//
+// CPU built mip chains for texture arrays, uploaded a range of levels at a time.
+//
+
+#ifndef PROJECT_BASE_MIPCHAIN_H
+#define PROJECT_BASE_MIPCHAIN_H
+
+#include <glad/glad.h>
+#include <rg/StartupProfiler.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// mips no larger than this are uploaded with the model and never evicted
+const int MIP_TAIL_SIZE = 64;
+
+inline int mipLevelCount(int width, int height) {
+    int levels = 1;
+    while (std::max(width, height) >> levels) {
+        levels++;
+    }
+    return levels;
+}
+
+inline int mipSize(int size, int level) {
+    return std::max(1, size >> level);
+}
+
+// first level whose larger side fits into MIP_TAIL_SIZE
+inline int mipTailLevel(int width, int height) {
+    int level = 0;
+    while (std::max(mipSize(width, level), mipSize(height, level)) > MIP_TAIL_SIZE) {
+        level++;
+    }
+    return level;
+}
+
+// bytes one level takes on the GPU, three channel formats are assumed to be padded to four
+inline std::size_t mipLevelBytes(int width, int height, int layers, int channels, int level) {
+    int texelBytes = channels == 3 ? 4 : channels;
+    return (std::size_t) mipSize(width, level) * mipSize(height, level) * layers * texelBytes;
+}
+
+// 2x2 box filter, odd edges reuse the last row/column
+inline void downsampleImage(const std::vector<unsigned char>& source, int width, int height, int channels,
+                            std::vector<unsigned char>& destination) {
+    int halfWidth = std::max(1, width / 2);
+    int halfHeight = std::max(1, height / 2);
+    destination.resize((std::size_t) halfWidth * halfHeight * channels);
+    for (int y = 0; y < halfHeight; ++y) {
+        int y0 = std::min(2 * y, height - 1);
+        int y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < halfWidth; ++x) {
+            int x0 = std::min(2 * x, width - 1);
+            int x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < channels; ++c) {
+                int sum = source[((std::size_t) y0 * width + x0) * channels + c] +
+                          source[((std::size_t) y0 * width + x1) * channels + c] +
+                          source[((std::size_t) y1 * width + x0) * channels + c] +
+                          source[((std::size_t) y1 * width + x1) * channels + c];
+                destination[((std::size_t) y * halfWidth + x) * channels + c] = (unsigned char) ((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+inline void textureFormat(int channels, GLenum& format, GLenum& internalFormat) {
+    format = GL_RGBA;
+    internalFormat = GL_RGBA8;
+    if (channels == 1) {
+        format = GL_RED;
+        internalFormat = GL_R8;
+    } else if (channels == 2) {
+        format = GL_RG;
+        internalFormat = GL_RG8;
+    } else if (channels == 3) {
+        format = GL_RGB;
+        internalFormat = GL_RGB8;
+    }
+}
+
+// decodes every layer of a GL_TEXTURE_2D_ARRAY and (re)specifies levels firstLevel..lastLevel from it.
+// Levels outside that range are left alone, so the texture stays usable while finer levels are added.
+inline void uploadMipLevels(unsigned int texture, const std::vector<std::string>& files, int width, int height,
+                            int channels, int firstLevel, int lastLevel) {
+    GLenum format, internalFormat;
+    textureFormat(channels, format, internalFormat);
+    int layers = (int) files.size();
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = firstLevel; level <= lastLevel; ++level) {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, mipSize(width, level), mipSize(height, level), layers,
+                     0, format, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    std::vector<unsigned char> image, half;
+    for (int layer = 0; layer < layers; ++layer) {
+        int fileWidth = 0, fileHeight = 0, fileChannels = 0;
+        unsigned char* data;
+        {
+            StartupZone zone("stbi_load", "texture");
+            data = stbi_load(files[layer].c_str(), &fileWidth, &fileHeight, &fileChannels, channels);
+            zone.Arg("path", files[layer]).Arg("width", fileWidth).Arg("height", fileHeight).Arg("channels", channels);
+        }
+        if (!data) {
+            std::cout << "Texture failed to load at path: " << files[layer] << std::endl;
+            continue;
+        }
+        image.assign(data, data + (std::size_t) width * height * channels);
+        stbi_image_free(data);
+
+        StartupZone zone("upload mip levels", "texture");
+        zone.Arg("path", files[layer]).Arg("width", mipSize(width, firstLevel))
+            .Arg("height", mipSize(height, firstLevel)).Arg("firstLevel", firstLevel).Arg("lastLevel", lastLevel);
+        std::size_t bytes = 0;
+        for (int level = 0; level <= lastLevel; ++level) {
+            if (level > 0) {
+                downsampleImage(image, mipSize(width, level - 1), mipSize(height, level - 1), channels, half);
+                image.swap(half);
+            }
+            if (level >= firstLevel) {
+                bytes += (std::size_t) mipSize(width, level) * mipSize(height, level) * channels;
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, mipSize(width, level),
+                                mipSize(height, level), 1, format, GL_UNSIGNED_BYTE, image.data());
+            }
+        }
+        zone.Arg("bytes", bytes);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+};
+
+#endif //PROJECT_BASE_MIPCHAIN_H
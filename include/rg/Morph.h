@@ -0,0 +1,121 @@
+//
+// Morph targets stored sparse for the vertex shader, and the weight cycles that play them.
+//
+
+#ifndef PROJECT_BASE_MORPH_H
+#define PROJECT_BASE_MORPH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// a draw's or an instance's weights are one vec4
+const int MAX_MORPH_TARGETS = 4;
+// location of the aMorphWeights attribute in model.vs
+const unsigned int MORPH_WEIGHTS_ATTRIBUTE = 14;
+// texture units of the buffer textures, below the ones of a baked vertex animation
+const int MORPH_RANGE_UNIT = 12;
+const int MORPH_DELTA_UNIT = 13;
+// keys of a MorphCycle the crowd variant of model.vs takes, its MAX_MORPH_CYCLE_KEYS
+const int MAX_MORPH_CYCLE_KEYS = 16;
+
+// position and normal offsets of every vertex of a model when the target is fully on
+struct MorphTarget {
+    std::string name;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+};
+
+// Only the vertices a target moves keep an entry for it. Vertex v's entries are ranges[v].y entries
+// starting at ranges[v].x, each two texels of deltas: the position offset with the target's index in w,
+// then the normal offset. A vertex no target moves costs the vertex shader one texel fetch.
+struct SparseMorphTargets {
+    std::vector<std::string> names;
+    std::vector<glm::ivec2> ranges;
+    std::vector<glm::vec4> deltas;
+
+    int Entries() const {
+        return (int) deltas.size() / 2;
+    }
+};
+
+// offsets below the tolerances are dropped, targets past MAX_MORPH_TARGETS are ignored
+inline SparseMorphTargets packMorphTargets(const std::vector<MorphTarget>& targets, size_t vertexCount,
+                                           float positionTolerance, float normalTolerance) {
+    SparseMorphTargets sparse;
+    size_t count = std::min(targets.size(), (size_t) MAX_MORPH_TARGETS);
+    for (size_t target = 0; target < count; target++) {
+        sparse.names.push_back(targets[target].name);
+    }
+    sparse.ranges.resize(vertexCount);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+        glm::ivec2& range = sparse.ranges[vertex];
+        range = glm::ivec2(sparse.Entries(), 0);
+        for (size_t target = 0; target < count; target++) {
+            glm::vec3 position = targets[target].positions[vertex];
+            glm::vec3 normal = targets[target].normals[vertex];
+            if (glm::length(position) <= positionTolerance && glm::length(normal) <= normalTolerance) {
+                continue;
+            }
+            sparse.deltas.push_back(glm::vec4(position, (float) target));
+            sparse.deltas.push_back(glm::vec4(normal, 0.0f));
+            range.y++;
+        }
+    }
+    return sparse;
+}
+
+// Weights of the targets over one loop, keys evenly spaced over duration seconds and blended linearly,
+// the last one into the first. morphCycleWeights in model.vs samples it the same way.
+struct MorphCycle {
+    float duration = 1.0f;
+    std::vector<glm::vec4> keys;
+
+    glm::vec4 Sample(float time) const {
+        if (keys.empty()) {
+            return glm::vec4(0.0f);
+        }
+        float position = time / duration;
+        position = (position - std::floor(position)) * keys.size();
+        size_t first = std::min((size_t) position, keys.size() - 1);
+        size_t second = (first + 1) % keys.size();
+        return glm::mix(keys[first], keys[second], position - (float) first);
+    }
+};
+
+// for single draws: the vertex arrays of models leave the attribute disabled, so every vertex reads the
+// current value set here. Crowds sample a cycle in the shader instead (setMorphCycle).
+inline void setMorphWeights(glm::vec4 weights) {
+    glVertexAttrib4f(MORPH_WEIGHTS_ATTRIBUTE, weights.x, weights.y, weights.z, weights.w);
+}
+
+// for crowds, with the VERTEX_ANIMATION variant in use: every instance plays cycle from its own phase
+// and at its own rate, keys past MAX_MORPH_CYCLE_KEYS are dropped; without a cycle they keep the rest shape
+inline void setMorphCycle(Shader& shader, const MorphCycle* cycle) {
+    int keys = cycle ? std::min((int) cycle->keys.size(), MAX_MORPH_CYCLE_KEYS) : 0;
+    shader.setInt("morphCycleKeys", keys);
+    shader.setFloat("morphCycleDuration", cycle ? cycle->duration : 1.0f);
+    if (keys > 0) {
+        glUniform4fv(glGetUniformLocation(shader.ID, "morphCycle"), keys, &cycle->keys[0][0]);
+    }
+}
+
+// once per program built from model.vs; left at unit 0 the buffer samplers would clash with the
+// material's texture arrays even in draws without targets
+inline void setMorphSamplers(Shader& shader) {
+    shader.use();
+    shader.setInt("morphRanges", MORPH_RANGE_UNIT);
+    shader.setInt("morphDeltas", MORPH_DELTA_UNIT);
+}
+
+};
+
+#endif //PROJECT_BASE_MORPH_H
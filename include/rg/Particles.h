@@ -0,0 +1,234 @@
+//
+// Particles simulated and drawn on the GPU alone: marine snow, bubbles and sediment.
+//
+
+#ifndef PROJECT_BASE_PARTICLES_H
+#define PROJECT_BASE_PARTICLES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// texture unit the scene depth is read from, below the morph targets' and the baked animation's units
+// and above the ones a model's texture arrays take
+const int PARTICLE_DEPTH_UNIT = 11;
+
+enum ParticleKind {
+    PARTICLE_SNOW,
+    PARTICLE_BUBBLES,
+    PARTICLE_SEDIMENT,
+    PARTICLE_KINDS
+};
+
+// Everything the update pass needs from the CPU for a frame, none of it per particle.
+struct ParticleEmitters {
+    // marine snow fills a box of snowBox around the camera and wraps around in it
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    glm::vec3 snowBox = glm::vec3(40.0f);
+    // bubbles stream from these
+    glm::vec3 bubbleSources[2] = {glm::vec3(0.0f), glm::vec3(0.0f)};
+    // sediment is kicked up where something hit the seabed: xyz, and w how fast it hit; it settles on
+    // the seabed again, the one the debris rests on
+    std::vector<glm::vec4> impacts;
+    float seabedHeight = -20.0f;
+    // the water's drift, everything floating is carried along
+    glm::vec3 current = glm::vec3(0.15f, 0.0f, 0.05f);
+};
+
+// Two buffers of particles, 32 bytes each (position and age, velocity and lifetime). The update pass
+// draws one as points into the other through transform feedback with the rasterizer off, and the two
+// swap; dead particles respawn in the shader from a hash of their index and the frame, so the CPU never
+// touches a particle after the buffers are cleared. The draw is one instanced triangle strip, a quad
+// facing the camera per particle, read straight from the buffer just written. The kind of a particle
+// follows from its index: snow first, then bubbles, then sediment.
+class ParticleSystem {
+public:
+    static const int MAX_IMPACTS = 8;
+    // sediment kicked up per unit of impact speed
+    float SedimentPerImpact = 600.0f;
+    // how far in front of the scene's surfaces particles fade out, instead of being cut by them
+    float FadeDistance = 0.6f;
+
+    explicit ParticleSystem(const std::string& name) : m_Name(name) {
+    }
+
+    ParticleSystem(const ParticleSystem&) = delete;
+    ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+    ~ParticleSystem() {
+        Release();
+    }
+
+    // needs the context current, call before it goes away
+    void Release() {
+        glDeleteVertexArrays(2, m_UpdateVAOs);
+        glDeleteVertexArrays(2, m_DrawVAOs);
+        glDeleteBuffers(2, m_Buffers);
+        for (int i = 0; i < 2; i++) {
+            m_UpdateVAOs[i] = m_DrawVAOs[i] = m_Buffers[i] = 0;
+        }
+        m_Allocated = 0;
+    }
+
+    // particles of each kind; a change starts all of them over, allocated at the next Update
+    void SetCounts(int snow, int bubbles, int sediment) {
+        int counts[PARTICLE_KINDS] = {std::max(snow, 0), std::max(bubbles, 0), std::max(sediment, 0)};
+        if (std::equal(counts, counts + PARTICLE_KINDS, m_Counts)) {
+            return;
+        }
+        std::copy(counts, counts + PARTICLE_KINDS, m_Counts);
+        m_Allocated = -1;
+    }
+
+    int Count(ParticleKind kind) const {
+        return m_Counts[kind];
+    }
+
+    int Total() const {
+        return m_Counts[PARTICLE_SNOW] + m_Counts[PARTICLE_BUBBLES] + m_Counts[PARTICLE_SEDIMENT];
+    }
+
+    // advances every particle by deltaTime with the update program (particle_update.vs)
+    void Update(Shader& shader, const ParticleEmitters& emitters, float deltaTime, float time) {
+        if (m_Allocated != Total()) {
+            allocate();
+        }
+        if (m_Allocated == 0) {
+            return;
+        }
+        shader.use();
+        setRanges(shader);
+        shader.setFloat("deltaTime", deltaTime);
+        shader.setFloat("time", time);
+        shader.setInt("frame", m_Frame++);
+        shader.setVec3("cameraPosition", emitters.cameraPosition);
+        shader.setVec3("snowBox", emitters.snowBox);
+        shader.setVec3("bubbleSources[0]", emitters.bubbleSources[0]);
+        shader.setVec3("bubbleSources[1]", emitters.bubbleSources[1]);
+        shader.setFloat("seabedHeight", emitters.seabedHeight);
+        shader.setVec3("current", emitters.current);
+        // w becomes the share of the sediment particles that respawn there
+        int impacts = std::min((int) emitters.impacts.size(), MAX_IMPACTS);
+        float sediment = (float) std::max(m_Counts[PARTICLE_SEDIMENT], 1);
+        for (int i = 0; i < impacts; i++) {
+            glm::vec4 impact = emitters.impacts[i];
+            impact.w = std::min(impact.w * SedimentPerImpact / sediment, 1.0f);
+            shader.setVec4("impacts[" + std::to_string(i) + "]", impact);
+        }
+        shader.setInt("impactCount", impacts);
+
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(m_UpdateVAOs[m_Current]);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_Buffers[1 - m_Current]);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, m_Allocated);
+        glEndTransformFeedback();
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glBindVertexArray(0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        m_Current = 1 - m_Current;
+    }
+
+    // with the draw program (particle.vs/.fs) in use and its lights and camera set; depth is the
+    // scene's depth copy, sized to the target. Leaves blending on, as the render loop keeps it.
+    void Draw(Shader& shader, unsigned int sceneDepth, glm::vec2 depthTexelSize, float nearPlane, float farPlane) {
+        if (m_Allocated <= 0) {
+            return;
+        }
+        setRanges(shader);
+        shader.setVec2("depthTexelSize", depthTexelSize);
+        shader.setFloat("nearPlane", nearPlane);
+        shader.setFloat("farPlane", farPlane);
+        shader.setFloat("fadeDistance", FadeDistance);
+        glActiveTexture(GL_TEXTURE0 + PARTICLE_DEPTH_UNIT);
+        glBindTexture(GL_TEXTURE_2D, sceneDepth);
+        glActiveTexture(GL_TEXTURE0);
+
+        // premultiplied, so the same blend adds the glints of snow and bubbles and covers with sediment
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        glDisable(GL_CULL_FACE);
+        glBindVertexArray(m_DrawVAOs[m_Current]);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_Allocated);
+        glBindVertexArray(0);
+        glEnable(GL_CULL_FACE);
+        glDepthMask(GL_TRUE);
+        // back to the blending every other pass expects
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    // the sampler of the scene depth, once per draw program
+    static void SetSamplers(Shader& shader) {
+        shader.use();
+        shader.setInt("sceneDepth", PARTICLE_DEPTH_UNIT);
+    }
+
+private:
+    struct Particle {
+        glm::vec4 position; // w: age in seconds
+        glm::vec4 velocity; // w: lifetime in seconds
+    };
+
+    std::string m_Name;
+    int m_Counts[PARTICLE_KINDS] = {0, 0, 0};
+    // particles in the buffers, -1 until they are reallocated for new counts
+    int m_Allocated = 0;
+    unsigned int m_Buffers[2] = {0, 0};
+    // reading either buffer, for the update as vertices and for the draw as instances
+    unsigned int m_UpdateVAOs[2] = {0, 0};
+    unsigned int m_DrawVAOs[2] = {0, 0};
+    // the buffer holding the latest state
+    int m_Current = 0;
+    int m_Frame = 0;
+
+    void setRanges(Shader& shader) const {
+        int bubbles = m_Counts[PARTICLE_SNOW];
+        int sediment = bubbles + m_Counts[PARTICLE_BUBBLES];
+        glUniform3i(glGetUniformLocation(shader.ID, "ranges"), bubbles, sediment, sediment + m_Counts[PARTICLE_SEDIMENT]);
+    }
+
+    // zeroed particles are unborn, the update pass spawns each kind its own way from there
+    void allocate() {
+        Release();
+        m_Allocated = Total();
+        if (m_Allocated == 0) {
+            return;
+        }
+        std::vector<Particle> zeroes(m_Allocated, Particle{glm::vec4(0.0f), glm::vec4(0.0f)});
+        glGenBuffers(2, m_Buffers);
+        glGenVertexArrays(2, m_UpdateVAOs);
+        glGenVertexArrays(2, m_DrawVAOs);
+        for (int i = 0; i < 2; i++) {
+            glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[i]);
+            glBufferData(GL_ARRAY_BUFFER, m_Allocated * sizeof(Particle), zeroes.data(), GL_DYNAMIC_COPY);
+            labelObject(GL_BUFFER, m_Buffers[i], m_Name + (i == 0 ? " A" : " B"));
+            for (int divisor = 0; divisor < 2; divisor++) {
+                unsigned int vao = divisor == 0 ? m_UpdateVAOs[i] : m_DrawVAOs[i];
+                glBindVertexArray(vao);
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*) 0);
+                glVertexAttribDivisor(0, divisor);
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*) sizeof(glm::vec4));
+                glVertexAttribDivisor(1, divisor);
+                glBindVertexArray(0);
+                labelObject(GL_VERTEX_ARRAY, vao, m_Name + (divisor == 0 ? " update" : " draw"));
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        m_Current = 0;
+        m_Frame = 0;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_PARTICLES_H
@@ -0,0 +1,109 @@
+//
+// Draws every program/state combination once before the first frame.
+//
+
+#ifndef PROJECT_BASE_PIPELINEWARMUP_H
+#define PROJECT_BASE_PIPELINEWARMUP_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace rg {
+
+// One draw of the render loop, reduced to what the driver keys its compiled pipelines on:
+// program, vertex layout and fixed function state.
+struct WarmupDraw {
+    Shader* shader;
+    unsigned int vao;
+    bool indexed;
+    bool cullFace;
+    GLenum depthFunc;
+    // one-time program setup (sampler units and such), runs right after the program is finished
+    std::function<void()> setup;
+};
+
+// Drivers often finish compiling (or recompile) a program at its first draw with a given state.
+// Doing those draws here into a tiny offscreen target keeps the hitch out of the first frames.
+// State the render loop relies on (framebuffer, viewport, culling, depth function) is restored.
+inline void warmUpPipelines(const std::vector<WarmupDraw>& draws, bool finish = true) {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    unsigned int framebuffer, colorBuffer, depthBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 4, 4);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, 4, 4);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glViewport(0, 0, 4, 4);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    for (const WarmupDraw& draw : draws) {
+        if (draw.cullFace) {
+            glEnable(GL_CULL_FACE);
+        } else {
+            glDisable(GL_CULL_FACE);
+        }
+        glDepthFunc(draw.depthFunc);
+        draw.shader->use();
+        if (draw.setup) {
+            draw.setup();
+        }
+        glBindVertexArray(draw.vao);
+        // a single triangle is enough for the driver to build the pipeline
+        if (draw.indexed) {
+            glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+        } else {
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    }
+    // make sure the driver actually processed the draws before we time the first frame
+    if (finish) {
+        glFinish();
+    }
+
+    glBindVertexArray(0);
+    glEnable(GL_CULL_FACE);
+    glDepthFunc(GL_LESS);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+// Warms up, and removes from draws, only those whose program has finished compiling, so it can be
+// called every frame while the rest keep compiling. Returns true once draws is empty.
+inline bool warmUpReadyPipelines(std::vector<WarmupDraw>& draws) {
+    std::vector<WarmupDraw> ready;
+    for (unsigned int i = 0; i < draws.size();) {
+        if (draws[i].shader->isReady()) {
+            ready.push_back(draws[i]);
+            draws.erase(draws.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+    if (!ready.empty()) {
+        // mid-frame, the GPU can process them along with the frame
+        warmUpPipelines(ready, false);
+    }
+    return draws.empty();
+}
+
+// true while a draw of shader is still waiting in draws, the program must not be used yet
+inline bool pipelinePending(const std::vector<WarmupDraw>& draws, const Shader* shader) {
+    return std::any_of(draws.begin(), draws.end(), [shader](const WarmupDraw& draw) { return draw.shader == shader; });
+}
+
+};
+
+#endif //PROJECT_BASE_PIPELINEWARMUP_H
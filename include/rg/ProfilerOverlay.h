@@ -0,0 +1,142 @@
+//
+// ImGui window showing the frame time history, a flame view of the frame profiler zones and GPU pass times.
+//
+
+#ifndef PROJECT_BASE_PROFILEROVERLAY_H
+#define PROJECT_BASE_PROFILEROVERLAY_H
+
+#include <imgui.h>
+#include <rg/FrameProfiler.h>
+#include <rg/GpuTimers.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// The graph shows the last FrameHistory frames. The flame view shows the last completed frame of
+// the render thread, with the zones other threads ran during it below; pausing keeps that frame so
+// it can be inspected while the scene goes on. Export writes the last ExportSeconds of every thread.
+// GPU times are smoothed, per pass with the timers of each pass below it.
+class ProfilerOverlay {
+public:
+    GpuTimers* Gpu = nullptr;
+    int FrameHistory = 300;
+    int ExportSeconds = 10;
+    std::string ExportPath = "frame_profile.json";
+
+    // render thread, between ImGui::NewFrame and ImGui::Render
+    void Draw() {
+        FrameProfiler& profiler = FrameProfiler::Instance();
+        ImGui::SetNextWindowSize(ImVec2(520.0f, 420.0f), ImGuiCond_FirstUseEver);
+        if (!ImGui::Begin("Profiler")) {
+            ImGui::End();
+            return;
+        }
+
+        std::vector<float> times = profiler.FrameTimes(FrameHistory);
+        if (!times.empty()) {
+            float sum = 0.0f, worst = 0.0f;
+            for (float time : times) {
+                sum += time;
+                worst = std::max(worst, time);
+            }
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "avg %.2f ms, max %.2f ms", sum / times.size(), worst);
+            ImGui::PlotLines("##frame times", times.data(), (int) times.size(), 0, overlay, 0.0f, worst * 1.2f,
+                             ImVec2(ImGui::GetContentRegionAvail().x, 80.0f));
+        }
+
+        ImGui::Checkbox("Pause", &m_Paused);
+        if (!m_Paused || m_To == 0) {
+            m_From = profiler.FrameStart(1);
+            m_To = profiler.FrameStart(0);
+        }
+        if (m_From >= 0 && m_To > m_From) {
+            ImGui::SameLine();
+            ImGui::Text("frame %.3f ms", (m_To - m_From) / 1.0e6);
+            profiler.ForEachThread([&](const FrameProfiler::ThreadBuffer& buffer) {
+                std::vector<ProfileEvent> events = FrameProfiler::Events(buffer, m_From, m_To);
+                if (!events.empty()) {
+                    ImGui::TextUnformatted(profiler.ThreadName(buffer).c_str());
+                    drawFlame(&buffer, events);
+                }
+            });
+        }
+
+        if (Gpu && ImGui::CollapsingHeader("GPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+            for (const char* pass : Gpu->Passes()) {
+                if (Gpu->PassIdle(pass) || !ImGui::TreeNode(pass, "%s  %.3f ms", pass, Gpu->PassAverageMs(pass))) {
+                    continue;
+                }
+                for (const GpuTimers::Timer& timer : Gpu->Timers()) {
+                    if (!timer.Idle() && std::strcmp(timer.pass, pass) == 0) {
+                        ImGui::Text("%s  %.3f ms", timer.name, timer.averageMs);
+                    }
+                }
+                ImGui::TreePop();
+            }
+        }
+
+        ImGui::Separator();
+        ImGui::SliderInt("seconds", &ExportSeconds, 1, 60);
+        ImGui::SameLine();
+        if (ImGui::Button("Export trace")) {
+            profiler.ExportTrace(ExportPath, ExportSeconds);
+        }
+        ImGui::End();
+    }
+
+private:
+    bool m_Paused = false;
+    std::int64_t m_From = -1;
+    std::int64_t m_To = 0;
+
+    // one row per nesting depth, x spans the inspected frame
+    void drawFlame(const void* id, const std::vector<ProfileEvent>& events) {
+        const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+        int depths = 0;
+        for (const ProfileEvent& event : events) {
+            depths = std::max(depths, event.depth + 1);
+        }
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        float width = ImGui::GetContentRegionAvail().x;
+        ImGui::PushID(id);
+        ImGui::InvisibleButton("##flame", ImVec2(std::max(width, 1.0f), depths * rowHeight));
+
+        ImDrawList* drawList = ImGui::GetWindowDrawList();
+        double scale = width / (double) (m_To - m_From);
+        for (const ProfileEvent& event : events) {
+            float x0 = origin.x + (float) (std::max(event.start - m_From, (std::int64_t) 0) * scale);
+            float x1 = origin.x + (float) (std::min(event.end - m_From, m_To - m_From) * scale);
+            x1 = std::max(x1, x0 + 1.0f);
+            ImVec2 min(x0, origin.y + event.depth * rowHeight);
+            ImVec2 max(x1, min.y + rowHeight - 1.0f);
+            drawList->AddRectFilled(min, max, zoneColor(event.name));
+            drawList->PushClipRect(min, max, true);
+            drawList->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32(0, 0, 0, 255), event.name);
+            drawList->PopClipRect();
+            if (ImGui::IsMouseHoveringRect(min, max)) {
+                ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.end - event.start) / 1.0e6);
+            }
+        }
+        ImGui::PopID();
+    }
+
+    // stable per zone name, so a zone keeps its color from frame to frame
+    static ImU32 zoneColor(const char* name) {
+        unsigned int hash = 2166136261u;
+        for (const char* c = name; *c; ++c) {
+            hash = (hash ^ (unsigned char) *c) * 16777619u;
+        }
+        return ImColor::HSV((hash % 360) / 360.0f, 0.45f, 0.9f);
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_PROFILEROVERLAY_H
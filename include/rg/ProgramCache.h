@@ -0,0 +1,195 @@
+//
+// On-disk cache of linked program binaries.
+//
+
+#ifndef PROJECT_BASE_PROGRAMCACHE_H
+#define PROJECT_BASE_PROGRAMCACHE_H
+
+#include <glad/glad.h>
+#include <rg/GLExtensions.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+namespace rg {
+
+// FNV-1a, good enough to tell shader sources apart
+inline std::uint64_t hashBytes(const void* data, std::size_t size, std::uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline std::uint64_t hashString(const std::string& value, std::uint64_t hash = 14695981039346656037ull) {
+    // the length is mixed in so that ("ab", "c") and ("a", "bc") differ
+    std::uint64_t size = value.size();
+    hash = hashBytes(&size, sizeof(size), hash);
+    return hashBytes(value.data(), value.size(), hash);
+}
+
+inline double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Linked programs are stored as <directory>/<key>.bin, where the key hashes the sources, the
+// defines and the vendor/renderer/version strings, so a driver update or an edited shader simply
+// misses. Every entry remembers how long the driver took to compile and link it, which is what a
+// cache hit reports as saved. With KHR_parallel_shader_compile that is the time from submit until
+// the driver reported the link complete, not the little time the main thread spent on it.
+class ProgramCache {
+public:
+    static ProgramCache& Instance() {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    bool Enabled() const {
+        return glExtensions().programBinary;
+    }
+
+    void SetDirectory(const std::string& directory) {
+        m_Directory = directory;
+    }
+
+    std::uint64_t Key(const std::vector<std::string>& sources, const std::vector<std::string>& defines) const {
+        std::uint64_t hash = hashString(driverString());
+        for (const std::string& source : sources) {
+            hash = hashString(source, hash);
+        }
+        for (const std::string& define : defines) {
+            hash = hashString(define, hash);
+        }
+        return hash;
+    }
+
+    // tries to link program from a cached binary, on any mismatch the entry is dropped and false returned
+    bool Load(std::uint64_t key, GLuint program) {
+        if (!Enabled()) {
+            m_Misses++;
+            return false;
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::ifstream in(entryPath(key), std::ios::binary);
+        if (!in) {
+            m_Misses++;
+            return false;
+        }
+        Header header;
+        in.read((char*) &header, sizeof(header));
+        std::vector<char> binary(in && header.magic == MAGIC && header.key == key ? header.length : 0);
+        if (!binary.empty()) {
+            in.read(binary.data(), binary.size());
+        }
+        if (binary.empty() || !in) {
+            return reject(key);
+        }
+
+        glExtensions().ProgramBinary(program, header.format, binary.data(), (GLsizei) binary.size());
+        GLint success = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            return reject(key);
+        }
+
+        double loadMs = millisecondsSince(start);
+        m_Hits++;
+        m_SavedMs += header.linkMs - loadMs;
+        m_LoadMs += loadMs;
+        return true;
+    }
+
+    // program has to be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set, linkMs is how long the
+    // driver took and blockingMs how much of that the main thread spent in GL calls
+    void Store(std::uint64_t key, GLuint program, double linkMs, double blockingMs) {
+        m_LinkMs += linkMs;
+        m_BlockingMs += blockingMs;
+        if (!Enabled()) {
+            return;
+        }
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+        std::vector<char> binary(length);
+        Header header;
+        header.key = key;
+        header.linkMs = linkMs;
+        glExtensions().GetProgramBinary(program, length, &length, &header.format, binary.data());
+        header.length = (std::uint32_t) length;
+
+        mkdir(m_Directory.c_str(), 0755);
+        std::ofstream out(entryPath(key), std::ios::binary | std::ios::trunc);
+        out.write((const char*) &header, sizeof(header));
+        out.write(binary.data(), length);
+    }
+
+    void PrintReport() const {
+        if (!Enabled()) {
+            std::cout << "[ProgramCache] program binaries not supported, compiled " << m_Misses
+                      << " programs, linking took " << m_LinkMs << " ms (" << m_BlockingMs
+                      << " ms on the main thread)" << std::endl;
+            return;
+        }
+        std::cout << "[ProgramCache] " << m_Hits << " programs from cache in " << m_LoadMs << " ms, "
+                  << m_Misses << " compiled, linking took " << m_LinkMs << " ms (" << m_BlockingMs
+                  << " ms on the main thread), link time saved: " << m_SavedMs << " ms" << std::endl;
+    }
+
+private:
+    // bumped when entries started storing driver link time instead of main thread time
+    static const std::uint32_t MAGIC = 0x32505753; // "SWP2"
+
+    struct Header {
+        std::uint32_t magic = MAGIC;
+        GLenum format = 0;
+        std::uint64_t key = 0;
+        std::uint32_t length = 0;
+        double linkMs = 0.0;
+    };
+
+    std::string m_Directory = "resources/shader_cache";
+    int m_Hits = 0;
+    int m_Misses = 0;
+    double m_SavedMs = 0.0;
+    double m_LoadMs = 0.0;
+    double m_LinkMs = 0.0;
+    double m_BlockingMs = 0.0;
+
+    ProgramCache() = default;
+
+    std::string entryPath(std::uint64_t key) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+        return m_Directory + "/" + name;
+    }
+
+    static std::string driverString() {
+        std::string driver;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            const char* value = (const char*) glGetString(name);
+            driver += value ? value : "";
+            driver += '\n';
+        }
+        return driver;
+    }
+
+    bool reject(std::uint64_t key) {
+        std::remove(entryPath(key).c_str());
+        m_Misses++;
+        return false;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_PROGRAMCACHE_H
@@ -0,0 +1,816 @@
+//
+// Boxes that fall, collide and come to rest: rigid bodies with a sweep-and-prune broadphase, sleeping, and
+// islands solved in parallel.
+//
+
+#ifndef PROJECT_BASE_RIGIDBODIES_H
+#define PROJECT_BASE_RIGIDBODIES_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <rg/WorkerPool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+// The box a model fills in world space, and the model's transform relative to the box, which is what it
+// is drawn with on top of the body's transform.
+struct BoxCollider {
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::quat orientation;
+    glm::vec3 halfExtents = glm::vec3(0.5f);
+    glm::mat4 offset = glm::mat4(1.0f);
+};
+
+// the box around a model's bounds where placement puts it; placement may rotate, scale and mirror but not
+// shear. Flat models get a little thickness.
+inline BoxCollider boxFromBounds(glm::vec3 boundsMin, glm::vec3 boundsMax, const glm::mat4& placement) {
+    glm::mat3 axes(placement);
+    glm::vec3 scale(glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]));
+    glm::mat3 rotation(axes[0] / scale.x, axes[1] / scale.y, axes[2] / scale.z);
+    // a box is its own mirror image, a mirroring placement only flips an axis of it
+    if (glm::determinant(rotation) < 0.0f) {
+        rotation[2] = -rotation[2];
+    }
+    BoxCollider box;
+    box.center = glm::vec3(placement * glm::vec4(0.5f * (boundsMin + boundsMax), 1.0f));
+    box.orientation = glm::normalize(glm::quat_cast(rotation));
+    box.halfExtents = glm::max(0.5f * (boundsMax - boundsMin) * scale, glm::vec3(0.05f));
+    box.offset = glm::mat4(glm::transpose(rotation)) * glm::translate(glm::mat4(1.0f), -box.center) * placement;
+    return box;
+}
+
+struct RigidBody {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat orientation;
+    glm::vec3 velocity = glm::vec3(0.0f);
+    glm::vec3 angularVelocity = glm::vec3(0.0f);
+    glm::vec3 halfExtents = glm::vec3(0.5f);
+    // 0 for bodies that never move
+    float inverseMass = 0.0f;
+    // of the box, about its own axes
+    glm::vec3 inverseInertia = glm::vec3(0.0f);
+    bool sleeping = false;
+    // how long it has been almost still
+    float restSeconds = 0.0f;
+    // a step ago, frames are drawn between the two
+    glm::vec3 previousPosition = glm::vec3(0.0f);
+    glm::quat previousOrientation;
+};
+
+// A step integrates gravity and the water's drag, finds the pairs of boxes whose bounds overlap by sweeping
+// them along x, and gives every touching pair up to eight contacts from a separating axis test. Bodies
+// connected by contacts form islands, which are independent of each other: they are solved with
+// sequential impulses on the worker pool, biggest first, and an island whose bodies have all been still
+// for SleepSeconds goes to sleep. Sleeping bodies cost nothing until an awake one touches them, which
+// wakes them and, a step later, the ones they touch.
+class RigidBodyWorld {
+public:
+    // what is left of gravity in water once buoyancy takes its share
+    glm::vec3 Gravity = glm::vec3(0.0f, -5.0f, 0.0f);
+    // fractions of the velocity the water takes per second
+    float LinearDamping = 0.3f;
+    float AngularDamping = 0.8f;
+    // the seabed, a plane every body rests on
+    float GroundHeight = -20.0f;
+    float Friction = 0.6f;
+    int Iterations = 10;
+    float SleepSpeed = 0.15f;
+    float SleepSeconds = 0.5f;
+    // slower touchdowns on the seabed aren't reported as impacts
+    float ImpactSpeed = 1.0f;
+
+    // a body touching down on the seabed: about where, and how fast it was going into it
+    struct Impact {
+        glm::vec3 point;
+        float speed;
+    };
+
+    struct Stats {
+        int bodies = 0;
+        int awake = 0;
+        int pairs = 0;
+        int contacts = 0;
+        int islands = 0;
+        // bodies of the biggest awake island: one thread solves it, however many there are
+        int largestIsland = 0;
+        double broadphaseMs = 0.0;
+        double narrowphaseMs = 0.0;
+        double solveMs = 0.0;
+    };
+
+    // a box of density times its volume in mass, or one that never moves with a density of 0; returns
+    // the body's index
+    int Add(const BoxCollider& box, float density) {
+        RigidBody body;
+        body.position = body.previousPosition = box.center;
+        body.orientation = body.previousOrientation = box.orientation;
+        body.halfExtents = box.halfExtents;
+        glm::vec3 size = 2.0f * box.halfExtents;
+        float mass = density * size.x * size.y * size.z;
+        if (mass > 0.0f) {
+            body.inverseMass = 1.0f / mass;
+            glm::vec3 squared = size * size;
+            body.inverseInertia = 12.0f / mass / glm::vec3(squared.y + squared.z, squared.x + squared.z,
+                                                            squared.x + squared.y);
+        }
+        m_Bodies.push_back(body);
+        m_Order.push_back((int) m_Bodies.size() - 1);
+        return (int) m_Bodies.size() - 1;
+    }
+
+    void Clear() {
+        m_Bodies.clear();
+        m_Order.clear();
+        m_Impacts.clear();
+        m_Stats = Stats();
+    }
+
+    int Count() const {
+        return (int) m_Bodies.size();
+    }
+
+    const RigidBody& Body(int index) const {
+        return m_Bodies[index];
+    }
+
+    // the body between the last two steps, alpha of the way
+    glm::mat4 Transform(int index, float alpha) const {
+        const RigidBody& body = m_Bodies[index];
+        glm::quat orientation = body.orientation;
+        if (glm::dot(body.previousOrientation, orientation) < 0.0f) {
+            orientation = -orientation;
+        }
+        orientation = glm::normalize(body.previousOrientation * (1.0f - alpha) + orientation * alpha);
+        glm::vec3 position = glm::mix(body.previousPosition, body.position, alpha);
+        return glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(orientation);
+    }
+
+    const Stats& LastStep() const {
+        return m_Stats;
+    }
+
+    const std::vector<Impact>& Impacts() const {
+        return m_Impacts;
+    }
+
+    void Step(float dt, WorkerPool& pool) {
+        int count = (int) m_Bodies.size();
+        m_Stats = Stats();
+        m_Stats.bodies = count;
+        auto start = std::chrono::steady_clock::now();
+        m_Frames.resize(count);
+        pool.ParallelFor(count, 256, [this, dt](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                integrateVelocity(i, dt);
+            }
+        });
+        sweepAndPrune();
+        auto narrowphase = std::chrono::steady_clock::now();
+        m_Stats.broadphaseMs = milliseconds(start, narrowphase);
+
+        m_PairContacts.resize(m_Pairs.size() * MAX_PAIR_CONTACTS);
+        m_PairContactCounts.resize(m_Pairs.size());
+        pool.ParallelFor((int) m_Pairs.size(), 64, [this](int begin, int end) {
+            for (int pair = begin; pair < end; pair++) {
+                m_PairContactCounts[pair] = collideBoxes(m_Pairs[pair].x, m_Pairs[pair].y,
+                                                         &m_PairContacts[pair * MAX_PAIR_CONTACTS]);
+            }
+        });
+        // bodies woken by a touch need their contacts with the seabed as well
+        connectTouching();
+        m_GroundContacts.resize(count * 8);
+        m_GroundContactCounts.resize(count);
+        pool.ParallelFor(count, 256, [this](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                m_GroundContactCounts[i] = resting(i) ? 0 : collideGround(i, &m_GroundContacts[i * 8]);
+            }
+        });
+        auto solve = std::chrono::steady_clock::now();
+        m_Stats.narrowphaseMs = milliseconds(narrowphase, solve);
+
+        buildIslands();
+        pool.ParallelFor((int) m_Batches.size() - 1, 1, [this, dt](int begin, int end) {
+            for (int batch = begin; batch < end; batch++) {
+                for (int island = m_Batches[batch]; island < m_Batches[batch + 1]; island++) {
+                    solveIsland(m_Islands[island], dt);
+                }
+            }
+        });
+        m_Stats.solveMs = milliseconds(solve, std::chrono::steady_clock::now());
+
+        // kept for warm starting the next step
+        m_CachedRanges.clear();
+        for (const std::pair<std::uint64_t, glm::ivec2>& range : m_Ranges) {
+            m_CachedRanges[range.first] = range.second;
+        }
+        m_CachedContacts.swap(m_Contacts);
+    }
+
+private:
+    static const int MAX_PAIR_CONTACTS = 8;
+
+    struct Contact {
+        // always a body that moves
+        int a = 0;
+        // -1 for the seabed
+        int b = -1;
+        glm::vec3 point = glm::vec3(0.0f);
+        // pushes a away from b
+        glm::vec3 normal = glm::vec3(0.0f);
+        float depth = 0.0f;
+        // the point in a's own space, how a contact is recognized in the next step
+        glm::vec3 local = glm::vec3(0.0f);
+        // the friction impulse the same contact ended the last step with, in world space
+        glm::vec3 friction = glm::vec3(0.0f);
+        // set up by the solver
+        glm::vec3 ra, rb;
+        glm::vec3 tangents[2];
+        float normalMass = 0.0f;
+        float tangentMass[2] = {0.0f, 0.0f};
+        float bias = 0.0f;
+        float normalImpulse = 0.0f;
+        float tangentImpulses[2] = {0.0f, 0.0f};
+    };
+
+    // a body's box and inverse inertia in world space for the current step, and its bounds
+    struct Frame {
+        glm::mat3 axes;
+        glm::mat3 inverseInertia;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
+    struct SweepEntry {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        int body;
+        bool resting;
+    };
+
+    struct Island {
+        // ranges of m_IslandBodies and m_IslandContacts
+        int firstBody, bodies;
+        int firstContact, contacts;
+    };
+
+    std::vector<RigidBody> m_Bodies;
+    std::vector<Frame> m_Frames;
+    // bodies by the lower end of their bounds along x, kept from step to step
+    std::vector<int> m_Order;
+    std::vector<SweepEntry> m_Sweep;
+    std::vector<glm::ivec2> m_Pairs;
+    std::vector<Contact> m_PairContacts;
+    std::vector<int> m_PairContactCounts;
+    std::vector<Contact> m_GroundContacts;
+    std::vector<int> m_GroundContactCounts;
+    std::vector<Contact> m_Contacts;
+    std::vector<int> m_Parents;
+    std::vector<int> m_IslandOf;
+    std::vector<Island> m_Islands;
+    std::vector<int> m_IslandBodies;
+    std::vector<int> m_IslandContacts;
+    // islands m_Batches[i] up to m_Batches[i + 1] are solved by one thread
+    std::vector<int> m_Batches;
+    // the contacts of every pair (a, -1 for the seabed) of this step and the last
+    std::vector<std::pair<std::uint64_t, glm::ivec2>> m_Ranges;
+    std::unordered_map<std::uint64_t, glm::ivec2> m_CachedRanges;
+    std::vector<Contact> m_CachedContacts;
+    // of the last step
+    std::vector<Impact> m_Impacts;
+    Stats m_Stats;
+
+    static double milliseconds(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    // sleeping and static bodies don't move this step
+    bool resting(int i) const {
+        return m_Bodies[i].sleeping || m_Bodies[i].inverseMass == 0.0f;
+    }
+
+    void integrateVelocity(int i, float dt) {
+        RigidBody& body = m_Bodies[i];
+        body.previousPosition = body.position;
+        body.previousOrientation = body.orientation;
+        if (!resting(i)) {
+            body.velocity = (body.velocity + Gravity * dt) * std::max(1.0f - LinearDamping * dt, 0.0f);
+            body.angularVelocity *= std::max(1.0f - AngularDamping * dt, 0.0f);
+        }
+        Frame& frame = m_Frames[i];
+        frame.axes = glm::mat3_cast(body.orientation);
+        glm::mat3 scaled = frame.axes;
+        for (int axis = 0; axis < 3; axis++) {
+            scaled[axis] *= body.inverseInertia[axis];
+        }
+        frame.inverseInertia = scaled * glm::transpose(frame.axes);
+        glm::vec3 extent(0.0f);
+        for (int axis = 0; axis < 3; axis++) {
+            extent += glm::abs(frame.axes[axis]) * body.halfExtents[axis];
+        }
+        frame.boundsMin = body.position - extent;
+        frame.boundsMax = body.position + extent;
+    }
+
+    // the order is nearly sorted already from the last step, insertion sort puts it right in about linear time
+    void sweepAndPrune() {
+        for (size_t i = 1; i < m_Order.size(); i++) {
+            int body = m_Order[i];
+            float key = m_Frames[body].boundsMin.x;
+            size_t j = i;
+            for (; j > 0 && m_Frames[m_Order[j - 1]].boundsMin.x > key; j--) {
+                m_Order[j] = m_Order[j - 1];
+            }
+            m_Order[j] = body;
+        }
+        // the sweep runs over a copy of the bounds in that order, a pile overlaps many others along x
+        m_Sweep.resize(m_Order.size());
+        for (size_t i = 0; i < m_Order.size(); i++) {
+            int body = m_Order[i];
+            m_Sweep[i] = {m_Frames[body].boundsMin, m_Frames[body].boundsMax, body, resting(body)};
+        }
+        m_Pairs.clear();
+        for (size_t i = 0; i < m_Sweep.size(); i++) {
+            const SweepEntry& first = m_Sweep[i];
+            int a = first.body;
+            for (size_t j = i + 1; j < m_Sweep.size(); j++) {
+                const SweepEntry& second = m_Sweep[j];
+                int b = second.body;
+                if (second.boundsMin.x > first.boundsMax.x) {
+                    break;
+                }
+                if ((first.resting && second.resting) || second.boundsMin.y > first.boundsMax.y ||
+                    first.boundsMin.y > second.boundsMax.y || second.boundsMin.z > first.boundsMax.z ||
+                    first.boundsMin.z > second.boundsMax.z) {
+                    continue;
+                }
+                if (m_Bodies[a].inverseMass == 0.0f) {
+                    m_Pairs.push_back(glm::ivec2(b, a));
+                } else {
+                    m_Pairs.push_back(glm::ivec2(a, b));
+                }
+            }
+        }
+        m_Stats.pairs = (int) m_Pairs.size();
+    }
+
+    static float projectedRadius(const glm::mat3& axes, glm::vec3 halfExtents, glm::vec3 direction) {
+        return halfExtents.x * std::abs(glm::dot(axes[0], direction)) +
+               halfExtents.y * std::abs(glm::dot(axes[1], direction)) +
+               halfExtents.z * std::abs(glm::dot(axes[2], direction));
+    }
+
+    // Separating axis test over the 15 axes of two boxes. Boxes that touch face first get the incident face
+    // clipped against the reference face, up to eight contacts; boxes that touch edge first get one between
+    // the closest points of the two edges. Face axes win ties, they give steadier contacts.
+    int collideBoxes(int a, int b, Contact* contacts) const {
+        const RigidBody& first = m_Bodies[a];
+        const RigidBody& second = m_Bodies[b];
+        const glm::mat3& axesA = m_Frames[a].axes;
+        const glm::mat3& axesB = m_Frames[b].axes;
+        glm::vec3 offset = first.position - second.position;
+
+        float faceDepth = std::numeric_limits<float>::max();
+        float edgeDepth = std::numeric_limits<float>::max();
+        int faceAxis = -1;
+        glm::ivec2 edges(-1, -1);
+        glm::vec3 faceNormal(0.0f), edgeNormal(0.0f);
+        // false once the boxes are found apart
+        auto test = [&](glm::vec3 axis, float& best, glm::vec3& normal) {
+            float distance = glm::dot(offset, axis);
+            float depth = projectedRadius(axesA, first.halfExtents, axis) +
+                          projectedRadius(axesB, second.halfExtents, axis) - std::abs(distance);
+            if (depth < 0.0f) {
+                return false;
+            }
+            if (depth < best) {
+                best = depth;
+                normal = distance < 0.0f ? -axis : axis;
+            }
+            return true;
+        };
+        for (int axis = 0; axis < 6; axis++) {
+            float best = faceDepth;
+            if (!test(axis < 3 ? axesA[axis] : axesB[axis - 3], faceDepth, faceNormal)) {
+                return 0;
+            }
+            if (faceDepth < best) {
+                faceAxis = axis;
+            }
+        }
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                glm::vec3 axis = glm::cross(axesA[i], axesB[j]);
+                float length = glm::length(axis);
+                // parallel edges, the face axes cover them
+                if (length < 1e-4f) {
+                    continue;
+                }
+                float best = edgeDepth;
+                if (!test(axis / length, edgeDepth, edgeNormal)) {
+                    return 0;
+                }
+                if (edgeDepth < best) {
+                    edges = glm::ivec2(i, j);
+                }
+            }
+        }
+
+        if (edges.x >= 0 && edgeDepth < 0.95f * faceDepth - 0.01f) {
+            // the edge of each box nearest to the other
+            glm::vec3 pointA = first.position, pointB = second.position;
+            for (int axis = 0; axis < 3; axis++) {
+                if (axis != edges.x) {
+                    pointA += axesA[axis] * (glm::dot(axesA[axis], edgeNormal) > 0.0f ? -1.0f : 1.0f) *
+                              first.halfExtents[axis];
+                }
+                if (axis != edges.y) {
+                    pointB += axesB[axis] * (glm::dot(axesB[axis], edgeNormal) > 0.0f ? 1.0f : -1.0f) *
+                              second.halfExtents[axis];
+                }
+            }
+            glm::vec3 directionA = axesA[edges.x], directionB = axesB[edges.y];
+            glm::vec3 between = pointA - pointB;
+            float along = glm::dot(directionA, directionB);
+            float denominator = 1.0f - along * along;
+            float s = 0.0f, t = 0.0f;
+            if (denominator > 1e-6f) {
+                s = (along * glm::dot(directionB, between) - glm::dot(directionA, between)) / denominator;
+                s = glm::clamp(s, -first.halfExtents[edges.x], first.halfExtents[edges.x]);
+            }
+            t = glm::clamp(glm::dot(directionB, pointA + directionA * s - pointB), -second.halfExtents[edges.y],
+                           second.halfExtents[edges.y]);
+            Contact& contact = contacts[0];
+            contact = Contact();
+            contact.a = a;
+            contact.b = b;
+            contact.point = 0.5f * (pointA + directionA * s + pointB + directionB * t);
+            contact.normal = edgeNormal;
+            contact.depth = edgeDepth;
+            return 1;
+        }
+
+        // the reference face is the one of faceAxis facing the other box, the incident face is the other
+        // box's face turned most against it
+        bool referenceIsA = faceAxis < 3;
+        const RigidBody& reference = referenceIsA ? first : second;
+        const RigidBody& incident = referenceIsA ? second : first;
+        const glm::mat3& referenceAxes = referenceIsA ? axesA : axesB;
+        const glm::mat3& incidentAxes = referenceIsA ? axesB : axesA;
+        int axis = faceAxis % 3;
+        glm::vec3 faceDirection = referenceIsA ? -faceNormal : faceNormal;
+
+        int incidentAxis = 0;
+        float most = -1.0f;
+        for (int i = 0; i < 3; i++) {
+            float facing = std::abs(glm::dot(incidentAxes[i], faceDirection));
+            if (facing > most) {
+                most = facing;
+                incidentAxis = i;
+            }
+        }
+        float side = glm::dot(incidentAxes[incidentAxis], faceDirection) > 0.0f ? -1.0f : 1.0f;
+        glm::vec3 center = incident.position + incidentAxes[incidentAxis] * (side * incident.halfExtents[incidentAxis]);
+        int u = (incidentAxis + 1) % 3, v = (incidentAxis + 2) % 3;
+        glm::vec3 edgeU = incidentAxes[u] * incident.halfExtents[u];
+        glm::vec3 edgeV = incidentAxes[v] * incident.halfExtents[v];
+        glm::vec3 polygon[8] = {center + edgeU + edgeV, center - edgeU + edgeV, center - edgeU - edgeV,
+                                center + edgeU - edgeV};
+        int corners = 4;
+
+        // clipped by the four sides of the reference face
+        for (int plane = 0; plane < 4 && corners > 0; plane++) {
+            int sideAxis = (axis + 1 + plane / 2) % 3;
+            glm::vec3 normal = referenceAxes[sideAxis] * (plane % 2 == 0 ? 1.0f : -1.0f);
+            float limit = glm::dot(normal, reference.position) + reference.halfExtents[sideAxis];
+            glm::vec3 clipped[8];
+            int kept = 0;
+            for (int i = 0; i < corners; i++) {
+                glm::vec3 from = polygon[i], to = polygon[(i + 1) % corners];
+                float distanceFrom = glm::dot(normal, from) - limit, distanceTo = glm::dot(normal, to) - limit;
+                if (distanceFrom <= 0.0f && kept < 8) {
+                    clipped[kept++] = from;
+                }
+                if ((distanceFrom < 0.0f) != (distanceTo < 0.0f) && kept < 8) {
+                    clipped[kept++] = from + (to - from) * (distanceFrom / (distanceFrom - distanceTo));
+                }
+            }
+            std::copy(clipped, clipped + kept, polygon);
+            corners = kept;
+        }
+
+        float face = glm::dot(faceDirection, reference.position) + reference.halfExtents[axis];
+        int count = 0;
+        for (int i = 0; i < corners; i++) {
+            float depth = face - glm::dot(faceDirection, polygon[i]);
+            if (depth < 0.0f) {
+                continue;
+            }
+            Contact& contact = contacts[count++];
+            contact = Contact();
+            contact.a = a;
+            contact.b = b;
+            // halfway between the two surfaces
+            contact.point = polygon[i] + faceDirection * (0.5f * depth);
+            contact.normal = faceNormal;
+            contact.depth = depth;
+        }
+        return count;
+    }
+
+    // the corners below the seabed
+    int collideGround(int i, Contact* contacts) const {
+        const RigidBody& body = m_Bodies[i];
+        if (m_Frames[i].boundsMin.y > GroundHeight) {
+            return 0;
+        }
+        const glm::mat3& axes = m_Frames[i].axes;
+        int count = 0;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 point = body.position + axes[0] * ((corner & 1) ? body.halfExtents.x : -body.halfExtents.x) +
+                              axes[1] * ((corner & 2) ? body.halfExtents.y : -body.halfExtents.y) +
+                              axes[2] * ((corner & 4) ? body.halfExtents.z : -body.halfExtents.z);
+            float depth = GroundHeight - point.y;
+            if (depth < 0.0f) {
+                continue;
+            }
+            Contact& contact = contacts[count++];
+            contact = Contact();
+            contact.a = i;
+            contact.point = point + glm::vec3(0.0f, 0.5f * depth, 0.0f);
+            contact.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+            contact.depth = depth;
+        }
+        return count;
+    }
+
+    int findRoot(int i) {
+        while (m_Parents[i] != i) {
+            m_Parents[i] = m_Parents[m_Parents[i]];
+            i = m_Parents[i];
+        }
+        return i;
+    }
+
+    // Bodies touching each other form an island, with their contacts with the seabed and with bodies that
+    // never move. A sleeping body touched by an awake one wakes up, the rest of its island follows in the
+    // next steps as the bodies touching it are found awake.
+    void connectTouching() {
+        int count = (int) m_Bodies.size();
+        m_Parents.resize(count);
+        for (int i = 0; i < count; i++) {
+            m_Parents[i] = i;
+        }
+        for (size_t pair = 0; pair < m_Pairs.size(); pair++) {
+            int a = m_Pairs[pair].x, b = m_Pairs[pair].y;
+            if (m_PairContactCounts[pair] > 0 && m_Bodies[b].inverseMass > 0.0f) {
+                m_Parents[findRoot(a)] = findRoot(b);
+            }
+        }
+        // -1 for islands asleep, 0 for awake ones until they are numbered
+        m_IslandOf.assign(count, -1);
+        for (int i = 0; i < count; i++) {
+            if (!resting(i)) {
+                m_IslandOf[findRoot(i)] = 0;
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            RigidBody& body = m_Bodies[i];
+            if (body.sleeping && m_IslandOf[findRoot(i)] >= 0) {
+                body.sleeping = false;
+                body.restSeconds = 0.0f;
+            }
+        }
+    }
+
+    // the contacts and bodies of every awake island next to each other, islands numbered from 1
+    void buildIslands() {
+        int count = (int) m_Bodies.size();
+        m_Contacts.clear();
+        m_Ranges.clear();
+        m_Impacts.clear();
+        for (size_t pair = 0; pair < m_Pairs.size(); pair++) {
+            addContacts(m_Pairs[pair].x, m_Pairs[pair].y, &m_PairContacts[pair * MAX_PAIR_CONTACTS],
+                        m_PairContactCounts[pair]);
+        }
+        for (int i = 0; i < count; i++) {
+            addContacts(i, -1, &m_GroundContacts[i * 8], m_GroundContactCounts[i]);
+        }
+        m_Stats.contacts = (int) m_Contacts.size();
+
+        m_Islands.clear();
+        for (int i = 0; i < count; i++) {
+            if (resting(i)) {
+                continue;
+            }
+            int& island = m_IslandOf[findRoot(i)];
+            if (island == 0) {
+                m_Islands.push_back({0, 0, 0, 0});
+                island = (int) m_Islands.size();
+            }
+            m_Islands[island - 1].bodies++;
+        }
+        for (const Contact& contact : m_Contacts) {
+            m_Islands[m_IslandOf[findRoot(contact.a)] - 1].contacts++;
+        }
+        int bodies = 0, contacts = 0;
+        for (Island& island : m_Islands) {
+            island.firstBody = bodies;
+            island.firstContact = contacts;
+            bodies += island.bodies;
+            contacts += island.contacts;
+            island.bodies = island.contacts = 0;
+        }
+        m_IslandBodies.resize(bodies);
+        m_IslandContacts.resize(contacts);
+        for (int i = 0; i < count; i++) {
+            if (!resting(i)) {
+                Island& island = m_Islands[m_IslandOf[findRoot(i)] - 1];
+                m_IslandBodies[island.firstBody + island.bodies++] = i;
+            }
+        }
+        for (int i = 0; i < (int) m_Contacts.size(); i++) {
+            Island& island = m_Islands[m_IslandOf[findRoot(m_Contacts[i].a)] - 1];
+            m_IslandContacts[island.firstContact + island.contacts++] = i;
+        }
+        m_Stats.awake = bodies;
+        m_Stats.islands = (int) m_Islands.size();
+
+        // the biggest islands first so that none is left to start last, small ones are batched up
+        std::sort(m_Islands.begin(), m_Islands.end(), [](const Island& first, const Island& second) {
+            return first.contacts + first.bodies > second.contacts + second.bodies;
+        });
+        m_Stats.largestIsland = m_Islands.empty() ? 0 : m_Islands[0].bodies;
+        m_Batches.assign(1, 0);
+        int work = 0;
+        for (int island = 0; island < (int) m_Islands.size(); island++) {
+            work += m_Islands[island].contacts + m_Islands[island].bodies;
+            if (work >= 256 || island + 1 == (int) m_Islands.size()) {
+                m_Batches.push_back(island + 1);
+                work = 0;
+            }
+        }
+    }
+
+    // A contact starts from the impulses it ended the last step with, so a resting pile doesn't have to be
+    // held up from nothing every step and settles instead of creeping. It is the same contact if the same
+    // pair touched within a hair of the same point of a.
+    void addContacts(int a, int b, const Contact* contacts, int count) {
+        if (count == 0) {
+            return;
+        }
+        std::uint64_t key = (std::uint64_t) a << 32 | (std::uint32_t) b;
+        m_Ranges.push_back(std::make_pair(key, glm::ivec2((int) m_Contacts.size(), count)));
+        auto cached = m_CachedRanges.find(key);
+        if (b < 0 && cached == m_CachedRanges.end()) {
+            reportImpact(a, contacts, count);
+        }
+        glm::mat3 toLocal = glm::transpose(m_Frames[a].axes);
+        for (int i = 0; i < count; i++) {
+            Contact contact = contacts[i];
+            contact.local = toLocal * (contact.point - m_Bodies[a].position);
+            if (cached != m_CachedRanges.end()) {
+                const Contact* last = &m_CachedContacts[cached->second.x];
+                float nearest = 0.01f;
+                for (int j = 0; j < cached->second.y; j++) {
+                    glm::vec3 apart = last[j].local - contact.local;
+                    if (glm::dot(apart, apart) < nearest) {
+                        nearest = glm::dot(apart, apart);
+                        contact.normalImpulse = last[j].normalImpulse;
+                        contact.friction = last[j].tangents[0] * last[j].tangentImpulses[0] +
+                                           last[j].tangents[1] * last[j].tangentImpulses[1];
+                    }
+                }
+            }
+            m_Contacts.push_back(contact);
+        }
+    }
+
+    // a body that didn't touch the seabed in the last step does now
+    void reportImpact(int a, const Contact* contacts, int count) {
+        const RigidBody& body = m_Bodies[a];
+        glm::vec3 point(0.0f);
+        for (int i = 0; i < count; i++) {
+            point += contacts[i].point;
+        }
+        point /= (float) count;
+        float speed = -glm::dot(body.velocity + glm::cross(body.angularVelocity, point - body.position),
+                                contacts[0].normal);
+        if (speed >= ImpactSpeed) {
+            m_Impacts.push_back({point, speed});
+        }
+    }
+
+    // whether b of a contact takes impulses, the seabed and static bodies don't
+    bool movable(int b) const {
+        return b >= 0 && m_Bodies[b].inverseMass > 0.0f;
+    }
+
+    float effectiveMass(const Contact& contact, glm::vec3 direction) const {
+        const RigidBody& first = m_Bodies[contact.a];
+        glm::vec3 armA = glm::cross(contact.ra, direction);
+        float mass = first.inverseMass + glm::dot(armA, m_Frames[contact.a].inverseInertia * armA);
+        if (movable(contact.b)) {
+            const RigidBody& second = m_Bodies[contact.b];
+            glm::vec3 armB = glm::cross(contact.rb, direction);
+            mass += second.inverseMass + glm::dot(armB, m_Frames[contact.b].inverseInertia * armB);
+        }
+        return mass > 0.0f ? 1.0f / mass : 0.0f;
+    }
+
+    glm::vec3 relativeVelocity(const Contact& contact) const {
+        const RigidBody& first = m_Bodies[contact.a];
+        glm::vec3 velocity = first.velocity + glm::cross(first.angularVelocity, contact.ra);
+        if (contact.b >= 0) {
+            const RigidBody& second = m_Bodies[contact.b];
+            velocity -= second.velocity + glm::cross(second.angularVelocity, contact.rb);
+        }
+        return velocity;
+    }
+
+    void applyImpulse(const Contact& contact, glm::vec3 impulse) {
+        RigidBody& first = m_Bodies[contact.a];
+        first.velocity += impulse * first.inverseMass;
+        first.angularVelocity += m_Frames[contact.a].inverseInertia * glm::cross(contact.ra, impulse);
+        if (movable(contact.b)) {
+            RigidBody& second = m_Bodies[contact.b];
+            second.velocity -= impulse * second.inverseMass;
+            second.angularVelocity -= m_Frames[contact.b].inverseInertia * glm::cross(contact.rb, impulse);
+        }
+    }
+
+    // sequential impulses: every contact in turn stops the bodies approaching along its normal and, within
+    // the friction cone, from sliding; penetration is pushed out over a few steps
+    void solveIsland(const Island& island, float dt) {
+        const int* contacts = &m_IslandContacts[island.firstContact];
+        for (int i = 0; i < island.contacts; i++) {
+            Contact& contact = m_Contacts[contacts[i]];
+            contact.ra = contact.point - m_Bodies[contact.a].position;
+            contact.rb = contact.b >= 0 ? contact.point - m_Bodies[contact.b].position : glm::vec3(0.0f);
+            glm::vec3 helper = std::abs(contact.normal.x) < 0.6f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                                                   : glm::vec3(0.0f, 1.0f, 0.0f);
+            contact.tangents[0] = glm::normalize(glm::cross(contact.normal, helper));
+            contact.tangents[1] = glm::cross(contact.normal, contact.tangents[0]);
+            contact.normalMass = effectiveMass(contact, contact.normal);
+            contact.tangentMass[0] = effectiveMass(contact, contact.tangents[0]);
+            contact.tangentMass[1] = effectiveMass(contact, contact.tangents[1]);
+            contact.bias = std::min(0.2f / dt * std::max(contact.depth - 0.01f, 0.0f), 3.0f);
+            contact.tangentImpulses[0] = glm::dot(contact.friction, contact.tangents[0]);
+            contact.tangentImpulses[1] = glm::dot(contact.friction, contact.tangents[1]);
+            applyImpulse(contact, contact.normal * contact.normalImpulse + contact.friction);
+        }
+        for (int iteration = 0; iteration < Iterations; iteration++) {
+            for (int i = 0; i < island.contacts; i++) {
+                Contact& contact = m_Contacts[contacts[i]];
+                glm::vec3 velocity = relativeVelocity(contact);
+                float impulse = contact.normalMass * (contact.bias - glm::dot(velocity, contact.normal));
+                float total = std::max(contact.normalImpulse + impulse, 0.0f);
+                impulse = total - contact.normalImpulse;
+                contact.normalImpulse = total;
+                applyImpulse(contact, contact.normal * impulse);
+
+                float limit = Friction * contact.normalImpulse;
+                for (int t = 0; t < 2; t++) {
+                    velocity = relativeVelocity(contact);
+                    impulse = -contact.tangentMass[t] * glm::dot(velocity, contact.tangents[t]);
+                    total = glm::clamp(contact.tangentImpulses[t] + impulse, -limit, limit);
+                    impulse = total - contact.tangentImpulses[t];
+                    contact.tangentImpulses[t] = total;
+                    applyImpulse(contact, contact.tangents[t] * impulse);
+                }
+            }
+        }
+
+        // positions, and the island sleeps once all of it has been still long enough
+        float rest = std::numeric_limits<float>::max();
+        for (int i = 0; i < island.bodies; i++) {
+            RigidBody& body = m_Bodies[m_IslandBodies[island.firstBody + i]];
+            body.position += body.velocity * dt;
+            glm::vec3 w = body.angularVelocity;
+            body.orientation = glm::normalize(body.orientation + glm::quat(0.0f, w.x, w.y, w.z) * body.orientation *
+                                                                 (0.5f * dt));
+            float speed = glm::dot(body.velocity, body.velocity) + glm::dot(w, w);
+            body.restSeconds = speed < SleepSpeed * SleepSpeed ? body.restSeconds + dt : 0.0f;
+            rest = std::min(rest, body.restSeconds);
+        }
+        if (rest >= SleepSeconds) {
+            for (int i = 0; i < island.bodies; i++) {
+                RigidBody& body = m_Bodies[m_IslandBodies[island.firstBody + i]];
+                body.sleeping = true;
+                body.velocity = body.angularVelocity = glm::vec3(0.0f);
+            }
+        }
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_RIGIDBODIES_H
@@ -0,0 +1,99 @@
+//
+// Distance based shading level of detail.
+//
+
+#ifndef PROJECT_BASE_SHADINGLOD_H
+#define PROJECT_BASE_SHADINGLOD_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace rg {
+
+// NEAR - all lights per fragment with detail (specular, normal, parallax) maps
+// MID  - all lights per fragment, detail maps skipped
+// FAR  - ambient and a single light evaluated per vertex
+enum ShadingLod {
+    SHADING_LOD_NEAR = 0,
+    SHADING_LOD_MID,
+    SHADING_LOD_FAR,
+    SHADING_LOD_COUNT
+};
+
+// preprocessor symbol that selects the variant in model/quad shaders
+inline const char* shadingLodDefine(ShadingLod lod) {
+    switch (lod) {
+        case SHADING_LOD_MID: return "SHADING_LOD_MID";
+        case SHADING_LOD_FAR: return "SHADING_LOD_FAR";
+        default: return "SHADING_LOD_NEAR";
+    }
+}
+
+// approximate height in pixels of a bounding sphere projected on screen
+inline float projectedScreenSize(const glm::vec3& center, float radius, const glm::vec3& cameraPosition,
+                                 float fovyRadians, int viewportHeight) {
+    float distance = glm::length(center - cameraPosition);
+    if (distance <= radius) {
+        return (float) viewportHeight;
+    }
+    float projectedRadius = radius / (distance * std::tan(0.5f * fovyRadians));
+    return projectedRadius * (float) viewportHeight;
+}
+
+// moves a model space bounding sphere into world space, radius follows the largest axis scale
+inline void transformBoundingSphere(const glm::mat4& model, const glm::vec3& center, float radius,
+                                    glm::vec3& worldCenter, float& worldRadius) {
+    worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(model[0])),
+                           std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    worldRadius = radius * scale;
+}
+
+// Picks a ShadingLod from projected screen size. Switching to a finer level requires
+// the size to grow past threshold * (1 + hysteresis), switching to a coarser one requires
+// it to drop below threshold * (1 - hysteresis), so objects sitting on a boundary don't flicker.
+class ShadingLodSelector {
+public:
+    float NearThreshold = 250.0f; // pixels, above this objects are NEAR
+    float FarThreshold = 60.0f;   // pixels, below this objects are FAR
+    float Hysteresis = 0.2f;
+
+    ShadingLod Update(float screenSize) {
+        ShadingLod target = levelFor(screenSize);
+        if (target < m_Level) {
+            // getting finer, must clear the upper edge of the current level's band
+            float edge = (m_Level == SHADING_LOD_FAR ? FarThreshold : NearThreshold) * (1.0f + Hysteresis);
+            if (screenSize > edge) {
+                m_Level = target;
+            }
+        } else if (target > m_Level) {
+            float edge = (m_Level == SHADING_LOD_NEAR ? NearThreshold : FarThreshold) * (1.0f - Hysteresis);
+            if (screenSize < edge) {
+                m_Level = target;
+            }
+        }
+        return m_Level;
+    }
+
+    ShadingLod Current() const {
+        return m_Level;
+    }
+
+private:
+    ShadingLod m_Level = SHADING_LOD_NEAR;
+
+    ShadingLod levelFor(float screenSize) const {
+        if (screenSize >= NearThreshold) {
+            return SHADING_LOD_NEAR;
+        }
+        if (screenSize >= FarThreshold) {
+            return SHADING_LOD_MID;
+        }
+        return SHADING_LOD_FAR;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_SHADINGLOD_H
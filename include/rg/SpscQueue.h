@@ -0,0 +1,62 @@
+//
+// Bounded lock-free queue between exactly one producer and one consumer thread.
+//
+
+#ifndef PROJECT_BASE_SPSCQUEUE_H
+#define PROJECT_BASE_SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace rg {
+
+// Push is only ever called from the producer thread and Pop only from the consumer thread.
+// Each side owns one index and publishes it with release, the other side reads it with acquire,
+// so an element is fully written before the consumer can see it.
+template<typename T>
+class SpscQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscQueue(std::size_t capacity = 256) {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_Items.resize(size);
+        m_Mask = size - 1;
+    }
+
+    // returns false when the queue is full
+    bool Push(const T& item) {
+        std::size_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail - m_Head.load(std::memory_order_acquire) > m_Mask) {
+            return false;
+        }
+        m_Items[tail & m_Mask] = item;
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // returns false when the queue is empty
+    bool Pop(T& item) {
+        std::size_t head = m_Head.load(std::memory_order_relaxed);
+        if (head == m_Tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = m_Items[head & m_Mask];
+        m_Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> m_Items;
+    std::size_t m_Mask = 0;
+    // head and tail live on separate cache lines so the two threads don't keep stealing them
+    alignas(64) std::atomic<std::size_t> m_Head{0};
+    alignas(64) std::atomic<std::size_t> m_Tail{0};
+};
+
+};
+
+#endif //PROJECT_BASE_SPSCQUEUE_H
@@ -0,0 +1,236 @@
+//
+// Timeline of everything that happens before the scene is complete, written as Chrome trace JSON.
+//
+
+#ifndef PROJECT_BASE_STARTUPPROFILER_H
+#define PROJECT_BASE_STARTUPPROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+// contents of a JSON string literal, paths on Windows carry backslashes
+inline std::string jsonEscape(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if ((unsigned char) c < 0x20) {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// Only records after Start, which --startup-profile calls, so instrumented code costs one atomic load
+// otherwise. Events come from the render thread, the loader thread and the driver (shader compiles,
+// asset jobs in flight); the latter are async spans so that overlapping ones show up side by side,
+// which is how to tell whether loading actually runs in parallel. Finish writes the file
+// (chrome://tracing or ui.perfetto.dev open it) and stops recording.
+class StartupProfiler {
+public:
+    static StartupProfiler& Instance() {
+        static StartupProfiler profiler;
+        return profiler;
+    }
+
+    // origin is time zero of the trace, usually the first line of main
+    void Start(std::chrono::steady_clock::time_point origin, const std::string& path) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Origin = origin;
+        m_Path = path;
+        m_Recording.store(true, std::memory_order_release);
+    }
+
+    bool Recording() const {
+        return m_Recording.load(std::memory_order_acquire);
+    }
+
+    // name of the calling thread in the trace
+    void NameThread(const std::string& name) {
+        if (!Recording()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_ThreadNames[threadIndex()] = name;
+    }
+
+    // args is a list of "key": value pairs without the braces, see StartupZone::Arg
+    void Record(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+                std::chrono::steady_clock::time_point end, const std::string& args) {
+        if (!Recording()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        long long timestamp = microseconds(start);
+        m_Events.push_back({name, category, 'X', threadIndex(), 0, timestamp, microseconds(end) - timestamp, args});
+    }
+
+    // span that may overlap others on the same thread, e.g. work the driver or another thread does for it
+    void RecordAsync(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point end, const std::string& args) {
+        if (!Recording()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        int id = ++m_AsyncIds;
+        int thread = threadIndex();
+        m_Events.push_back({name, category, 'b', thread, id, microseconds(start), 0, args});
+        m_Events.push_back({name, category, 'e', thread, id, microseconds(end), 0, ""});
+    }
+
+    void Instant(const char* name) {
+        if (!Recording()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        long long timestamp = microseconds(std::chrono::steady_clock::now());
+        m_Events.push_back({name, "startup", 'i', threadIndex(), 0, timestamp, 0, ""});
+    }
+
+    // writes the trace and stops recording, later calls do nothing
+    void Finish() {
+        if (!m_Recording.exchange(false, std::memory_order_acq_rel)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::ofstream out(m_Path);
+        if (!out) {
+            std::cout << "[StartupProfiler] failed to write " << m_Path << std::endl;
+            return;
+        }
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        bool first = true;
+        for (auto& thread : m_ThreadNames) {
+            out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+                << thread.first << ", \"args\": {\"name\": \"" << jsonEscape(thread.second) << "\"}}";
+            first = false;
+        }
+        for (const Event& event : m_Events) {
+            out << (first ? "" : ",\n") << "{\"name\": \"" << event.name << "\", \"cat\": \"" << event.category
+                << "\", \"ph\": \"" << event.phase << "\", \"pid\": 1, \"tid\": " << event.thread
+                << ", \"ts\": " << event.timestamp;
+            if (event.phase == 'X') {
+                out << ", \"dur\": " << event.duration;
+            } else if (event.phase == 'i') {
+                out << ", \"s\": \"g\"";
+            } else {
+                out << ", \"id\": " << event.id;
+            }
+            out << ", \"args\": {" << event.args << "}}";
+            first = false;
+        }
+        out << "\n]}\n";
+        std::cout << "[StartupProfiler] " << m_Events.size() << " events written to " << m_Path << std::endl;
+        m_Events.clear();
+    }
+
+private:
+    struct Event {
+        const char* name;
+        const char* category;
+        char phase;
+        int thread;
+        int id;
+        long long timestamp;
+        long long duration;
+        std::string args;
+    };
+
+    std::atomic<bool> m_Recording{false};
+    std::mutex m_Mutex;
+    std::chrono::steady_clock::time_point m_Origin;
+    std::string m_Path;
+    std::vector<Event> m_Events;
+    std::map<std::thread::id, int> m_Threads;
+    std::map<int, std::string> m_ThreadNames;
+    int m_AsyncIds = 0;
+
+    StartupProfiler() = default;
+
+    long long microseconds(std::chrono::steady_clock::time_point time) const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - m_Origin).count();
+    }
+
+    // small stable ids in order of appearance read better in the viewer than hashed thread ids, mutex held
+    int threadIndex() {
+        auto found = m_Threads.find(std::this_thread::get_id());
+        if (found != m_Threads.end()) {
+            return found->second;
+        }
+        int index = (int) m_Threads.size() + 1;
+        m_Threads[std::this_thread::get_id()] = index;
+        return index;
+    }
+};
+
+// Records the time from construction to destruction as one event on the calling thread.
+// Arguments show up in the viewer when the event is selected.
+class StartupZone {
+public:
+    StartupZone(const char* name, const char* category)
+            : m_Name(name), m_Category(category), m_Recording(StartupProfiler::Instance().Recording()) {
+        if (m_Recording) {
+            m_Start = std::chrono::steady_clock::now();
+        }
+    }
+
+    StartupZone(const StartupZone&) = delete;
+    StartupZone& operator=(const StartupZone&) = delete;
+
+    ~StartupZone() {
+        if (m_Recording) {
+            StartupProfiler::Instance().Record(m_Name, m_Category, m_Start, std::chrono::steady_clock::now(), m_Args);
+        }
+    }
+
+    StartupZone& Arg(const char* key, long long value) {
+        if (m_Recording) {
+            appendKey(key);
+            m_Args += std::to_string(value);
+        }
+        return *this;
+    }
+
+    StartupZone& Arg(const char* key, const std::string& value) {
+        if (m_Recording) {
+            appendKey(key);
+            m_Args += '"' + jsonEscape(value) + '"';
+        }
+        return *this;
+    }
+
+private:
+    const char* m_Name;
+    const char* m_Category;
+    bool m_Recording;
+    std::chrono::steady_clock::time_point m_Start;
+    std::string m_Args;
+
+    void appendKey(const char* key) {
+        if (!m_Args.empty()) {
+            m_Args += ", ";
+        }
+        m_Args += '"';
+        m_Args += key;
+        m_Args += "\": ";
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_STARTUPPROFILER_H
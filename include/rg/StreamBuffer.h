@@ -0,0 +1,178 @@
+//
+// Vertex buffer rewritten every frame, by orphaning or through a persistently mapped ring.
+//
+
+#ifndef PROJECT_BASE_STREAMBUFFER_H
+#define PROJECT_BASE_STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include <rg/Error.h>
+#include <rg/GLExtensions.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace rg {
+
+enum StreamMode {
+    STREAM_ORPHAN,
+    STREAM_PERSISTENT
+};
+
+// Orphaning asks for fresh storage before each upload, the driver keeps the old one alive for the
+// draws still reading it and copies the new data in. The persistent ring (GL 4.4 / ARB_buffer_storage)
+// stays mapped for good and is written into directly, one of three regions per frame; a fence per region
+// makes sure the GPU is done with it before it is written again, which with three regions should never
+// wait. Either way the data lands at the offset Upload returns.
+class StreamBuffer {
+public:
+    static const int REGIONS = 3;
+
+    static bool PersistentSupported() {
+        return glExtensions().bufferStorage;
+    }
+
+    explicit StreamBuffer(const std::string& name) : m_Name(name) {
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    ~StreamBuffer() {
+        Release();
+    }
+
+    // needs the context current, call before it goes away
+    void Release() {
+        for (GLsync& fence : m_Fences) {
+            if (fence) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+        if (m_Mapped) {
+            glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            m_Mapped = nullptr;
+        }
+        glDeleteBuffers(1, &m_Buffer);
+        m_Buffer = 0;
+        m_Capacity = 0;
+        m_Region = -1;
+    }
+
+    // copies bytes in for this frame's draws and returns where they start in Buffer(); a mode the driver
+    // doesn't support falls back to orphaning
+    GLintptr Upload(const void* data, GLsizeiptr bytes, StreamMode mode) {
+        if (mode == STREAM_PERSISTENT && !PersistentSupported()) {
+            mode = STREAM_ORPHAN;
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (m_Buffer == 0 || mode != m_Mode || bytes > m_Capacity) {
+            allocate(std::max(bytes, m_Capacity), mode);
+        }
+        GLintptr offset = 0;
+        if (m_Mode == STREAM_ORPHAN) {
+            glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+            glBufferData(GL_ARRAY_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        } else {
+            // every draw of the last region has been issued by now
+            if (m_Region >= 0) {
+                m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+            m_Region = (m_Region + 1) % REGIONS;
+            if (GLsync fence = m_Fences[m_Region]) {
+                // only flush when the region is actually still in use, some drivers finish the frame on a flush
+                GLenum status = glClientWaitSync(fence, 0, 0);
+                if (status == GL_TIMEOUT_EXPIRED) {
+                    m_Waits++;
+                    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+                }
+                if (status == GL_TIMEOUT_EXPIRED) {
+                    std::cout << "[StreamBuffer] " << m_Name << " waited a second for the GPU" << std::endl;
+                }
+                glDeleteSync(fence);
+                m_Fences[m_Region] = nullptr;
+            }
+            offset = m_Region * m_Capacity;
+            std::memcpy(m_Mapped + offset, data, bytes);
+        }
+        m_Bytes += bytes;
+        m_Seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return offset;
+    }
+
+    // changes when the buffer is reallocated, vertex arrays point at it per upload
+    unsigned int Buffer() const {
+        return m_Buffer;
+    }
+
+    StreamMode Mode() const {
+        return m_Mode;
+    }
+
+    // bytes uploaded and the CPU time it took since the last ResetStats
+    double UploadedBytes() const {
+        return m_Bytes;
+    }
+
+    double UploadSeconds() const {
+        return m_Seconds;
+    }
+
+    // regions the GPU still had to be waited for, more than none means the ring is too short
+    int Waits() const {
+        return m_Waits;
+    }
+
+    void ResetStats() {
+        m_Bytes = m_Seconds = 0.0;
+        m_Waits = 0;
+    }
+
+private:
+    std::string m_Name;
+    unsigned int m_Buffer = 0;
+    StreamMode m_Mode = STREAM_ORPHAN;
+    GLsizeiptr m_Capacity = 0;
+    char* m_Mapped = nullptr;
+    GLsync m_Fences[REGIONS] = {};
+    int m_Region = -1;
+    double m_Bytes = 0.0;
+    double m_Seconds = 0.0;
+    int m_Waits = 0;
+
+    void allocate(GLsizeiptr bytes, StreamMode mode) {
+        Release();
+        // regions start at a multiple of any vertex size
+        m_Capacity = (std::max<GLsizeiptr>(bytes, 1) + 255) / 256 * 256;
+        m_Mode = mode;
+        glGenBuffers(1, &m_Buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+        if (mode == STREAM_ORPHAN) {
+            glBufferData(GL_ARRAY_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW);
+        } else {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glExtensions().BufferStorage(GL_ARRAY_BUFFER, REGIONS * m_Capacity, nullptr, flags);
+            m_Mapped = (char*) glMapBufferRange(GL_ARRAY_BUFFER, 0, REGIONS * m_Capacity, flags);
+            if (!m_Mapped) {
+                std::cout << "[StreamBuffer] " << m_Name << " can't be mapped, orphaning instead" << std::endl;
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                allocate(bytes, STREAM_ORPHAN);
+                return;
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        labelObject(GL_BUFFER, m_Buffer, m_Name);
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_STREAMBUFFER_H
@@ -0,0 +1,81 @@
+//
+// Procedural swimming: a wave running down a creature's body, bent in model.vs.
+//
+
+#ifndef PROJECT_BASE_SWIM_H
+#define PROJECT_BASE_SWIM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace rg {
+
+// location of the aSwim attribute in model.vs
+const unsigned int SWIM_ATTRIBUTE = 13;
+
+// How one creature swims, what its aSwim attribute holds. The wave barely moves the head and sways the
+// tail the most, all of it in the vertex shader from the time uniform, so a swimming creature costs the
+// CPU nothing per frame beyond this attribute.
+struct SwimMotion {
+    // sideways sway of the tail, in body lengths; 0 keeps the body still
+    float amplitude = 0.0f;
+    // tail beats per second
+    float frequency = 0.0f;
+    // radians
+    float phase = 0.0f;
+    // wavelengths along the body, 0 sways all of it in step
+    float waves = 0.0f;
+
+    glm::vec4 Attribute() const {
+        return glm::vec4(amplitude, frequency, phase, waves);
+    }
+
+    // for single draws: the vertex arrays of models leave the attribute disabled, so every vertex reads
+    // the current value set here. Instanced draws enable it per instance instead.
+    void Set() const {
+        glVertexAttrib4f(SWIM_ATTRIBUTE, amplitude, frequency, phase, waves);
+    }
+};
+
+// Where the body lies in the model's own space: the axis from head to tail and the one it bends along,
+// both unit length. The body's extent along the spine comes from the model's bounds.
+struct SwimBody {
+    glm::vec3 spine = glm::vec3(0.0f);
+    glm::vec3 side = glm::vec3(0.0f);
+
+    // the uniforms are scaled so that all zeros (a body that was never set) bends nothing
+    void SetUniforms(Shader& shader, const Model& model) const {
+        float head = std::numeric_limits<float>::max();
+        float tail = -head;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 point((corner & 1) ? model.boundsMax.x : model.boundsMin.x,
+                            (corner & 2) ? model.boundsMax.y : model.boundsMin.y,
+                            (corner & 4) ? model.boundsMax.z : model.boundsMin.z);
+            head = std::min(head, glm::dot(point, spine));
+            tail = std::max(tail, glm::dot(point, spine));
+        }
+        float length = tail - head;
+        if (model.meshes.empty() || length <= 0.0f || glm::dot(spine, spine) == 0.0f) {
+            Disable(shader);
+            return;
+        }
+        shader.setVec3("swimSpine", spine / length);
+        shader.setFloat("swimHead", head / length);
+        shader.setVec3("swimSide", side * length);
+    }
+
+    static void Disable(Shader& shader) {
+        shader.setVec3("swimSpine", glm::vec3(0.0f));
+        shader.setFloat("swimHead", 0.0f);
+        shader.setVec3("swimSide", glm::vec3(0.0f));
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_SWIM_H
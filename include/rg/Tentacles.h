@@ -0,0 +1,270 @@
+//
+// Tentacles as chains of Verlet particles, stepped four tentacles at a time with SSE on worker threads.
+//
+
+#ifndef PROJECT_BASE_TENTACLES_H
+#define PROJECT_BASE_TENTACLES_H
+
+#include <glm/glm.hpp>
+#include <rg/WorkerPool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RG_TENTACLES_SSE 1
+#endif
+
+namespace rg {
+
+// Every tentacle hangs from an anchor the caller moves each step, its other particles follow by
+// Verlet integration under what is left of gravity in water, drag and a slowly turning current, and
+// distance constraints keep their spacing. A particle keeps only its position and the one of the step
+// before; the difference is its velocity, and rendering interpolates between the two.
+//
+// Positions are stored by particle, then by tentacle, so the same particle of four neighbouring
+// tentacles is one SSE register. A batch of four tentacles runs the integration and the constraints,
+// which along a chain depend on each other, without a shuffle, and batches share nothing, so they are
+// spread over the worker pool.
+class TentacleSimulation {
+public:
+    glm::vec3 Gravity = glm::vec3(0.0f, -0.6f, 0.0f);
+    // fraction of the velocity lost per second
+    float Drag = 1.5f;
+    // acceleration of the current at the tips, it fades out towards the anchors
+    float Current = 1.2f;
+    int Iterations = 4;
+
+    // particles hang straight down from the anchors, one tentacle per anchor
+    void Reset(const std::vector<glm::vec3>& anchors, int particles, float segmentLength) {
+        m_Tentacles = (int) anchors.size();
+        m_Particles = std::max(particles, 2);
+        m_Stride = (m_Tentacles + 3) / 4 * 4;
+        m_SegmentLength = segmentLength;
+        size_t size = (size_t) m_Particles * m_Stride;
+        for (std::vector<float>* values : {&m_X, &m_Y, &m_Z, &m_PrevX, &m_PrevY, &m_PrevZ}) {
+            values->assign(size, 0.0f);
+        }
+        m_Phase.resize(m_Stride);
+        for (int lane = 0; lane < m_Stride; lane++) {
+            m_Phase[lane] = 2.3999632f * lane; // golden angle, neighbours sway apart
+        }
+        setAnchors(anchors);
+        for (int particle = 0; particle < m_Particles; particle++) {
+            for (int lane = 0; lane < m_Stride; lane++) {
+                size_t i = (size_t) particle * m_Stride + lane;
+                m_X[i] = m_PrevX[i] = m_X[lane];
+                m_Y[i] = m_PrevY[i] = m_Y[lane] - particle * segmentLength;
+                m_Z[i] = m_PrevZ[i] = m_Z[lane];
+            }
+        }
+    }
+
+    // one step of dt seconds, anchors are where the roots are at its end
+    void Step(float dt, float time, const std::vector<glm::vec3>& anchors, WorkerPool& pool) {
+        if (m_Tentacles == 0) {
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int lane = 0; lane < m_Stride; lane++) {
+            m_PrevX[lane] = m_X[lane];
+            m_PrevY[lane] = m_Y[lane];
+            m_PrevZ[lane] = m_Z[lane];
+        }
+        setAnchors(anchors);
+        // a few batches per range keeps the counter traffic down
+        pool.ParallelFor(m_Stride / 4, 8, [this, dt, time](int begin, int end) {
+            for (int batch = begin; batch < end; batch++) {
+                stepBatch(batch * 4, dt, time);
+            }
+        });
+        m_StepSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        m_ParticleSteps += (double) m_Tentacles * m_Particles;
+    }
+
+    // every tentacle as a strip of its particles, between the previous and the last step alpha of the way;
+    // w is how far along the tentacle the particle is, from 0 at the anchor to 1 at the tip
+    void Interpolate(float alpha, std::vector<glm::vec4>& vertices, WorkerPool& pool) const {
+        vertices.resize((size_t) m_Tentacles * m_Particles);
+        pool.ParallelFor(m_Tentacles, 64, [this, alpha, &vertices](int begin, int end) {
+            float last = 1.0f / (m_Particles - 1);
+            for (int tentacle = begin; tentacle < end; tentacle++) {
+                glm::vec4* strip = &vertices[(size_t) tentacle * m_Particles];
+                for (int particle = 0; particle < m_Particles; particle++) {
+                    size_t i = (size_t) particle * m_Stride + tentacle;
+                    strip[particle] = glm::vec4(m_PrevX[i] + (m_X[i] - m_PrevX[i]) * alpha,
+                                                m_PrevY[i] + (m_Y[i] - m_PrevY[i]) * alpha,
+                                                m_PrevZ[i] + (m_Z[i] - m_PrevZ[i]) * alpha, particle * last);
+                }
+            }
+        });
+    }
+
+    int Tentacles() const {
+        return m_Tentacles;
+    }
+
+    int ParticlesPerTentacle() const {
+        return m_Particles;
+    }
+
+    int Particles() const {
+        return m_Tentacles * m_Particles;
+    }
+
+    // particle steps and the wall clock time the steps took since the last ResetStats
+    double ParticleSteps() const {
+        return m_ParticleSteps;
+    }
+
+    double StepSeconds() const {
+        return m_StepSeconds;
+    }
+
+    void ResetStats() {
+        m_ParticleSteps = m_StepSeconds = 0.0;
+    }
+
+private:
+    int m_Tentacles = 0;
+    int m_Particles = 0;
+    // tentacles rounded up to whole batches, the padding lanes copy the last tentacle
+    int m_Stride = 0;
+    float m_SegmentLength = 0.0f;
+    std::vector<float> m_X, m_Y, m_Z;
+    std::vector<float> m_PrevX, m_PrevY, m_PrevZ;
+    std::vector<float> m_Phase;
+    double m_ParticleSteps = 0.0;
+    double m_StepSeconds = 0.0;
+
+    // the roots are particle 0 and only ever sit on their anchors
+    void setAnchors(const std::vector<glm::vec3>& anchors) {
+        for (int lane = 0; lane < m_Stride; lane++) {
+            const glm::vec3& anchor = anchors[std::min(lane, m_Tentacles - 1)];
+            m_X[lane] = anchor.x;
+            m_Y[lane] = anchor.y;
+            m_Z[lane] = anchor.z;
+        }
+    }
+
+    void stepBatch(int lane, float dt, float time) {
+        const size_t stride = m_Stride;
+        float damping = std::max(1.0f - Drag * dt, 0.0f);
+        float dt2 = dt * dt;
+        // the current turns slowly and swells and ebbs, differently for every tentacle
+        float currentX[4], currentZ[4];
+        for (int k = 0; k < 4; k++) {
+            float phase = m_Phase[lane + k];
+            float strength = Current * std::sin(1.3f * time + 2.0f * phase) * dt2;
+            currentX[k] = std::cos(0.4f * time + phase) * strength;
+            currentZ[k] = std::sin(0.4f * time + phase) * strength;
+        }
+        float* x = &m_X[lane];
+        float* y = &m_Y[lane];
+        float* z = &m_Z[lane];
+        float* prevX = &m_PrevX[lane];
+        float* prevY = &m_PrevY[lane];
+        float* prevZ = &m_PrevZ[lane];
+        float tipward = 1.0f / (m_Particles - 1);
+#ifdef RG_TENTACLES_SSE
+        __m128 keep = _mm_set1_ps(damping);
+        __m128 gravityX = _mm_set1_ps(Gravity.x * dt2);
+        __m128 gravityY = _mm_set1_ps(Gravity.y * dt2);
+        __m128 gravityZ = _mm_set1_ps(Gravity.z * dt2);
+        __m128 flowX = _mm_loadu_ps(currentX);
+        __m128 flowZ = _mm_loadu_ps(currentZ);
+        for (int particle = 1; particle < m_Particles; particle++) {
+            size_t i = particle * stride;
+            __m128 along = _mm_set1_ps(particle * tipward);
+            __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+            __m128 nx = _mm_add_ps(px, _mm_mul_ps(_mm_sub_ps(px, _mm_loadu_ps(prevX + i)), keep));
+            __m128 ny = _mm_add_ps(py, _mm_mul_ps(_mm_sub_ps(py, _mm_loadu_ps(prevY + i)), keep));
+            __m128 nz = _mm_add_ps(pz, _mm_mul_ps(_mm_sub_ps(pz, _mm_loadu_ps(prevZ + i)), keep));
+            nx = _mm_add_ps(nx, _mm_add_ps(gravityX, _mm_mul_ps(flowX, along)));
+            ny = _mm_add_ps(ny, gravityY);
+            nz = _mm_add_ps(nz, _mm_add_ps(gravityZ, _mm_mul_ps(flowZ, along)));
+            _mm_storeu_ps(prevX + i, px);
+            _mm_storeu_ps(prevY + i, py);
+            _mm_storeu_ps(prevZ + i, pz);
+            _mm_storeu_ps(x + i, nx);
+            _mm_storeu_ps(y + i, ny);
+            _mm_storeu_ps(z + i, nz);
+        }
+        __m128 rest = _mm_set1_ps(m_SegmentLength);
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128 tiny = _mm_set1_ps(1e-12f);
+        for (int iteration = 0; iteration < Iterations; iteration++) {
+            __m128 ax = _mm_loadu_ps(x), ay = _mm_loadu_ps(y), az = _mm_loadu_ps(z);
+            for (int particle = 1; particle < m_Particles; particle++) {
+                size_t i = particle * stride;
+                __m128 bx = _mm_loadu_ps(x + i), by = _mm_loadu_ps(y + i), bz = _mm_loadu_ps(z + i);
+                __m128 dx = _mm_sub_ps(bx, ax), dy = _mm_sub_ps(by, ay), dz = _mm_sub_ps(bz, az);
+                __m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                __m128 length = _mm_sqrt_ps(_mm_max_ps(squared, tiny));
+                __m128 error = _mm_div_ps(_mm_sub_ps(length, rest), length);
+                if (particle == 1) {
+                    // the root doesn't move, the whole correction goes to its neighbour
+                    bx = _mm_sub_ps(bx, _mm_mul_ps(dx, error));
+                    by = _mm_sub_ps(by, _mm_mul_ps(dy, error));
+                    bz = _mm_sub_ps(bz, _mm_mul_ps(dz, error));
+                } else {
+                    error = _mm_mul_ps(error, half);
+                    _mm_storeu_ps(x + i - stride, _mm_add_ps(ax, _mm_mul_ps(dx, error)));
+                    _mm_storeu_ps(y + i - stride, _mm_add_ps(ay, _mm_mul_ps(dy, error)));
+                    _mm_storeu_ps(z + i - stride, _mm_add_ps(az, _mm_mul_ps(dz, error)));
+                    bx = _mm_sub_ps(bx, _mm_mul_ps(dx, error));
+                    by = _mm_sub_ps(by, _mm_mul_ps(dy, error));
+                    bz = _mm_sub_ps(bz, _mm_mul_ps(dz, error));
+                }
+                _mm_storeu_ps(x + i, bx);
+                _mm_storeu_ps(y + i, by);
+                _mm_storeu_ps(z + i, bz);
+                ax = bx;
+                ay = by;
+                az = bz;
+            }
+        }
+#else
+        for (int particle = 1; particle < m_Particles; particle++) {
+            size_t i = particle * stride;
+            float along = particle * tipward;
+            for (int k = 0; k < 4; k++) {
+                float px = x[i + k], py = y[i + k], pz = z[i + k];
+                x[i + k] = px + (px - prevX[i + k]) * damping + Gravity.x * dt2 + currentX[k] * along;
+                y[i + k] = py + (py - prevY[i + k]) * damping + Gravity.y * dt2;
+                z[i + k] = pz + (pz - prevZ[i + k]) * damping + Gravity.z * dt2 + currentZ[k] * along;
+                prevX[i + k] = px;
+                prevY[i + k] = py;
+                prevZ[i + k] = pz;
+            }
+        }
+        for (int iteration = 0; iteration < Iterations; iteration++) {
+            for (int particle = 1; particle < m_Particles; particle++) {
+                size_t i = particle * stride;
+                for (int k = 0; k < 4; k++) {
+                    size_t a = i - stride + k, b = i + k;
+                    float dx = x[b] - x[a], dy = y[b] - y[a], dz = z[b] - z[a];
+                    float length = std::sqrt(std::max(dx * dx + dy * dy + dz * dz, 1e-12f));
+                    float error = (length - m_SegmentLength) / length;
+                    if (particle > 1) {
+                        error *= 0.5f;
+                        x[a] += dx * error;
+                        y[a] += dy * error;
+                        z[a] += dz * error;
+                    }
+                    x[b] -= dx * error;
+                    y[b] -= dy * error;
+                    z[b] -= dz * error;
+                }
+            }
+        }
+#endif
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_TENTACLES_H
@@ -0,0 +1,284 @@
+//
+// Streams the finer mip levels of model texture arrays in and out under a memory budget.
+//
+
+#ifndef PROJECT_BASE_TEXTURESTREAMER_H
+#define PROJECT_BASE_TEXTURESTREAMER_H
+
+#include <glad/glad.h>
+#include <learnopengl/model.h>
+#include <rg/AssetLoader.h>
+#include <rg/MipChain.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace rg {
+
+// Models are uploaded with their mip tail only (see Model::Upload). Every frame each drawn model
+// reports how large it is on screen; from that and the texture size the streamer derives the finest
+// level worth having, assuming the texture is spread roughly once over the object. Missing levels
+// are decoded and uploaded on the loader thread, largest objects first, all levels an array misses in
+// one job since every one of them takes decoding the whole image, and become visible by lowering
+// GL_TEXTURE_BASE_LEVEL once the upload is complete. Every loaded model counts against the budget from
+// the moment it is tracked, drawn or not. Levels are only dropped when new ones wouldn't fit into the
+// budget: first those finer than currently wanted, which includes every level above the tail of a
+// model not drawn, then the finest levels of objects smaller on screen, never below the tail. Baked
+// vertex animations count against the budget as well but are never evicted.
+class TextureStreamer {
+public:
+    std::size_t BudgetBytes;
+    // added to the wanted level, positive values trade sharpness for memory
+    int LevelBias = 0;
+    // stream-in jobs allowed on the loader thread at once
+    int MaxInFlight = 2;
+
+    TextureStreamer(AssetLoader& loader, std::size_t budgetBytes)
+            : BudgetBytes(budgetBytes), m_Loader(loader) {
+    }
+
+    // render thread, once a model is loaded: its levels count against the budget from now on, and so
+    // does its baked vertex animation, which is never streamed and only goes with the model
+    void Track(Model& model) {
+        for (TextureArray& array : model.textureArrays) {
+            entryFor(array);
+        }
+        if (model.vertexAnimation.Bytes() > 0 && m_Animations.find(&model) == m_Animations.end()) {
+            m_Animations[&model] = model.vertexAnimation.Bytes();
+            m_ResidentBytes += model.vertexAnimation.Bytes();
+        }
+    }
+
+    // render thread, for every drawn model; screenSize as returned by projectedScreenSize
+    void Request(Model& model, float screenSize) {
+        if (!model.Ready()) {
+            return;
+        }
+        for (TextureArray& array : model.textureArrays) {
+            Entry& entry = entryFor(array);
+            int size = std::max(array.width, array.height);
+            int wanted = (int) std::floor(std::log2(size / std::max(2.0f * screenSize, 1.0f))) + LevelBias;
+            wanted = std::max(0, std::min(wanted, tailLevel(array)));
+            if (entry.frame != m_Frame) {
+                entry.frame = m_Frame;
+                entry.wanted = wanted;
+                entry.footprint = screenSize;
+            } else {
+                entry.wanted = std::min(entry.wanted, wanted);
+                entry.footprint = std::max(entry.footprint, screenSize);
+            }
+        }
+    }
+
+    // render thread, once per frame after all requests
+    void Update() {
+        for (Entry& entry : m_Entries) {
+            if (entry.frame != m_Frame) {
+                // not drawn this frame, only the tail is needed
+                entry.wanted = tailLevel(*entry.array);
+                entry.footprint = 0.0f;
+            }
+        }
+
+        // largest objects get their levels first
+        std::vector<Entry*> byFootprint;
+        for (Entry& entry : m_Entries) {
+            byFootprint.push_back(&entry);
+        }
+        std::sort(byFootprint.begin(), byFootprint.end(),
+                  [](const Entry* a, const Entry* b) { return a->footprint > b->footprint; });
+
+        // levels stay resident until memory is needed, e.g. after the budget was lowered
+        makeRoom(0, std::numeric_limits<float>::max());
+
+        for (Entry* entry : byFootprint) {
+            if (m_InFlight >= MaxInFlight) {
+                break;
+            }
+            if (entry->streaming || entry->wanted >= entry->array->residentLevel) {
+                continue;
+            }
+            // every missing level that fits, coarsest first, from a single decode
+            int resident = entry->array->residentLevel, first = resident;
+            std::size_t bytes = 0;
+            for (int level = resident - 1; level >= entry->wanted; --level) {
+                std::size_t more = bytes + levelBytes(*entry->array, level);
+                if (!makeRoom(more, entry->footprint)) {
+                    break;
+                }
+                bytes = more;
+                first = level;
+            }
+            if (first < resident) {
+                streamIn(*entry, first, resident - 1, bytes);
+            }
+        }
+        m_Frame++;
+    }
+
+    // true while one of the model's levels is being uploaded, it must not be released then
+    bool Streaming(const Model& model) const {
+        for (const Entry& entry : m_Entries) {
+            if (entry.streaming && isArrayOf(model, entry.array)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // stops tracking a model that is about to be released
+    void Forget(const Model& model) {
+        auto animation = m_Animations.find(&model);
+        if (animation != m_Animations.end()) {
+            m_ResidentBytes -= animation->second;
+            m_Animations.erase(animation);
+        }
+        for (unsigned int i = 0; i < m_Entries.size();) {
+            TextureArray& array = *m_Entries[i].array;
+            if (!isArrayOf(model, &array)) {
+                ++i;
+                continue;
+            }
+            for (int level = array.residentLevel; level < array.levels; ++level) {
+                m_ResidentBytes -= levelBytes(array, level);
+            }
+            m_Entries.erase(m_Entries.begin() + i);
+        }
+    }
+
+    std::size_t ResidentBytes() const {
+        return m_ResidentBytes;
+    }
+
+    void PrintReport() const {
+        std::cout << "[TextureStreamer] " << m_ResidentBytes / (1024 * 1024) << " MB resident of "
+                  << BudgetBytes / (1024 * 1024) << " MB budget, " << m_StreamedLevels << " levels streamed in, "
+                  << m_EvictedLevels << " evicted" << std::endl;
+    }
+
+private:
+    struct Entry {
+        TextureArray* array;
+        int wanted;
+        float footprint;
+        int frame;
+        bool streaming;
+    };
+
+    AssetLoader& m_Loader;
+    std::vector<Entry> m_Entries;
+    // bytes of the tracked models' baked vertex animations
+    std::map<const Model*, std::size_t> m_Animations;
+    int m_Frame = 0;
+    int m_InFlight = 0;
+    std::size_t m_ResidentBytes = 0;
+    int m_StreamedLevels = 0;
+    int m_EvictedLevels = 0;
+
+    static int tailLevel(const TextureArray& array) {
+        return std::min(mipTailLevel(array.width, array.height), array.levels - 1);
+    }
+
+    static bool isArrayOf(const Model& model, const TextureArray* array) {
+        return !model.textureArrays.empty() && array >= model.textureArrays.data() &&
+               array < model.textureArrays.data() + model.textureArrays.size();
+    }
+
+    static std::size_t levelBytes(const TextureArray& array, int level) {
+        return mipLevelBytes(array.width, array.height, (int) array.files.size(), array.nrComponents, level);
+    }
+
+    Entry& entryFor(TextureArray& array) {
+        for (Entry& entry : m_Entries) {
+            if (entry.array == &array) {
+                return entry;
+            }
+        }
+        // first time the array is seen, account for the levels the model was uploaded with
+        for (int level = array.residentLevel; level < array.levels; ++level) {
+            m_ResidentBytes += levelBytes(array, level);
+        }
+        m_Entries.push_back({&array, tailLevel(array), 0.0f, -1, false});
+        return m_Entries.back();
+    }
+
+    // evicts until bytes more fit into the budget: first levels finer than their object currently
+    // wants, then the finest levels of objects smaller on screen than footprint
+    bool makeRoom(std::size_t bytes, float footprint) {
+        while (m_ResidentBytes + bytes > BudgetBytes) {
+            Entry* victim = nullptr;
+            bool victimUnwanted = false;
+            for (Entry& entry : m_Entries) {
+                if (entry.streaming || entry.array->residentLevel >= tailLevel(*entry.array)) {
+                    continue;
+                }
+                bool unwanted = entry.array->residentLevel < entry.wanted;
+                if (!unwanted && entry.footprint >= footprint) {
+                    continue;
+                }
+                if (!victim || (unwanted && !victimUnwanted) ||
+                    (unwanted == victimUnwanted && entry.footprint < victim->footprint)) {
+                    victim = &entry;
+                    victimUnwanted = unwanted;
+                }
+            }
+            if (!victim) {
+                return false;
+            }
+            evictFinestLevel(*victim);
+        }
+        return true;
+    }
+
+    void evictFinestLevel(Entry& entry) {
+        TextureArray& array = *entry.array;
+        int level = array.residentLevel;
+        if (level >= tailLevel(array)) {
+            return;
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.id);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level + 1);
+        // respecifying the level as empty releases its storage, it is outside the base..max range now
+        GLenum format, internalFormat;
+        textureFormat(array.nrComponents, format, internalFormat);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, 0, 0, 0, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        array.residentLevel = level + 1;
+        m_ResidentBytes -= levelBytes(array, level);
+        m_EvictedLevels++;
+    }
+
+    void streamIn(Entry& entry, int level, int lastLevel, std::size_t bytes) {
+        TextureArray& array = *entry.array;
+        entry.streaming = true;
+        m_InFlight++;
+        // counted right away so that jobs in flight can't overshoot the budget together
+        m_ResidentBytes += bytes;
+        // the loader only writes levels outside base..max, the render thread moves the base once they're complete
+        unsigned int id = array.id;
+        std::vector<std::string> files = array.files;
+        int width = array.width, height = array.height, channels = array.nrComponents;
+        m_Loader.Submit([id, files, width, height, channels, level, lastLevel]() {
+                            stbi_set_flip_vertically_on_load(false);
+                            uploadMipLevels(id, files, width, height, channels, level, lastLevel);
+                        },
+                        [this, &array, level, lastLevel]() {
+                            glBindTexture(GL_TEXTURE_2D_ARRAY, array.id);
+                            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+                            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+                            array.residentLevel = level;
+                            m_StreamedLevels += lastLevel - level + 1;
+                            m_InFlight--;
+                            entryFor(array).streaming = false;
+                        });
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_TEXTURESTREAMER_H
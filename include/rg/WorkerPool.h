@@ -0,0 +1,124 @@
+//
+// Threads that split loops over many independent items with the thread that calls them.
+//
+
+#ifndef PROJECT_BASE_WORKERPOOL_H
+#define PROJECT_BASE_WORKERPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+// The threads are started once and sleep between loops. A loop hands out ranges of Grain items from an
+// atomic counter, so faster threads take more of them, and the calling thread works on it as well
+// instead of waiting; ParallelFor returns once every range is done. Loops are meant to be issued from
+// one thread at a time.
+class WorkerPool {
+public:
+    // one thread per core besides the caller, at least none
+    static int DefaultWorkers() {
+        return std::max((int) std::thread::hardware_concurrency() - 1, 0);
+    }
+
+    explicit WorkerPool(int workers = DefaultWorkers()) {
+        for (int i = 0; i < workers; i++) {
+            m_Workers.emplace_back(&WorkerPool::run, this);
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_Wake.notify_all();
+        for (std::thread& worker : m_Workers) {
+            worker.join();
+        }
+    }
+
+    // threads working on a loop, the caller included
+    int Threads() const {
+        return (int) m_Workers.size() + 1;
+    }
+
+    // calls body(begin, end) for ranges covering [0, count), at most grain items each
+    void ParallelFor(int count, int grain, const std::function<void(int, int)>& body) {
+        grain = std::max(grain, 1);
+        if (m_Workers.empty() || count <= grain) {
+            if (count > 0) {
+                body(0, count);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Body = &body;
+            m_Count = count;
+            m_Grain = grain;
+            m_Next = 0;
+            m_Busy = (int) m_Workers.size();
+            m_Generation++;
+        }
+        m_Wake.notify_all();
+        work();
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Done.wait(lock, [this]() { return m_Busy == 0; });
+        m_Body = nullptr;
+    }
+
+private:
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::condition_variable m_Done;
+    const std::function<void(int, int)>* m_Body = nullptr;
+    int m_Count = 0;
+    int m_Grain = 1;
+    std::atomic<int> m_Next{0};
+    int m_Busy = 0;
+    unsigned int m_Generation = 0;
+    bool m_Stop = false;
+
+    void work() {
+        for (;;) {
+            int begin = m_Next.fetch_add(m_Grain);
+            if (begin >= m_Count) {
+                return;
+            }
+            (*m_Body)(begin, std::min(begin + m_Grain, m_Count));
+        }
+    }
+
+    void run() {
+        unsigned int generation = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Wake.wait(lock, [this, generation]() { return m_Stop || m_Generation != generation; });
+                if (m_Stop) {
+                    return;
+                }
+                generation = m_Generation;
+            }
+            work();
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (--m_Busy == 0) {
+                m_Done.notify_one();
+            }
+        }
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_WORKERPOOL_H
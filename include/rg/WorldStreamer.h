@@ -0,0 +1,239 @@
+//
+// Grid of world cells whose models are loaded and released as the camera moves.
+//
+
+#ifndef PROJECT_BASE_WORLDSTREAMER_H
+#define PROJECT_BASE_WORLDSTREAMER_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/model.h>
+#include <rg/AssetLoader.h>
+#include <rg/TextureStreamer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+// The XZ plane is cut into square cells and every object is filed under the cell its anchor is in.
+// Each frame the distance from the camera to every cell is measured, and also from where the
+// camera will be PrefetchSeconds from now at its current velocity, whichever is smaller.
+// Objects of cells within LoadRadius are loaded on the loader thread, those that were on screen
+// at the last shutdown first, then by distance to the camera, and released
+// once their cell is beyond UnloadRadius. At most MaxLoadedObjects are resident or loading at once,
+// so memory doesn't grow with the size of the level, only with how much of it is close by.
+class WorldStreamer {
+public:
+    float CellSize = 32.0f;
+    float LoadRadius = 120.0f;
+    // larger than LoadRadius so a camera moving along a cell border doesn't reload the same models
+    float UnloadRadius = 150.0f;
+    float PrefetchSeconds = 2.0f;
+    int MaxLoadedObjects = 16;
+    float VisibilityRadius = 5.0f;
+
+    WorldStreamer(AssetLoader& loader, TextureStreamer& textureStreamer)
+            : m_Loader(loader), m_TextureStreamer(textureStreamer) {
+    }
+
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+    // render thread, the loader has to be stopped first so no job still writes into a model
+    ~WorldStreamer() {
+        for (Object& object : m_Objects) {
+            if (object.model) {
+                object.model->Release();
+            }
+        }
+    }
+
+    // registers an object to be streamed, anchor is the world position it is drawn around; returns its handle.
+    // prepare runs on the loader thread after every load, before the model is uploaded, for data made from
+    // the imported meshes.
+    int Add(const std::string& path, glm::vec3 anchor, std::function<void(Model&)> prepare = nullptr) {
+        int handle = (int) m_Objects.size();
+        m_Objects.push_back({path, anchor, std::move(prepare), nullptr, UNLOADED, false, false});
+        m_Cells[cellOf(anchor)].push_back(handle);
+        return handle;
+    }
+
+    // the object's model is drawn in a crowd: it bakes its vertex animation on every load
+    void BakeAnimation(int handle) {
+        m_Objects[handle].bakeAnimation = true;
+    }
+
+    // the model of an object while it is loading (not Ready yet) or loaded, nullptr otherwise
+    Model* Get(int handle) {
+        return m_Objects[handle].model.get();
+    }
+
+    // render thread, once per frame before drawing
+    void Update(glm::vec3 cameraPosition, float deltaTime) {
+        if (m_HasLastPosition && deltaTime > 0.0f) {
+            glm::vec3 velocity = (cameraPosition - m_LastPosition) / deltaTime;
+            m_Velocity += 0.2f * (velocity - m_Velocity);
+        }
+        m_LastPosition = cameraPosition;
+        m_HasLastPosition = true;
+        glm::vec3 predicted = cameraPosition + m_Velocity * PrefetchSeconds;
+
+        // objects seen at the last shutdown sort before all others
+        std::vector<std::pair<float, int>> wanted;
+        for (auto& cell : m_Cells) {
+            float distance = std::min(distanceToCell(cell.first, cameraPosition), distanceToCell(cell.first, predicted));
+            for (int handle : cell.second) {
+                Object& object = m_Objects[handle];
+                if (distance > UnloadRadius && object.state == LOADED) {
+                    release(object);
+                } else if (distance <= LoadRadius && object.state == UNLOADED) {
+                    float priority = glm::length(object.anchor - cameraPosition);
+                    if (!object.visibleAtLastShutdown) {
+                        priority += 1.0e6f; // far past any load radius
+                    }
+                    wanted.push_back({priority, handle});
+                }
+            }
+        }
+
+        std::sort(wanted.begin(), wanted.end());
+        m_Waiting = false;
+        for (const std::pair<float, int>& candidate : wanted) {
+            if (m_Resident >= MaxLoadedObjects) {
+                m_Waiting = true;
+                break;
+            }
+            load(candidate.second);
+        }
+    }
+
+    // one '0'/'1' per object in the order they were added, as returned by VisibleObjects
+    void SetVisibleAtLastShutdown(const std::string& flags) {
+        for (unsigned int i = 0; i < m_Objects.size() && i < flags.size(); ++i) {
+            m_Objects[i].visibleAtLastShutdown = flags[i] == '1';
+        }
+    }
+
+    // which anchors lie inside the view frustum, give or take VisibilityRadius
+    std::string VisibleObjects(const glm::mat4& viewProjection) const {
+        std::string flags;
+        for (const Object& object : m_Objects) {
+            glm::vec4 clip = viewProjection * glm::vec4(object.anchor, 1.0f);
+            float w = clip.w + VisibilityRadius;
+            bool visible = clip.w > -VisibilityRadius && std::abs(clip.x) <= w && std::abs(clip.y) <= w &&
+                           std::abs(clip.z) <= w;
+            flags += visible ? '1' : '0';
+        }
+        return flags;
+    }
+
+    // true when every object within LoadRadius is loaded
+    bool Complete() const {
+        for (const Object& object : m_Objects) {
+            if (object.state == LOADING) {
+                return false;
+            }
+        }
+        return m_HasLastPosition && !m_Waiting;
+    }
+
+    int Resident() const {
+        return m_Resident;
+    }
+
+    void PrintReport() const {
+        std::cout << "[WorldStreamer] " << m_Cells.size() << " cells, " << m_Objects.size() << " objects, "
+                  << m_Resident << " resident, " << m_Loads << " loads, " << m_Releases << " releases" << std::endl;
+    }
+
+private:
+    enum State {
+        UNLOADED,
+        LOADING,
+        LOADED
+    };
+
+    struct Object {
+        std::string path;
+        glm::vec3 anchor;
+        std::function<void(Model&)> prepare;
+        std::unique_ptr<Model> model;
+        State state;
+        bool visibleAtLastShutdown;
+        bool bakeAnimation;
+    };
+
+    AssetLoader& m_Loader;
+    TextureStreamer& m_TextureStreamer;
+    std::vector<Object> m_Objects;
+    std::map<std::pair<int, int>, std::vector<int>> m_Cells;
+    glm::vec3 m_LastPosition = glm::vec3(0.0f);
+    glm::vec3 m_Velocity = glm::vec3(0.0f);
+    bool m_HasLastPosition = false;
+    bool m_Waiting = false;
+    int m_Resident = 0;
+    int m_Loads = 0;
+    int m_Releases = 0;
+
+    std::pair<int, int> cellOf(glm::vec3 position) const {
+        return {(int) std::floor(position.x / CellSize), (int) std::floor(position.z / CellSize)};
+    }
+
+    // distance in the XZ plane from a point to the square of a cell
+    float distanceToCell(std::pair<int, int> cell, glm::vec3 position) const {
+        float minX = cell.first * CellSize, minZ = cell.second * CellSize;
+        float dx = std::max(std::max(minX - position.x, position.x - (minX + CellSize)), 0.0f);
+        float dz = std::max(std::max(minZ - position.z, position.z - (minZ + CellSize)), 0.0f);
+        return std::sqrt(dx * dx + dz * dz);
+    }
+
+    void load(int handle) {
+        Object& object = m_Objects[handle];
+        object.model.reset(new Model());
+        object.model->bakeAnimation = object.bakeAnimation;
+        object.state = LOADING;
+        m_Resident++;
+        m_Loads++;
+        Model* model = object.model.get();
+        std::string path = object.path;
+        std::function<void(Model&)> prepare = object.prepare;
+        m_Loader.Submit([model, path, prepare]() {
+                            stbi_set_flip_vertically_on_load(false);
+                            model->Load(path);
+                            if (prepare && !model->meshes.empty()) {
+                                prepare(*model);
+                            }
+                            model->Upload(true);
+                        },
+                        [this, model, handle]() {
+                            model->CreateVertexArray();
+                            model->SetShaderTextureNamePrefix("material.");
+                            m_TextureStreamer.Track(*model);
+                            m_Objects[handle].state = LOADED;
+                        });
+    }
+
+    void release(Object& object) {
+        // a mip level on its way in still writes into the model's textures, try again next frame
+        if (m_TextureStreamer.Streaming(*object.model)) {
+            return;
+        }
+        m_TextureStreamer.Forget(*object.model);
+        object.model->Release();
+        object.model.reset();
+        object.state = UNLOADED;
+        m_Resident--;
+        m_Releases++;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_WORLDSTREAMER_H
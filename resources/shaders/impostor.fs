@@ -0,0 +1,135 @@
+#version 330 core
+out vec4 FragColor;
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct Material {
+    float shininess;
+};
+
+in vec3 FragPos;
+in vec2 FrameCoords[3];
+flat in vec2 FrameCells[3];
+flat in vec3 FrameWeights;
+flat in vec3 DepthAxis;
+flat in mat3 NormalMatrix;
+
+#define NUM_OF_POINT_LIGHTS (2)
+
+uniform PointLight pointLights[NUM_OF_POINT_LIGHTS];
+uniform DirLight dirLight;
+uniform SpotLight spotLight;
+
+uniform Material material;
+
+uniform vec3 viewPosition;
+uniform mat4 view;
+uniform mat4 projection;
+
+// premultiplied by coverage: albedo, and the model space normal with the height above the view's plane
+uniform sampler2D impostorAlbedo;
+uniform sampler2D impostorNormals;
+uniform int impostorFrames;
+
+// as the crowds' mid-distance shading, a flat specular intensity
+#define SPECULAR_SAMPLE vec3(0.5)
+
+vec3 CalcPointLight(PointLight light, vec3 albedo, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    return (light.ambient * albedo + light.diffuse * diff * albedo + light.specular * spec * SPECULAR_SAMPLE) * attenuation;
+}
+
+vec3 CalcDirLight(DirLight light, vec3 albedo, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    return light.ambient * albedo + light.diffuse * diff * albedo + light.specular * spec * SPECULAR_SAMPLE;
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 albedo, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    return (light.ambient * albedo + light.diffuse * diff * albedo + light.specular * spec * SPECULAR_SAMPLE)
+           * attenuation * intensity;
+}
+
+void main()
+{
+    vec4 albedo = vec4(0.0);
+    vec4 normalHeight = vec4(0.0);
+    for (int k = 0; k < 3; k++) {
+        vec2 coordinates = FrameCoords[k];
+        // past the edge of its cell a view has nothing of the model, rather than a neighbour's
+        vec2 inside = step(vec2(0.0), coordinates) * step(coordinates, vec2(1.0));
+        float weight = FrameWeights[k] * inside.x * inside.y;
+        vec2 atlas = (FrameCells[k] + clamp(coordinates, 0.0, 1.0)) / float(impostorFrames);
+        albedo += weight * texture(impostorAlbedo, atlas);
+        normalHeight += weight * texture(impostorNormals, atlas);
+    }
+    if (albedo.a < 0.5) {
+        discard;
+    }
+    vec3 diffuse = albedo.rgb / albedo.a;
+    vec3 normal = normalize(NormalMatrix * normalHeight.xyz);
+    // the surface in front of or behind the quad, lit and depth tested where it is
+    vec3 fragPos = FragPos + DepthAxis * (normalHeight.w / albedo.a);
+    vec3 viewDir = normalize(viewPosition - fragPos);
+
+    vec3 result = CalcDirLight(dirLight, diffuse, normal, viewDir);
+    result += CalcPointLight(pointLights[0], diffuse, normal, fragPos, viewDir);
+    result += CalcPointLight(pointLights[1], diffuse, normal, fragPos, viewDir);
+    result += CalcSpotLight(spotLight, diffuse, normal, fragPos, viewDir);
+    FragColor = vec4(result, 1.0);
+
+    vec4 clip = projection * view * vec4(fragPos, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+}
@@ -0,0 +1,101 @@
+#version 330 core
+// the corner of the quad, -1 to 1 on both axes
+layout (location = 0) in vec2 aCorner;
+// per instance, like the crowd's model program
+layout (location = 8) in mat4 aInstanceModel;
+
+out vec3 FragPos;
+// where the fragment falls in each of the three views blended, 0 to 1 across the view's cell
+out vec2 FrameCoords[3];
+flat out vec2 FrameCells[3];
+flat out vec3 FrameWeights;
+// from the center of the model to its surface at height 1 in the atlas, in world space
+flat out vec3 DepthAxis;
+flat out mat3 NormalMatrix;
+
+// orients the model's mesh, as for the crowd's model program
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPosition;
+
+uniform vec3 impostorCenter;
+uniform float impostorRadius;
+uniform int impostorFrames;
+
+// the octahedral map of the sphere onto the unit square, z at its center; the same as Impostor::FrameDirection
+vec2 octahedralCoordinates(vec3 direction)
+{
+    vec3 d = direction / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+    vec2 p = d.xy;
+    if (d.z < 0.0) {
+        p = (1.0 - abs(d.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return p * 0.5 + 0.5;
+}
+
+vec3 octahedralDirection(vec2 coordinates)
+{
+    vec2 p = coordinates * 2.0 - 1.0;
+    vec3 d = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (d.z < 0.0) {
+        d.xy = (1.0 - abs(d.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(d);
+}
+
+// the right and up of a view looking back along direction; the same as Impostor::FrameBasis
+void frameBasis(vec3 direction, out vec3 right, out vec3 up)
+{
+    vec3 worldUp = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    right = normalize(cross(worldUp, direction));
+    up = cross(direction, right);
+}
+
+void main()
+{
+    mat4 instanceModel = aInstanceModel * model;
+    vec3 worldCenter = vec3(instanceModel * vec4(impostorCenter, 1.0));
+    // instances are only turned and scaled evenly, without the scale this is a rotation
+    mat3 rotation = mat3(instanceModel);
+    float scale = length(rotation[0]);
+    rotation /= scale;
+    vec3 toCamera = normalize(transpose(rotation) * (viewPosition - worldCenter));
+
+    // the three views around the direction the model is seen from, on the triangle of the grid it falls in
+    float last = float(impostorFrames - 1);
+    vec2 grid = octahedralCoordinates(toCamera) * last;
+    vec2 base = min(floor(grid), vec2(last - 1.0));
+    vec2 f = grid - base;
+    vec2 cells[3];
+    if (f.x + f.y < 1.0) {
+        cells[0] = base;
+        cells[1] = base + vec2(1.0, 0.0);
+        cells[2] = base + vec2(0.0, 1.0);
+        FrameWeights = vec3(1.0 - f.x - f.y, f.x, f.y);
+    } else {
+        cells[0] = base + vec2(1.0, 1.0);
+        cells[1] = base + vec2(0.0, 1.0);
+        cells[2] = base + vec2(1.0, 0.0);
+        FrameWeights = vec3(f.x + f.y - 1.0, 1.0 - f.x, 1.0 - f.y);
+    }
+
+    // the quad covers the bounding sphere, turned to the camera in model space
+    vec3 right, up;
+    frameBasis(toCamera, right, up);
+    vec3 corner = (aCorner.x * right + aCorner.y * up) * impostorRadius;
+    for (int k = 0; k < 3; k++) {
+        vec3 frame = octahedralDirection(cells[k] / last);
+        vec3 frameRight, frameUp;
+        frameBasis(frame, frameRight, frameUp);
+        // where the ray from the camera through the corner meets the plane the view was baked on
+        vec3 onPlane = corner - toCamera * (dot(corner, frame) / max(dot(toCamera, frame), 0.1));
+        FrameCoords[k] = vec2(dot(onPlane, frameRight), dot(onPlane, frameUp)) / impostorRadius * 0.5 + 0.5;
+        FrameCells[k] = cells[k];
+    }
+
+    FragPos = vec3(instanceModel * vec4(impostorCenter + corner, 1.0));
+    DepthAxis = rotation * toCamera * impostorRadius * scale;
+    NormalMatrix = rotation;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalHeight;
+
+struct Material {
+    sampler2DArray texture_diffuse1;
+    sampler2DArray texture_specular1;
+
+    float shininess;
+};
+
+in vec2 TexCoords;
+flat in vec2 MaterialLayers;
+in vec3 Normal;
+in vec3 Position;
+
+uniform Material material;
+
+// towards the camera of the view
+uniform vec3 frameDirection;
+uniform vec3 impostorCenter;
+uniform float impostorRadius;
+
+void main()
+{
+    vec3 albedo = MaterialLayers.x < 0.0 ? vec3(1.0) : vec3(texture(material.texture_diffuse1, vec3(TexCoords, MaterialLayers.x)));
+    // alpha is coverage, the background stays cleared to zero
+    Albedo = vec4(albedo, 1.0);
+    // the height above the plane through the center facing the camera, in radii, so -1 to 1
+    NormalHeight = vec4(normalize(Normal), dot(Position - impostorCenter, frameDirection) / impostorRadius);
+}
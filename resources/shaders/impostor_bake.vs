@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in vec2 aMaterialLayers;
+
+out vec2 TexCoords;
+flat out vec2 MaterialLayers;
+out vec3 Normal;
+out vec3 Position;
+
+// one view of the impostor atlas, looking at the model's bounding sphere
+uniform mat4 view;
+uniform mat4 projection;
+
+// the model in its rest pose and in model space, which is the space the atlas is in
+void main()
+{
+    TexCoords = aTexCoords;
+    MaterialLayers = aMaterialLayers;
+    Normal = aNormal;
+    Position = aPos;
+    gl_Position = projection * view * vec4(aPos, 1.0);
+}
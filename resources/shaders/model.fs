@@ -37,15 +37,20 @@ struct SpotLight {
 };
 
 struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
+    sampler2DArray texture_diffuse1;
+    sampler2DArray texture_specular1;
 
     float shininess;
 };
 
 in vec2 TexCoords;
+// layers of the diffuse (x) and specular (y) image in the model's texture arrays, negative when missing
+flat in vec2 MaterialLayers;
 in vec3 Normal;
 in vec3 FragPos;
+#ifdef SHADING_LOD_FAR
+in vec3 VertexLight;
+#endif
 
 #define NUM_OF_POINT_LIGHTS (2)
 
@@ -57,6 +62,15 @@ uniform Material material;
 
 uniform vec3 viewPosition;
 
+#define DIFFUSE_SAMPLE (MaterialLayers.x < 0.0 ? vec3(1.0) : vec3(texture(material.texture_diffuse1, vec3(TexCoords, MaterialLayers.x))))
+
+// mid-distance objects skip the specular map and use a flat specular intensity
+#ifdef SHADING_LOD_MID
+#define SPECULAR_SAMPLE vec3(0.5)
+#else
+#define SPECULAR_SAMPLE (MaterialLayers.y < 0.0 ? vec3(0.0) : vec3(texture(material.texture_specular1, vec3(TexCoords, MaterialLayers.y))))
+#endif
+
 
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -73,9 +87,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 ambient = light.ambient * DIFFUSE_SAMPLE;
+    vec3 diffuse = light.diffuse * diff * DIFFUSE_SAMPLE;
+    vec3 specular = light.specular * spec * SPECULAR_SAMPLE.xxx;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -94,9 +108,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
 
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * DIFFUSE_SAMPLE;
+    vec3 diffuse = light.diffuse * diff * DIFFUSE_SAMPLE;
+    vec3 specular = light.specular * spec * SPECULAR_SAMPLE;
     return (ambient + diffuse + specular);
 }
 
@@ -118,9 +132,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * DIFFUSE_SAMPLE;
+    vec3 diffuse = light.diffuse * diff * DIFFUSE_SAMPLE;
+    vec3 specular = light.specular * spec * SPECULAR_SAMPLE;
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
@@ -131,6 +145,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 
 void main()
 {
+#ifdef SHADING_LOD_FAR
+    FragColor = vec4(VertexLight * DIFFUSE_SAMPLE, 1.0);
+#else
     vec3 normal = normalize(Normal);
     vec3 viewDir = normalize(viewPosition - FragPos);
 
@@ -140,4 +157,5 @@ void main()
     result += CalcSpotLight(spotLight, normal, FragPos, viewDir);
 
     FragColor = vec4(result, 1.0);
+#endif
 }
\ No newline at end of file
@@ -2,19 +2,181 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in vec2 aMaterialLayers;
+layout (location = 6) in uvec4 aBoneIds;
+layout (location = 7) in vec4 aBoneWeights;
+// amplitude in body lengths, frequency in Hz, phase in radians, wavelengths along the body (see SwimMotion)
+layout (location = 13) in vec4 aSwim;
+// weight of each morph target, of single draws
+layout (location = 14) in vec4 aMorphWeights;
 
 out vec2 TexCoords;
+flat out vec2 MaterialLayers;
 out vec3 Normal;
 out vec3 FragPos;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform float time;
+
+// palette of the draw's pose, bound as a range of the frame's bone buffer
+#define MAX_BONES (128)
+layout (std140) uniform Bones {
+    mat4 bones[MAX_BONES];
+};
+uniform bool skinned;
+
+// the body the swim wave bends (see SwimBody): spine runs from head to tail over the body's length, side
+// is as long as the body
+uniform vec3 swimSpine;
+uniform float swimHead;
+uniform vec3 swimSide;
+
+// sparse morph targets (see MorphTargets): a range of entries per vertex, two texels of deltas per entry
+uniform isamplerBuffer morphRanges;
+uniform samplerBuffer morphDeltas;
+uniform bool morphed;
+
+#ifdef VERTEX_ANIMATION
+// crowds: every instance plays the model's baked animation (see VertexAnimation) from its own phase, if the
+// model has one, and swims with its own aSwim
+layout (location = 8) in mat4 aInstanceModel;
+layout (location = 12) in vec2 aInstancePlayback; // phase in seconds, playback rate
+
+uniform sampler2D animationPositions;
+uniform sampler2D animationNormals;
+uniform int animationFrames; // 0 without a baked animation
+uniform int animationWidth;
+uniform int animationRows;
+uniform float animationFrameRate;
+
+// the morph target weights every instance plays from its own phase and at its own rate (see MorphCycle)
+#define MAX_MORPH_CYCLE_KEYS (16)
+uniform vec4 morphCycle[MAX_MORPH_CYCLE_KEYS];
+uniform int morphCycleKeys; // 0 keeps the rest shape
+uniform float morphCycleDuration;
+
+ivec2 animationTexel(int frame)
+{
+    return ivec2(gl_VertexID % animationWidth, frame * animationRows + gl_VertexID / animationWidth);
+}
+
+vec4 morphCycleWeights()
+{
+    if (morphCycleKeys == 0) {
+        return vec4(0.0);
+    }
+    float position = fract((time + aInstancePlayback.x) * aInstancePlayback.y / morphCycleDuration) * float(morphCycleKeys);
+    int first = min(int(position), morphCycleKeys - 1);
+    int second = (first + 1) % morphCycleKeys;
+    return mix(morphCycle[first], morphCycle[second], position - float(first));
+}
+#endif
+
+#ifdef SHADING_LOD_FAR
+// far objects are lit per vertex: ambient of every light plus the directional light
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#define NUM_OF_POINT_LIGHTS (2)
+
+uniform PointLight pointLights[NUM_OF_POINT_LIGHTS];
+uniform DirLight dirLight;
+
+out vec3 VertexLight;
+#endif
+
+// A wave travels from head to tail and displaces the body along side, its envelope small at the head and
+// growing towards the tail. The normal follows the slope of the displacement along the spine.
+void swim(inout vec3 position, inout vec3 normal)
+{
+    float along = clamp(dot(position, swimSpine) - swimHead, 0.0, 1.0);
+    float angle = 6.2831853 * (aSwim.y * time - aSwim.w * along) + aSwim.z;
+    float envelope = 0.15 + 0.85 * along * along;
+    position += swimSide * (aSwim.x * envelope * sin(angle));
+    float slope = aSwim.x * (1.7 * along * sin(angle) - 6.2831853 * aSwim.w * envelope * cos(angle));
+    normal -= swimSpine * (slope * dot(swimSide, normal));
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    TexCoords = aTexCoords;    
+    vec4 position = vec4(aPos, 1.0);
+    vec3 normal = aNormal;
+    if (morphed) {
+#ifdef VERTEX_ANIMATION
+        vec4 weights = morphCycleWeights();
+#else
+        vec4 weights = aMorphWeights;
+#endif
+        ivec2 range = texelFetch(morphRanges, gl_VertexID).xy;
+        for (int i = range.x; i < range.x + range.y; i++) {
+            vec4 delta = texelFetch(morphDeltas, 2 * i);
+            float weight = weights[int(delta.w)];
+            position.xyz += weight * delta.xyz;
+            normal += weight * texelFetch(morphDeltas, 2 * i + 1).xyz;
+        }
+    }
+#ifdef VERTEX_ANIMATION
+    if (animationFrames > 0) {
+        float frame = max((time + aInstancePlayback.x) * aInstancePlayback.y * animationFrameRate, 0.0);
+        int first = int(frame) % animationFrames;
+        int second = (first + 1) % animationFrames;
+        float blend = fract(frame);
+        position = vec4(mix(texelFetch(animationPositions, animationTexel(first), 0).xyz,
+                            texelFetch(animationPositions, animationTexel(second), 0).xyz, blend), 1.0);
+        normal = mix(texelFetch(animationNormals, animationTexel(first), 0).xyz,
+                     texelFetch(animationNormals, animationTexel(second), 0).xyz, blend);
+    }
+#else
+    if (skinned) {
+        mat4 skin = aBoneWeights.x * bones[aBoneIds.x] + aBoneWeights.y * bones[aBoneIds.y]
+                  + aBoneWeights.z * bones[aBoneIds.z] + aBoneWeights.w * bones[aBoneIds.w];
+        position = skin * position;
+        normal = mat3(skin) * normal;
+    }
+#endif
+    vec3 bent = position.xyz;
+    swim(bent, normal);
+    position = vec4(bent, 1.0);
+#ifdef VERTEX_ANIMATION
+    // model orients the mesh, the instance places it; both only rotate and scale uniformly, so the
+    // normal matrix is the model matrix
+    mat4 instanceModel = aInstanceModel * model;
+    FragPos = vec3(instanceModel * position);
+    Normal = mat3(instanceModel) * normal;
+#else
+    FragPos = vec3(model * position);
+    Normal = mat3(transpose(inverse(model))) * normal;
+#endif
+    TexCoords = aTexCoords;
+    MaterialLayers = aMaterialLayers;
+#ifdef SHADING_LOD_FAR
+    normal = normalize(Normal);
+    float diff = max(dot(normal, normalize(-dirLight.direction)), 0.0);
+    VertexLight = dirLight.ambient + dirLight.diffuse * diff;
+    for (int i = 0; i < NUM_OF_POINT_LIGHTS; i++) {
+        float distance = length(pointLights[i].position - FragPos);
+        float attenuation = 1.0 / (pointLights[i].constant + pointLights[i].linear * distance + pointLights[i].quadratic * (distance * distance));
+        VertexLight += pointLights[i].ambient * attenuation;
+    }
+#endif
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
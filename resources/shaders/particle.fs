@@ -0,0 +1,41 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 Corner;
+in vec4 Color;
+in float ViewDepth;
+flat in int Kind;
+
+// a copy of the scene's depth, particles fade out as they reach a surface instead of being cut by it
+uniform sampler2D sceneDepth;
+uniform vec2 depthTexelSize;
+uniform float nearPlane;
+uniform float farPlane;
+uniform float fadeDistance;
+
+float linearDepth(float depth)
+{
+    float z = depth * 2.0 - 1.0;
+    return 2.0 * nearPlane * farPlane / (farPlane + nearPlane - z * (farPlane - nearPlane));
+}
+
+void main()
+{
+    float radius = dot(Corner, Corner);
+    if (radius > 1.0) {
+        discard;
+    }
+    float shape;
+    if (Kind == 1) {
+        // a bubble is a bright rim with a highlight
+        float rim = smoothstep(0.55, 0.9, radius) * (1.0 - smoothstep(0.9, 1.0, radius));
+        float highlight = 1.0 - smoothstep(0.0, 0.06, dot(Corner - vec2(-0.35, 0.35), Corner - vec2(-0.35, 0.35)));
+        shape = max(rim, highlight) + 0.1;
+    } else {
+        shape = 1.0 - radius;
+    }
+    float scene = linearDepth(texture(sceneDepth, gl_FragCoord.xy * depthTexelSize).r);
+    float fade = clamp((scene - ViewDepth) / fadeDistance, 0.0, 1.0);
+    float alpha = Color.a * shape * fade;
+    FragColor = vec4(Color.rgb * alpha, alpha);
+}
@@ -0,0 +1,115 @@
+#version 330 core
+// per instance, the particle as the update pass left it
+layout (location = 0) in vec4 aPosition; // w: age in seconds
+layout (location = 1) in vec4 aVelocity; // w: lifetime in seconds
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#define NUM_OF_POINT_LIGHTS (2)
+
+out vec2 Corner;
+out vec4 Color;
+out float ViewDepth;
+flat out int Kind;
+
+uniform PointLight pointLights[NUM_OF_POINT_LIGHTS];
+uniform DirLight dirLight;
+uniform SpotLight spotLight;
+
+uniform ivec3 ranges;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 cameraPosition;
+uniform vec3 snowBox;
+
+float attenuation(vec3 position, float constant, float linear, float quadratic)
+{
+    float distance = length(position - aPosition.xyz);
+    return 1.0 / (constant + linear * distance + quadratic * (distance * distance));
+}
+
+// particles have no surface to speak of, they take light from every direction alike
+vec3 light()
+{
+    vec3 total = dirLight.ambient + 0.5 * dirLight.diffuse;
+    for (int i = 0; i < NUM_OF_POINT_LIGHTS; i++) {
+        PointLight point = pointLights[i];
+        total += (point.ambient + point.diffuse) * attenuation(point.position, point.constant, point.linear,
+                                                               point.quadratic);
+    }
+    // marine snow lights up in the beam of the camera's lamp
+    vec3 lightDir = normalize(spotLight.position - aPosition.xyz);
+    float theta = dot(lightDir, normalize(-spotLight.direction));
+    float intensity = clamp((theta - spotLight.outerCutOff) / (spotLight.cutOff - spotLight.outerCutOff), 0.0, 1.0);
+    total += spotLight.diffuse * intensity * attenuation(spotLight.position, spotLight.constant, spotLight.linear,
+                                                         spotLight.quadratic);
+    return total;
+}
+
+void main()
+{
+    int id = gl_InstanceID;
+    float age = aPosition.w;
+    float lifetime = aVelocity.w;
+    float size;
+    if (id < ranges.x) {
+        Kind = 0;
+        size = 0.02 + 0.02 * fract(float(id) * 0.618034);
+        // fades out towards the walls of the box it wraps around in
+        vec3 toWall = 1.0 - abs(aPosition.xyz - cameraPosition) / (0.5 * snowBox);
+        Color = vec4(vec3(0.85, 0.9, 0.8), 0.6 * clamp(min(min(toWall.x, toWall.y), toWall.z) * 5.0, 0.0, 1.0));
+    } else if (id < ranges.y) {
+        Kind = 1;
+        size = (0.04 + 0.05 * fract(float(id) * 0.618034)) * (1.0 + 0.4 * age);
+        Color = vec4(vec3(0.7, 0.85, 1.0), age >= 0.0 && age < lifetime ? 0.7 : 0.0);
+    } else {
+        Kind = 2;
+        size = 0.08 + 0.1 * fract(float(id) * 0.618034);
+        float left = lifetime - age;
+        Color = vec4(vec3(0.45, 0.38, 0.28), 0.35 * clamp(left, 0.0, 1.0) * clamp(age * 4.0, 0.0, 1.0));
+    }
+    // dead particles collapse to nothing and are never rasterized
+    if (Color.a <= 0.0) {
+        size = 0.0;
+    }
+    Color.rgb *= light();
+
+    Corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec4 viewPosition = view * vec4(aPosition.xyz, 1.0);
+    viewPosition.xy += Corner * size;
+    ViewDepth = -viewPosition.z;
+    gl_Position = projection * viewPosition;
+}
@@ -0,0 +1,8 @@
+#version 330 core
+// the update pass runs with the rasterizer off, nothing reaches this
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(0.0);
+}
@@ -0,0 +1,130 @@
+#version 330 core
+// one particle, captured into the other buffer as it comes out
+layout (location = 0) in vec4 aPosition; // w: age in seconds
+layout (location = 1) in vec4 aVelocity; // w: lifetime in seconds, 0 before the first spawn
+
+out vec4 Position;
+out vec4 Velocity;
+
+// where the bubbles (x) and the sediment (y) start and where the sediment ends (z), snow comes first
+uniform ivec3 ranges;
+uniform float deltaTime;
+uniform float time;
+uniform int frame;
+uniform vec3 cameraPosition;
+uniform vec3 snowBox;
+uniform vec3 bubbleSources[2];
+uniform float seabedHeight;
+uniform vec3 current;
+// xyz, w the share of the sediment that respawns there
+uniform vec4 impacts[8];
+uniform int impactCount;
+
+uint seed;
+
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// uniform in [0, 1)
+float random()
+{
+    seed = hash(seed);
+    return float(seed >> 8) / 16777216.0;
+}
+
+vec3 randomInBox()
+{
+    return vec3(random(), random(), random()) - 0.5;
+}
+
+// drifts slowly and sinks, tumbling a little; wraps around in the box that follows the camera, so
+// there is always snow wherever the camera goes
+void snow(inout vec4 position, inout vec4 velocity)
+{
+    if (velocity.w == 0.0) {
+        position = vec4(cameraPosition + randomInBox() * snowBox, random() * 100.0);
+        velocity.w = 1.0;
+    }
+    float phase = float(gl_VertexID % 1024) * 0.37;
+    vec3 tumble = vec3(sin(0.7 * time + phase + position.y), 0.0, cos(0.5 * time + phase + position.x)) * 0.08;
+    velocity.xyz = current + tumble + vec3(0.0, -0.12, 0.0);
+    position.xyz += velocity.xyz * deltaTime;
+    position.w += deltaTime;
+    position.xyz = cameraPosition + mod(position.xyz - cameraPosition + 0.5 * snowBox, snowBox) - 0.5 * snowBox;
+}
+
+// stream from the sources at a steady rate: the first spawn spreads the ages over a lifetime back, a
+// bubble that pops starts over right away keeping its place in the stream
+void bubbles(inout vec4 position, inout vec4 velocity)
+{
+    if (velocity.w == 0.0) {
+        velocity.w = 3.0 + 2.0 * random();
+        position.w = -random() * 5.0;
+    }
+    position.w += deltaTime;
+    if (position.w >= velocity.w) {
+        position.w -= velocity.w;
+    }
+    if (position.w < deltaTime) {
+        // not born yet or just born, waiting at its source
+        vec3 source = bubbleSources[(gl_VertexID & 1)];
+        position.xyz = source + randomInBox() * 0.4;
+        velocity.xyz = vec3(random() - 0.5, 0.4, random() - 0.5) * 0.6;
+        return;
+    }
+    float wobble = 6.0 + 2.0 * float(gl_VertexID % 7);
+    velocity.xyz += (vec3(0.0, 1.6, 0.0) - 0.8 * velocity.xyz) * deltaTime;
+    vec3 sway = vec3(sin(wobble * position.w), 0.0, cos(wobble * position.w)) * 0.25;
+    position.xyz += (velocity.xyz + current + sway) * deltaTime;
+}
+
+// dead until something hits the seabed, then thrown up and out from the impact; the water slows it
+// down fast and it settles back slowly
+void sediment(inout vec4 position, inout vec4 velocity)
+{
+    if (position.w >= velocity.w) {
+        if (impactCount == 0) {
+            return;
+        }
+        int impact = min(int(random() * float(impactCount)), impactCount - 1);
+        if (random() >= impacts[impact].w * float(impactCount)) {
+            return;
+        }
+        float angle = random() * 6.2831853;
+        vec3 outward = vec3(cos(angle), 0.0, sin(angle));
+        position = vec4(impacts[impact].xyz + outward * random() * 1.5, 0.0);
+        position.y = max(position.y, seabedHeight) + 0.05;
+        velocity = vec4(outward * (0.5 + 2.5 * random()) + vec3(0.0, 0.5 + 2.0 * random(), 0.0), 4.0 + 6.0 * random());
+        return;
+    }
+    velocity.xyz = (velocity.xyz + vec3(0.0, -0.3, 0.0) * deltaTime) * exp(-1.5 * deltaTime);
+    position.xyz += (velocity.xyz + current) * deltaTime;
+    position.w += deltaTime;
+    if (position.y < seabedHeight) {
+        position.y = seabedHeight;
+        velocity.y = 0.0;
+    }
+}
+
+void main()
+{
+    seed = hash(uint(gl_VertexID) ^ hash(uint(frame) * 0x9e3779b9u));
+    vec4 position = aPosition;
+    vec4 velocity = aVelocity;
+    if (gl_VertexID < ranges.x) {
+        snow(position, velocity);
+    } else if (gl_VertexID < ranges.y) {
+        bubbles(position, velocity);
+    } else {
+        sediment(position, velocity);
+    }
+    Position = position;
+    Velocity = velocity;
+}
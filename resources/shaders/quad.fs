@@ -7,6 +7,9 @@ in VS_OUT {
     vec3 TangentLightPos;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
+#ifdef SHADING_LOD_FAR
+    float Lighting;
+#endif
 } fs_in;
 
 uniform sampler2D diffuseMap;
@@ -24,10 +27,18 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 
 void main()
 {
-    // offset texture coordinates with Parallax Mapping
+#ifdef SHADING_LOD_FAR
+    vec3 color = texture(diffuseMap, fs_in.TexCoords).rgb;
+    FragColor = vec4(0.6*(0.2*lightColor + fs_in.Lighting * color), 1.0);
+#else
     vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
     vec2 texCoords = fs_in.TexCoords;
 
+#ifdef SHADING_LOD_MID
+    // no parallax offset and no normal map, the quad is flat in tangent space
+    vec3 normal = vec3(0.0, 0.0, 1.0);
+#else
+    // offset texture coordinates with Parallax Mapping
     texCoords = ParallaxMapping(fs_in.TexCoords,  viewDir);
     if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
         discard;
@@ -35,6 +46,7 @@ void main()
     // obtain normal from normal map
     vec3 normal = texture(normalMap, texCoords).rgb;
     normal = normalize(normal * 2.0 - 1.0);
+#endif
 
     // get diffuse color
     vec3 color = texture(diffuseMap, texCoords).rgb;
@@ -52,5 +64,5 @@ void main()
     vec3 specular = vec3(0.3) * spec;
     //FragColor = vec4(ambient + diffuse + specular, 1.0);
     FragColor = vec4(0.6*(0.2*lightColor+vec3(ambient + diffuse + specular)), 1.0);
-
+#endif
 }
\ No newline at end of file
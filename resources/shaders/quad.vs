@@ -11,6 +11,9 @@ out VS_OUT {
     vec3 TangentLightPos;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
+#ifdef SHADING_LOD_FAR
+    float Lighting;
+#endif
 } vs_out;
 
 uniform mat4 projection;
@@ -33,6 +36,10 @@ void main()
     vs_out.TangentLightPos = TBN * lightPos;
     vs_out.TangentViewPos  = TBN * viewPos;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
+#ifdef SHADING_LOD_FAR
+    // ambient plus the single light, evaluated once per vertex
+    vs_out.Lighting = 0.4 + max(dot(normalize(lightPos - vs_out.FragPos), N), 0.0);
+#endif
 
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
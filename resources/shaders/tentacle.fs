@@ -0,0 +1,18 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+in float Along;
+
+// the light inside the jellyfish, the tentacles glow in its color
+uniform vec3 lightPos;
+uniform vec3 lightColor;
+
+void main()
+{
+    float distance = length(lightPos - FragPos);
+    float glow = 1.0 / (1.0 + 0.05 * distance * distance);
+    vec3 color = lightColor * (0.35 + 0.65 * glow);
+    // thinner and fainter towards the tips
+    FragColor = vec4(color, 0.8 * (1.0 - 0.75 * Along));
+}
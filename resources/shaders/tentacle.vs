@@ -0,0 +1,16 @@
+#version 330 core
+// particle position, w is how far along its tentacle it is
+layout (location = 0) in vec4 aParticle;
+
+out vec3 FragPos;
+out float Along;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    FragPos = aParticle.xyz;
+    Along = aParticle.w;
+    gl_Position = projection * view * vec4(aParticle.xyz, 1.0);
+}
@@ -0,0 +1,29 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+// one texel of the scene texture
+uniform vec2 texelSize;
+// last texel center inside the drawn region, the rest of the texture holds older frames
+uniform vec2 maxCoords;
+// 0 is a plain bilinear upscale
+uniform float sharpness;
+
+void main()
+{
+    vec2 uv = min(TexCoords, maxCoords);
+    vec3 center = texture(scene, uv).rgb;
+    vec3 north = texture(scene, min(uv + vec2(0.0, texelSize.y), maxCoords)).rgb;
+    vec3 south = texture(scene, uv - vec2(0.0, texelSize.y)).rgb;
+    vec3 east = texture(scene, min(uv + vec2(texelSize.x, 0.0), maxCoords)).rgb;
+    vec3 west = texture(scene, uv - vec2(texelSize.x, 0.0)).rgb;
+
+    // contrast adaptive: edges that are already hard get less, so they don't ring
+    vec3 low = min(center, min(min(north, south), min(east, west)));
+    vec3 high = max(center, max(max(north, south), max(east, west)));
+    vec3 amount = sharpness * sqrt(clamp(min(low, 1.0 - high) / max(high, vec3(0.0001)), 0.0, 1.0));
+    vec3 sharpened = center + amount * (4.0 * center - north - south - east - west) * 0.25;
+    FragColor = vec4(clamp(sharpened, low, high), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+out vec2 TexCoords;
+
+// how much of the scene texture was drawn into
+uniform vec2 uvScale;
+
+void main()
+{
+    // one triangle covering the screen, no vertex buffer needed
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = position * uvScale;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -13,8 +13,40 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
-
+#include <rg/ShadingLod.h>
+#include <rg/MeshLod.h>
+#include <rg/MeshCache.h>
+#include <rg/PipelineWarmup.h>
+#include <rg/AssetLoader.h>
+#include <rg/TextureStreamer.h>
+#include <rg/WorldStreamer.h>
+#include <rg/StartupProfiler.h>
+#include <rg/FrameProfiler.h>
+#include <rg/ProfilerOverlay.h>
+#include <rg/GpuTimers.h>
+#include <rg/Benchmark.h>
+#include <rg/Error.h>
+#include <rg/FramePipeline.h>
+#include <rg/FixedTimestep.h>
+#include <rg/DynamicResolution.h>
+#include <rg/Animation.h>
+#include <rg/BoneBuffer.h>
+#include <rg/Crowd.h>
+#include <rg/Impostor.h>
+#include <rg/Swim.h>
+#include <rg/Morph.h>
+#include <rg/WorkerPool.h>
+#include <rg/StreamBuffer.h>
+#include <rg/Tentacles.h>
+#include <rg/RigidBodies.h>
+#include <rg/Particles.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <random>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -32,11 +64,62 @@ unsigned int loadTexture(char const * path);
 
 void renderQuad();
 
-void setShaderLights(Shader &shader);
+void setupQuad();
+
+void loadTextureAsync(rg::AssetLoader &loader, const std::string &path, bool flipVertically, unsigned int &texture);
+
+void drawPlaceholder(Shader &shader, const glm::mat4 &model);
+
+void bakeJellyfishPulse(Model &model);
+
+glm::mat4 jellyfishTransform(float time);
+
+void tentacleAnchors(float time, std::vector<glm::vec3> &anchors);
+
+void drawTentacles(rg::StreamBuffer &stream, rg::StreamMode mode, unsigned int vao,
+                   const std::vector<glm::vec4> &vertices, int particles);
+
+int runTentacleBenchmark(GLFWwindow *window, Shader &shader, int tentacleCount);
+
+struct FrameInput;
+
+struct ModelDraw;
+
+struct FramePacket;
+
+enum Debris : int;
+
+glm::mat4 debrisPlacement(Debris object);
+
+void debrisBounds(Debris object, const FrameInput &input, glm::vec3 &boundsMin, glm::vec3 &boundsMax);
+
+void rainBarrels(rg::RigidBodyWorld &world, std::vector<glm::mat4> &offsets, std::mt19937 &random,
+                 glm::vec3 boundsMin, glm::vec3 boundsMax, int count);
+
+int runDebrisBenchmark(int barrels);
+
+double debrisStepMs(const rg::RigidBodyWorld::Stats &stats);
+
+int runParticleBenchmark(Shader &updateShader, Shader &shader, int particleCount);
+
+void updateFrame(const FrameInput &input, FramePacket &packet);
+
+void setShaderLights(Shader &shader, const FramePacket &packet);
+
+float screenSize(const glm::mat4 &model, glm::vec3 center, float radius);
+
+rg::ShadingLod selectShadingLod(rg::ShadingLodSelector &lodSelector, const glm::mat4 &model, glm::vec3 center,
+                                float radius);
+
+void drawModel(const ModelDraw &draw, Model *modelToDraw, Shader *shaders[], rg::ShadingLodSelector &lodSelector,
+               int &meshLod);
 
 // settings
 const unsigned int SCR_WIDTH = 1200; //800
 const unsigned int SCR_HEIGHT = 800; //600
+// of the scene camera's projection; the particles' soft fade linearizes depth with the same planes
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 float heightScale = 0.1;
 
 int Width = SCR_WIDTH;
@@ -57,9 +140,16 @@ bool blink = false;
 int jellyfishColor = 2;
 bool fall = false;
 
+// the simulation steps 60 times per simulated second however fast frames are drawn
+const double SIMULATION_STEP = 1.0 / 60.0;
+
 unsigned int quadVAO = 0;
 unsigned int quadVBO;
 
+// drawn in place of models that are still loading or failed to load
+unsigned int placeholderVAO = 0;
+unsigned int placeholderTextureArray = 0;
+
 struct PointLight {
     glm::vec3 position;
     glm::vec3 ambient;
@@ -94,6 +184,149 @@ struct SpotLight {
     glm::vec3 specular;
 };
 
+// models placed by the update stage, drawn in this order
+enum SceneModel {
+    MODEL_SUBMARINE,
+    MODEL_FISH,
+    MODEL_FISH2,
+    MODEL_JELLYFISH,
+    MODEL_SHARK,
+    MODEL_ANGLERFISH,
+    MODEL_SEASHELL,
+    MODEL_BARRELS,
+    MODEL_COUNT
+};
+
+const char *modelNames[MODEL_COUNT] = {"submarine", "fish", "fish2", "jellyfish", "shark", "anglerfish", "seashell",
+                                       "barrels"};
+
+// clip each skinned model plays, the first one it has when there is no clip of that name
+const char *modelClips[MODEL_COUNT] = {"", "", "", "", "Swim", "", "", ""};
+
+// head to tail and sideways axes of the models that swim, in model space
+const rg::SwimBody modelSwimBodies[MODEL_COUNT] = {
+        {}, {{0.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}}, {{-1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}, {},
+        {{0.0f, 0.0f, -1.0f}, {1.0f, 0.0f, 0.0f}}, {}, {}, {}
+};
+// how the single models swim, the shark's clip already does
+const rg::SwimMotion modelSwims[MODEL_COUNT] = {
+        {}, {0.08f, 1.1f, 0.0f, 0.7f}, {0.06f, 0.8f, 1.0f, 0.6f}, {}, {}, {}, {}, {}
+};
+
+// weights of the jellyfish's contract, trail and sway targets (see bakeJellyfishPulse) over one pulse:
+// a quick stroke, the arms streaming behind it, a slow recovery
+const rg::MorphCycle jellyfishPulse = {2.4f, {
+        {0.0f, 0.3f, 0.0f, 0.0f}, {0.8f, 0.2f, 0.7f, 0.0f}, {1.0f, 0.4f, 1.0f, 0.0f}, {0.7f, 0.8f, 0.7f, 0.0f},
+        {0.4f, 1.0f, 0.0f, 0.0f}, {0.2f, 0.8f, -0.7f, 0.0f}, {0.08f, 0.5f, -1.0f, 0.0f}, {0.0f, 0.4f, -0.7f, 0.0f}
+}};
+
+struct ModelDraw {
+    SceneModel model;
+    glm::mat4 transform;
+    // palette of the draw in the frame's bone buffer, -1 for rigid models
+    int boneSlot = -1;
+    // of the model's morph targets
+    glm::vec4 morphWeights = glm::vec4(0.0f);
+};
+
+// objects that sink to the seabed once F is pressed, the first bodies of the debris world; the barrels
+// rained onto them come after
+enum Debris : int {
+    DEBRIS_BOX,
+    DEBRIS_SEASHELL,
+    DEBRIS_BARRELS,
+    DEBRIS_QUAD,
+    DEBRIS_SEAWEED,
+    DEBRIS_COUNT
+};
+
+// the rain starts this many barrels per simulation step until there are as many as asked for
+const int BARREL_RAIN_PER_STEP = 10;
+const float BARREL_RAIN_SCALE = 0.25f;
+// the debris shares the update thread with the tentacles; while a step of it takes longer than this
+// the rain holds, so the barrels stop at about as many as the solver keeps up with in real time
+const double DEBRIS_BUDGET_MS = 0.5 * SIMULATION_STEP * 1000.0;
+// the rained barrels' colliders are the bounds of this model, the benchmark loads it for nothing else
+const char *const BARRELS_MODEL = "resources/objects/barrels/scene.gltf";
+
+// tentacles hanging from the rim of the jellyfish's bell
+const int TENTACLE_COUNT = 64;
+const int TENTACLE_PARTICLES = 32;
+const float TENTACLE_SEGMENT = 0.3f;
+
+// loops split over all cores, issued from one thread at a time: the update thread, or the tentacle
+// benchmark before it is started
+rg::WorkerPool *workerPool;
+
+// update stage only
+rg::FixedTimestep simulationClock(SIMULATION_STEP);
+rg::PoseEvaluator poseEvaluator;
+// playback position of each model's clip
+rg::ClipCursor clipCursors[MODEL_COUNT];
+rg::TentacleSimulation tentacles;
+std::vector<glm::vec3> tentacleRoots;
+// empty until things fall; the model transform of every body relative to the body
+rg::RigidBodyWorld debris;
+std::vector<glm::mat4> debrisOffsets;
+std::mt19937 barrelRainRandom(59);
+
+// what the update stage works from, copied on the render thread so the worker never reads input state
+struct FrameInput {
+    // wall clock time since the last frame, the simulation clock turns it into steps
+    float deltaTime = 0.0f;
+    int width = SCR_WIDTH;
+    int height = SCR_HEIGHT;
+    Camera camera;
+    bool blink = false;
+    int jellyfishColor = 0;
+    bool fall = false;
+    // barrels to rain onto the seabed while things fall
+    int barrelRain = 0;
+    PointLight jellyfishPointLight;
+    PointLight anglerfishPointLight;
+    DirLight dirLight;
+    SpotLight spotLight;
+    // model space bounds of the loaded models, the placeholder cube's for the others
+    glm::vec3 boundsMin[MODEL_COUNT];
+    glm::vec3 boundsMax[MODEL_COUNT];
+    // of the models that are loaded and skinned
+    std::shared_ptr<const rg::Skeleton> skeletons[MODEL_COUNT];
+};
+
+// Everything the render stage needs for one frame. The update stage writes it, after that it is only read.
+struct FramePacket {
+    float time = 0.0f;
+    glm::vec3 cameraPosition;
+    glm::vec3 cameraFront;
+    float cameraZoom = 45.0f;
+    glm::mat4 view;
+    glm::mat4 projection;
+    PointLight jellyfishPointLight;
+    PointLight anglerfishPointLight;
+    DirLight dirLight;
+    SpotLight spotLight;
+    glm::mat4 boxModel;
+    glm::mat4 quadModel;
+    glm::mat4 seaweedModel;
+    std::vector<ModelDraw> models;
+    // MAX_BONES matrices for each skinned draw, uploaded to the bone buffer as they are
+    std::vector<glm::mat4> bonePalettes;
+    // the tentacles in world space, one strip of tentacleParticles after the other
+    std::vector<glm::vec4> tentacleVertices;
+    int tentacleParticles = 0;
+    // particles stepped so far and the time it took
+    double tentacleParticleSteps = 0.0;
+    double tentacleStepSeconds = 0.0;
+    // drawn with the barrels model, the other debris is among the models
+    std::vector<glm::mat4> rainedBarrels;
+    rg::RigidBodyWorld::Stats debrisStats;
+    // the rain holds because a debris step took longer than DEBRIS_BUDGET_MS
+    bool barrelRainHeld = false;
+    // where the bubbles stream from, and where debris hit the seabed since the last frame (w how fast)
+    glm::vec3 bubbleSources[2];
+    std::vector<glm::vec4> particleImpacts;
+};
+
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     bool ImGuiEnabled = false;
@@ -104,6 +337,12 @@ struct ProgramState {
     DirLight dirLight;
     SpotLight spotLight;
     glm::vec3 backpackPosition = glm::vec3(0.0f);
+    // memory the streamed model textures may use
+    int textureBudgetMB = 256;
+    // world objects that were on screen at shutdown, they are loaded first on the next start
+    std::string visibleObjects;
+    // GPU time the scene may take, the render resolution drops to stay within it
+    float frameBudgetMs = 14.0f;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
@@ -123,7 +362,10 @@ void ProgramState::SaveToFile(std::string filename) {
         << camera.Position.z << '\n'
         << camera.Front.x << '\n'
         << camera.Front.y << '\n'
-        << camera.Front.z << '\n';
+        << camera.Front.z << '\n'
+        << textureBudgetMB << '\n'
+        << visibleObjects << '\n'
+        << frameBudgetMs << '\n';
 }
 
 void ProgramState::LoadFromFile(std::string filename) {
@@ -139,16 +381,81 @@ void ProgramState::LoadFromFile(std::string filename) {
            >> camera.Front.x
            >> camera.Front.y
            >> camera.Front.z;
+        // older state files end here
+        int budget;
+        if (in >> budget) {
+            textureBudgetMB = budget;
+            float frameBudget;
+            if (in >> visibleObjects >> frameBudget) {
+                frameBudgetMs = frameBudget;
+            }
+        }
     }
 }
 
 ProgramState *programState;
 
+rg::TextureStreamer *textureStreamer;
+rg::GpuTimers *gpuTimers;
+
+// packet the render stage is drawing, set for the length of a frame
+const FramePacket *renderPacket;
+// rows the scene is drawn into this frame at the dynamic resolution's scale, what sizes on screen and the
+// levels of detail they pick are measured in
+int renderHeight = SCR_HEIGHT;
+
+// palettes of the frame's skinned draws
+rg::BoneBuffer *boneBuffer;
+
+// picks the meshes' levels of detail for the frame's camera; what the frame's draws submitted with them
+rg::MeshLodSelector meshLodSelector;
+rg::TriangleCount frameTriangles;
+
+// pipelines still waiting for their program to finish compiling, they are skipped when drawing until then
+vector<rg::WarmupDraw> pendingWarmups;
+
+
+int main(int argc, char *argv[]) {
+    auto startupBegin = std::chrono::steady_clock::now();
+
+    // --startup-profile[=file] writes a trace of everything up to the complete scene
+    // --benchmark[=file] measures 10 s once the scene is complete, writes the results and exits
+    // --swap-interval=N waits for N vertical blanks per frame, 0 uncaps the frame rate
+    // --tentacle-benchmark[=N] simulates, uploads and draws N tentacles in both stream modes and exits
+    // --debris-benchmark[=N] rains N barrels onto the seabed until they all sleep, on one thread and on all, and exits
+    // --particle-benchmark[=N] simulates and draws N particles on the GPU and exits
+    // --clip-report compares every animation clip with its compressed form as models load
+    std::unique_ptr<rg::Benchmark> benchmark;
+    int swapInterval = -1;
+    int tentacleBenchmark = 0;
+    int debrisBenchmark = 0;
+    int particleBenchmark = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--startup-profile", 17) == 0) {
+            const char *path = argv[i][17] == '=' ? argv[i] + 18 : "startup_profile.json";
+            rg::StartupProfiler::Instance().Start(startupBegin, path);
+            rg::StartupProfiler::Instance().NameThread("render thread");
+        } else if (std::strncmp(argv[i], "--benchmark", 11) == 0) {
+            benchmark.reset(new rg::Benchmark(argv[i][11] == '=' ? argv[i] + 12 : "benchmark.json", 10.0));
+        } else if (std::strncmp(argv[i], "--swap-interval=", 16) == 0) {
+            swapInterval = std::atoi(argv[i] + 16);
+        } else if (std::strncmp(argv[i], "--tentacle-benchmark", 20) == 0) {
+            tentacleBenchmark = argv[i][20] == '=' ? std::atoi(argv[i] + 21) : 4096;
+        } else if (std::strncmp(argv[i], "--debris-benchmark", 18) == 0) {
+            debrisBenchmark = argv[i][18] == '=' ? std::atoi(argv[i] + 19) : 3000;
+        } else if (std::strncmp(argv[i], "--particle-benchmark", 20) == 0) {
+            particleBenchmark = argv[i][20] == '=' ? std::atoi(argv[i] + 21) : 1000000;
+        } else if (std::strcmp(argv[i], "--clip-report") == 0) {
+            rg::clipReports() = true;
+        }
+    }
 
-int main() {
     // glfw: initialize and configure
     // ------------------------------
-    glfwInit();
+    {
+        rg::StartupZone zone("glfwInit", "startup");
+        glfwInit();
+    }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -156,16 +463,28 @@ int main() {
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+#ifndef NDEBUG
+    // drivers only have to report errors and warnings through KHR_debug in debug contexts
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
     // glfw window creation
     // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Seaworld", NULL, NULL);
+    GLFWwindow *window;
+    {
+        rg::StartupZone zone("create context", "startup");
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Seaworld", NULL, NULL);
+    }
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
         return -1;
     }
     glfwMakeContextCurrent(window);
+    // the simulation runs in fixed steps, the frame rate only changes how often it is drawn
+    if (swapInterval >= 0) {
+        glfwSwapInterval(swapInterval);
+    }
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
@@ -175,13 +494,40 @@ int main() {
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+    {
+        rg::StartupZone zone("gladLoadGLLoader", "startup");
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+        rg::loadGLExtensions((GLADloadproc) glfwGetProcAddress);
+        rg::installDebugOutput();
+    }
+    {
+        // a debug context validates every call, numbers measured with one aren't worth comparing
+        GLint contextFlags = 0;
+        glGetIntegerv(GL_CONTEXT_FLAGS, &contextFlags);
+        std::cout << "[OpenGL] " << glGetString(GL_RENDERER) << ", "
+                  << (contextFlags & GL_CONTEXT_FLAG_DEBUG_BIT ? "debug" : "no debug") << " context" << std::endl;
     }
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
+    if (programState->ImGuiEnabled) {
+        programState->CameraMouseMovementUpdateEnabled = false;
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+    }
+
+    // imgui: installed after our callbacks, it forwards the events it doesn't consume to them
+    // -----------------------------------------------------------------------------------------
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 330 core");
+    gpuTimers = new rg::GpuTimers();
+    rg::ProfilerOverlay profilerOverlay;
+    profilerOverlay.Gpu = gpuTimers;
+    rg::FrameProfiler::Instance().NameThread("render thread");
 
 
     // configure global opengl state
@@ -200,33 +546,90 @@ int main() {
 
     // build and compile shaders
     // -------------------------
+    // all programs are submitted up front; with parallel shader compile the driver builds them
+    // in the background while the rest of the setup runs, and the warm-up below finishes them
     Shader modelShader("resources/shaders/model.vs", "resources/shaders/model.fs");
+    Shader modelShaderMid("resources/shaders/model.vs", "resources/shaders/model.fs", nullptr,
+                          {rg::shadingLodDefine(rg::SHADING_LOD_MID)});
+    Shader modelShaderFar("resources/shaders/model.vs", "resources/shaders/model.fs", nullptr,
+                          {rg::shadingLodDefine(rg::SHADING_LOD_FAR)});
+    Shader *modelShaders[rg::SHADING_LOD_COUNT] = {&modelShader, &modelShaderMid, &modelShaderFar};
+    // crowds are many small instances, the specular map isn't worth sampling for them
+    Shader crowdShader("resources/shaders/model.vs", "resources/shaders/model.fs", nullptr,
+                       {rg::shadingLodDefine(rg::SHADING_LOD_MID), "VERTEX_ANIMATION"});
+    // and the far ones are a single quad, from views of the model baked into an atlas
+    Shader impostorBakeShader("resources/shaders/impostor_bake.vs", "resources/shaders/impostor_bake.fs");
+    Shader impostorShader("resources/shaders/impostor.vs", "resources/shaders/impostor.fs");
 
-    // load models
-    // -----------
-    Model submarineModel("resources/objects/submarine/scene.gltf");
-    submarineModel.SetShaderTextureNamePrefix("material.");
-
-    Model fishModel("resources/objects/fish/scene.gltf");
-    fishModel.SetShaderTextureNamePrefix("material.");
-
-    Model seashellModel("resources/objects/seashell/sea_shell.obj");
-    seashellModel.SetShaderTextureNamePrefix("material.");
-
-    Model fish2Model("resources/objects/fish2/scene.gltf");
-    fish2Model.SetShaderTextureNamePrefix("material.");
-
-    Model sharkModel("resources/objects/shark/scene.gltf");
-    sharkModel.SetShaderTextureNamePrefix("material.");
-
-    Model jellyfishModel("resources/objects/jellyfish/scene.gltf");
-    jellyfishModel.SetShaderTextureNamePrefix("material.");
+    Shader boxShader("resources/shaders/box.vs", "resources/shaders/box.fs");
+    Shader glassShader("resources/shaders/blending.vs", "resources/shaders/blending.fs");
+    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
 
-    Model anglerfishModel("resources/objects/anglerfish/scene.gltf");
-    anglerfishModel.SetShaderTextureNamePrefix("material.");
+    Shader quadShader("resources/shaders/quad.vs", "resources/shaders/quad.fs");
+    Shader quadShaderMid("resources/shaders/quad.vs", "resources/shaders/quad.fs", nullptr,
+                         {rg::shadingLodDefine(rg::SHADING_LOD_MID)});
+    Shader quadShaderFar("resources/shaders/quad.vs", "resources/shaders/quad.fs", nullptr,
+                         {rg::shadingLodDefine(rg::SHADING_LOD_FAR)});
+    Shader *quadShaders[rg::SHADING_LOD_COUNT] = {&quadShader, &quadShaderMid, &quadShaderFar};
+
+    Shader upscaleShader("resources/shaders/upscale.vs", "resources/shaders/upscale.fs");
+    Shader tentacleShader("resources/shaders/tentacle.vs", "resources/shaders/tentacle.fs");
+    // the update pass writes its outputs back into a particle buffer
+    Shader particleUpdateShader("resources/shaders/particle_update.vs", "resources/shaders/particle_update.fs",
+                                nullptr, {}, {"Position", "Velocity"});
+    Shader particleShader("resources/shaders/particle.vs", "resources/shaders/particle.fs");
+
+    workerPool = new rg::WorkerPool();
+    // nothing else is loaded or running yet to get in the way of the measurement
+    if (tentacleBenchmark > 0) {
+        int result = runTentacleBenchmark(window, tentacleShader, tentacleBenchmark);
+        delete workerPool;
+        glfwTerminate();
+        return result;
+    }
+    if (debrisBenchmark > 0) {
+        int result = runDebrisBenchmark(debrisBenchmark);
+        delete workerPool;
+        glfwTerminate();
+        return result;
+    }
+    if (particleBenchmark > 0) {
+        int result = runParticleBenchmark(particleUpdateShader, particleShader, particleBenchmark);
+        delete workerPool;
+        glfwTerminate();
+        return result;
+    }
 
-    Model barrelsModel("resources/objects/barrels/scene.gltf");
-    barrelsModel.SetShaderTextureNamePrefix("material.");
+    // load models
+    // -----------
+    // models and textures are decoded and uploaded on the loader thread, until they arrive
+    // placeholders are drawn. stb_image is only used from the loader thread from here on.
+    rg::AssetLoader assetLoader;
+    assetLoader.Start(window);
+
+    // model textures start out with their smallest mips, finer ones are streamed in as they get close
+    textureStreamer = new rg::TextureStreamer(assetLoader, (std::size_t) programState->textureBudgetMB * 1024 * 1024);
+
+    unsigned int placeholderTexture = rg::createPlaceholderTexture(GL_TEXTURE_2D);
+    placeholderTextureArray = rg::createPlaceholderTexture(GL_TEXTURE_2D_ARRAY);
+
+    // models belong to world cells and are loaded when the camera gets close to their cell,
+    // the anchors are the positions they are drawn at in the render loop
+    rg::WorldStreamer *worldStreamer = new rg::WorldStreamer(assetLoader, *textureStreamer);
+    int submarineObject = worldStreamer->Add("resources/objects/submarine/scene.gltf", glm::vec3(0.0f));
+    int fishObject = worldStreamer->Add("resources/objects/fish/scene.gltf", glm::vec3(10.0f, 5.0f, 10.0f));
+    int seashellObject = worldStreamer->Add("resources/objects/seashell/sea_shell.obj", glm::vec3(-14.0f, -8.0f, -17.0f));
+    int fish2Object = worldStreamer->Add("resources/objects/fish2/scene.gltf", glm::vec3(8.0f, 2.0f, 15.0f));
+    int sharkObject = worldStreamer->Add("resources/objects/shark/scene.gltf", glm::vec3(10.0f, 10.0f, 20.0f));
+    int jellyfishObject = worldStreamer->Add("resources/objects/jellyfish/scene.gltf", glm::vec3(-15.0f, 4.0f, -5.0f),
+                                              bakeJellyfishPulse);
+    int anglerfishObject = worldStreamer->Add("resources/objects/anglerfish/scene.gltf", glm::vec3(0.0f, -3.0f, 70.0f));
+    int barrelsObject = worldStreamer->Add(BARRELS_MODEL, glm::vec3(-40.0f, 5.0f, -18.0f));
+    // the crowds play baked vertex animations, nothing else needs them
+    for (int object : {sharkObject, fishObject, fish2Object, jellyfishObject}) {
+        worldStreamer->BakeAnimation(object);
+    }
+    worldStreamer->SetVisibleAtLastShutdown(programState->visibleObjects);
 
     // setting lights
 
@@ -273,7 +676,6 @@ int main() {
     // METAL BOX
 
 
-    Shader boxShader("resources/shaders/box.vs", "resources/shaders/box.fs");
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -332,6 +734,7 @@ int main() {
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    rg::labelObject(GL_BUFFER, VBO, "metal box vertices");
 
     // position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -345,25 +748,28 @@ int main() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
+    // the box has the position/normal/texture coordinate layout of a model, so it doubles as the placeholder
+    placeholderVAO = VAO;
+
 
-    unsigned int boxDiffuseMap = loadTexture(FileSystem::getPath("resources/textures/metal/metal_diff.jpg").c_str());
-    unsigned int boxSpecularMap = loadTexture(FileSystem::getPath("resources/textures/metal/metal_spec.jpg").c_str());
+    unsigned int boxDiffuseMap = placeholderTexture;
+    unsigned int boxSpecularMap = placeholderTexture;
+    loadTextureAsync(assetLoader, FileSystem::getPath("resources/textures/metal/metal_diff.jpg"), false, boxDiffuseMap);
+    loadTextureAsync(assetLoader, FileSystem::getPath("resources/textures/metal/metal_spec.jpg"), false, boxSpecularMap);
 
     // tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
+    // done once the program is ready, see the warm-up before the render loop
     // -------------------------------------------------------------------------------------------
 
-    boxShader.use();
-    boxShader.setInt("material.diffuse", 0);
-    boxShader.setInt("material.specular", 1);
-
-
-    stbi_set_flip_vertically_on_load(false);
+    auto boxSamplers = [&boxShader]() {
+        boxShader.setInt("material.diffuse", 0);
+        boxShader.setInt("material.specular", 1);
+    };
 
 
     //********************************************************************************************************
     // SEAWEED
 
-    Shader glassShader("resources/shaders/blending.vs", "resources/shaders/blending.fs");
 
     float glassVertices[] = {
             -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, // bottom-left
@@ -389,6 +795,8 @@ int main() {
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, glassEBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(glassIndices), glassIndices, GL_STATIC_DRAW);
+    rg::labelObject(GL_BUFFER, glassVBO, "seaweed vertices");
+    rg::labelObject(GL_BUFFER, glassEBO, "seaweed indices");
 
     // position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -399,17 +807,16 @@ int main() {
 
     // loading glass texture
 
-    unsigned int glassTexture = loadTexture(FileSystem::getPath("resources/textures/transparent/seaweed.png").c_str());
+    unsigned int glassTexture = placeholderTexture;
+    loadTextureAsync(assetLoader, FileSystem::getPath("resources/textures/transparent/seaweed.png"), false, glassTexture);
 
-    glassShader.use();
-    glassShader.setInt("texture1", 0);
+    auto glassSamplers = [&glassShader]() { glassShader.setInt("texture1", 0); };
 
 
     //********************************************************************************************************
     // SKYBOX
 
 
-    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
 
     float skyboxVertices[] = {
             // positions
@@ -462,6 +869,7 @@ int main() {
     glBindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+    rg::labelObject(GL_BUFFER, skyboxVBO, "skybox vertices");
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
@@ -475,10 +883,15 @@ int main() {
                     FileSystem::getPath("resources/textures/skybox/aqua4_lf.jpg")
             };
 
-    unsigned int cubemapTexture = loadCubemap(faces);
+    unsigned int cubemapTexture = rg::createPlaceholderTexture(GL_TEXTURE_CUBE_MAP);
+    std::shared_ptr<unsigned int> loadedCubemap = std::make_shared<unsigned int>(0);
+    assetLoader.Submit([faces, loadedCubemap]() { *loadedCubemap = loadCubemap(faces); },
+                       [&cubemapTexture, loadedCubemap]() {
+                           glDeleteTextures(1, &cubemapTexture);
+                           cubemapTexture = *loadedCubemap;
+                       });
 
-    skyboxShader.use();
-    skyboxShader.setInt("skybox", 0);
+    auto skyboxSamplers = [&skyboxShader]() { skyboxShader.setInt("skybox", 0); };
 
 
 
@@ -486,29 +899,182 @@ int main() {
     // QUAD - normal and parallax mapping
 
 
-    Shader quadShader("resources/shaders/quad.vs", "resources/shaders/quad.fs");
 
     // load textures
     // -------------
-    unsigned int diffuseMap = loadTexture(FileSystem::getPath("resources/textures/iron/iron_diff.jpg").c_str());
-    unsigned int normalMap  = loadTexture(FileSystem::getPath("resources/textures/iron/iron_nor.jpg").c_str());
-    unsigned int heightMap  = loadTexture(FileSystem::getPath("resources/textures/iron/iron_disp.jpg").c_str());
+    unsigned int diffuseMap = placeholderTexture;
+    unsigned int normalMap  = placeholderTexture;
+    unsigned int heightMap  = placeholderTexture;
+    loadTextureAsync(assetLoader, FileSystem::getPath("resources/textures/iron/iron_diff.jpg"), true, diffuseMap);
+    loadTextureAsync(assetLoader, FileSystem::getPath("resources/textures/iron/iron_nor.jpg"), true, normalMap);
+    loadTextureAsync(assetLoader, FileSystem::getPath("resources/textures/iron/iron_disp.jpg"), true, heightMap);
 
     // shader configuration
     // --------------------
-    quadShader.use();
-    quadShader.setInt("diffuseMap", 0);
-    quadShader.setInt("normalMap", 1);
-    quadShader.setInt("depthMap", 2);
+    auto quadSamplers = [](Shader &shader) {
+        shader.setInt("diffuseMap", 0);
+        shader.setInt("normalMap", 1);
+        shader.setInt("depthMap", 2);
+    };
+
+
+
+    //********************************************************************************************************
+    // DYNAMIC RESOLUTION - the scene is drawn offscreen at a scale that keeps it within the GPU budget,
+    // then upscaled and sharpened to the window; ImGui goes on top at the window's own resolution
+
+    rg::ScaledRenderTarget sceneTarget;
+    sceneTarget.Resize(Width, Height);
+    rg::DynamicResolution dynamicResolution;
+    dynamicResolution.BudgetMs = programState->frameBudgetMs;
+
+    // the upscale draws a single triangle made up in the vertex shader, a vertex array still has to be bound
+    unsigned int fullscreenVAO;
+    glGenVertexArrays(1, &fullscreenVAO);
+    glBindVertexArray(fullscreenVAO);
+    rg::labelObject(GL_VERTEX_ARRAY, fullscreenVAO, "fullscreen triangle");
+    glBindVertexArray(0);
+    auto upscaleSamplers = [&upscaleShader]() { upscaleShader.setInt("scene", 0); };
+
+    // the tentacles are simulated on the update thread and streamed into a new region of this buffer every
+    // frame; the vertex array is pointed at the region before each draw
+    rg::StreamBuffer tentacleStream("tentacle vertices");
+    int tentacleStreamMode = rg::StreamBuffer::PersistentSupported() ? rg::STREAM_PERSISTENT : rg::STREAM_ORPHAN;
+    unsigned int tentacleVAO;
+    glGenVertexArrays(1, &tentacleVAO);
+    glBindVertexArray(tentacleVAO);
+    rg::labelObject(GL_VERTEX_ARRAY, tentacleVAO, "tentacles");
+    glBindVertexArray(0);
 
+    // skinned models read their pose from here, the buffer is backed before the first draw
+    boneBuffer = new rg::BoneBuffer();
+    boneBuffer->Upload({});
+    auto modelSetup = [](Shader &shader) {
+        return [&shader]() {
+            rg::BoneBuffer::BindBlock(shader.ID);
+            rg::setMorphSamplers(shader);
+        };
+    };
 
 
-    float step = 0.0f;
+
+    // only the skybox, the upscale and the program the placeholders are drawn with are needed for the
+    // first frame, they are finished now. Every other pipeline is built offscreen in the render loop as
+    // soon as its program is ready, and not drawn before that.
+    setupQuad();
+    rg::warmUpPipelines({
+            {&skyboxShader,  skyboxVAO,      false, true, GL_LEQUAL, skyboxSamplers},
+            {&upscaleShader, fullscreenVAO,  false, true, GL_ALWAYS, upscaleSamplers},
+            {&modelShader,   placeholderVAO, false, true, GL_LESS,   modelSetup(modelShader)}
+    });
+    pendingWarmups = {
+            {&boxShader,      VAO,            false, true,  GL_LESS, boxSamplers},
+            {&quadShader,     quadVAO,        false, false, GL_LESS, [&]() { quadSamplers(quadShader); }},
+            {&quadShaderMid,  quadVAO,        false, false, GL_LESS, [&]() { quadSamplers(quadShaderMid); }},
+            {&quadShaderFar,  quadVAO,        false, false, GL_LESS, [&]() { quadSamplers(quadShaderFar); }},
+            {&glassShader,    glassVAO,       true,  false, GL_LESS, glassSamplers},
+            {&modelShaderMid, placeholderVAO, false, true,  GL_LESS, modelSetup(modelShaderMid)},
+            {&modelShaderFar, placeholderVAO, false, true,  GL_LESS, modelSetup(modelShaderFar)},
+            {&crowdShader,    placeholderVAO, false, true,  GL_LESS, [&]() { rg::Crowd::SetSamplers(crowdShader); }},
+            {&impostorBakeShader, placeholderVAO, false, true, GL_LESS, nullptr},
+            {&impostorShader, fullscreenVAO,  false, false, GL_LESS, [&]() { rg::Impostor::SetSamplers(impostorShader); }},
+            {&tentacleShader, tentacleVAO,    false, false, GL_LESS, nullptr},
+            {&particleUpdateShader, fullscreenVAO, false, false, GL_LESS, nullptr},
+            {&particleShader, fullscreenVAO,  false, false, GL_LESS, [&]() { rg::ParticleSystem::SetSamplers(particleShader); }}
+    };
+
+    // models are requested last, the small textures and the skybox are ahead of them in the loader queue
+    worldStreamer->Update(programState->camera.Position, 0.0f);
+    double firstFrameMs = -1.0;
+    double fullSceneMs = -1.0;
+
+    // shading level of detail, one selector per drawn object so each keeps its own hysteresis
+    rg::ShadingLodSelector modelLods[MODEL_COUNT];
+    rg::ShadingLodSelector quadLod;
+    // and the mesh level of detail each is drawn at, kept for the hysteresis as well
+    int modelMeshLods[MODEL_COUNT] = {};
+    // whether far crowd instances are drawn as impostors
+    bool impostors = true;
+    int modelObjects[MODEL_COUNT] = {submarineObject, fishObject, fish2Object, jellyfishObject, sharkObject,
+                                     anglerfishObject, seashellObject, barrelsObject};
+
+    // schools around the shark and the fish, drawn from the animations baked into their models; the
+    // school of the other fish has no animation and only swims
+    rg::Crowd sharkCrowd("shark crowd", glm::vec3(10.0f, 12.0f, 20.0f), glm::vec3(80.0f, 12.0f, 80.0f), 41);
+    rg::Crowd fishCrowd("fish crowd", glm::vec3(8.0f, 3.0f, 15.0f), glm::vec3(40.0f, 8.0f, 40.0f), 43);
+    rg::Crowd fishSchool("fish school", glm::vec3(10.0f, 6.0f, 10.0f), glm::vec3(40.0f, 8.0f, 40.0f), 47,
+                         modelSwims[MODEL_FISH]);
+    // and a swarm around the jellyfish, pulsing through its morph targets
+    rg::Crowd jellyfishSwarm("jellyfish swarm", glm::vec3(-15.0f, 8.0f, -5.0f), glm::vec3(60.0f, 14.0f, 60.0f), 53);
+    jellyfishSwarm.SetMorphCycle(&jellyfishPulse);
+    for (rg::Crowd *crowd : {&sharkCrowd, &fishCrowd, &fishSchool, &jellyfishSwarm}) {
+        crowd->EnableImpostors(impostorBakeShader, impostorShader);
+    }
+    int sharkCrowdCount = 100;
+    int fishCrowdCount = 1000;
+    int fishSchoolCount = 500;
+    int jellyfishSwarmCount = 100;
+    glm::mat4 sharkCrowdOrientation = glm::mat4(1.0f);
+    glm::mat4 fishCrowdOrientation = glm::scale(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f),
+                                                            glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.8f));
+    glm::mat4 fishSchoolOrientation = glm::scale(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f),
+                                                             glm::vec3(1.0f, 0.0f, 0.0f)), glm::vec3(0.7f));
+    glm::mat4 jellyfishSwarmOrientation = glm::scale(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f),
+                                                                 glm::vec3(1.0f, 0.0f, 0.0f)), glm::vec3(0.15f));
+    // barrels rained onto the seabed, placed by the update stage
+    rg::Crowd barrelRainCrowd("barrel rain", glm::vec3(0.0f), glm::vec3(0.0f), 0);
+    int barrelRain = 0;
+
+    // marine snow around the camera, bubbles behind the submarine and sediment where debris lands
+    rg::ParticleSystem particles("particles");
+    int snowCount = 200000;
+    int bubbleCount = 20000;
+    int sedimentCount = 100000;
+    float lastParticleTime = -1.0f;
+
+    // everything the update stage reads, copied here on the render thread
+    auto frameInput = [&modelObjects, &barrelRain, worldStreamer](float frameSeconds) {
+        FrameInput input;
+        input.deltaTime = frameSeconds;
+        input.width = Width;
+        input.height = Height;
+        input.camera = programState->camera;
+        input.blink = blink;
+        input.jellyfishColor = jellyfishColor;
+        input.fall = fall;
+        input.barrelRain = barrelRain;
+        input.jellyfishPointLight = programState->jellyfishPointLight;
+        input.anglerfishPointLight = programState->anglerfishPointLight;
+        input.dirLight = programState->dirLight;
+        input.spotLight = programState->spotLight;
+        for (int i = 0; i < MODEL_COUNT; ++i) {
+            Model *model = worldStreamer->Get(modelObjects[i]);
+            input.boundsMin[i] = glm::vec3(-0.5f);
+            input.boundsMax[i] = glm::vec3(0.5f);
+            if (model && model->Ready()) {
+                input.skeletons[i] = model->skeleton;
+                if (!model->meshes.empty()) {
+                    input.boundsMin[i] = model->boundsMin;
+                    input.boundsMax[i] = model->boundsMax;
+                }
+            }
+        }
+        return input;
+    };
+
+    // the update thread animates and places everything for the next frame while this one is drawn
+    rg::FramePipeline<FrameInput, FramePacket> framePipeline(updateFrame);
+    framePipeline.Start("update thread");
+    framePipeline.Kick(frameInput(0.0f));
+    framePipeline.Wait();
 
     //********************************************************************************************************
     // RENDER LOOP
 
     while (!glfwWindowShouldClose(window)) {
+        rg::FrameProfiler::Instance().BeginFrame();
+        rg::ProfileZone frameZone("frame");
+        gpuTimers->BeginFrame();
 
         // per-frame time logic
         // --------------------
@@ -516,270 +1082,434 @@ int main() {
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        if(fall){
-            step-= 0.01;
+        {
+            rg::ProfileZone zone("asset streaming");
+            // pick up whatever the loader thread has finished, never waits
+            assetLoader.Poll();
+            worldStreamer->Update(programState->camera.Position, deltaTime);
+            if (!pendingWarmups.empty() && rg::warmUpReadyPipelines(pendingWarmups)) {
+                rg::ProgramCache::Instance().PrintReport();
+            }
+            // a row of impostor views per frame once a crowd's model is in, a whole atlas is 144 draws
+            if (impostors && !rg::pipelinePending(pendingWarmups, &impostorBakeShader)) {
+                const std::pair<rg::Crowd *, int> crowdModels[] = {
+                        {&sharkCrowd, sharkObject}, {&fishCrowd, fish2Object}, {&fishSchool, fishObject},
+                        {&jellyfishSwarm, jellyfishObject}};
+                for (const std::pair<rg::Crowd *, int> &crowd : crowdModels) {
+                    if (Model *model = worldStreamer->Get(crowd.second)) {
+                        crowd.first->BakeImpostor(*model, rg::Impostor::FRAMES);
+                    }
+                }
+            }
         }
 
 
-        // input
-        // -----
-        processInput(window);
-
-        if(blink){
-            anglerfishPointLight.ambient = glm::vec3(0.1f + 0.0005f*cos(currentFrame));
-            anglerfishPointLight.diffuse = glm::vec3(0.2f + 0.02f*tan(200*currentFrame));
-            anglerfishPointLight.specular = glm::vec3(0.005f*(1/tan(100*currentFrame)));
-        }else{
-            anglerfishPointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
-            anglerfishPointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
-            anglerfishPointLight.specular = glm::vec3(1.0, 1.0, 1.0);
-        }
-
-        switch(jellyfishColor){
-            case 0:
-                jellyfishPointLight.ambient = glm::vec3(0.3, 0.1, 0.1);
-                jellyfishPointLight.diffuse = glm::vec3(1.0, 0.6, 0.6);
-                break;
-            case 1:
-                jellyfishPointLight.ambient = glm::vec3(0.1, 0.3, 0.1);
-                jellyfishPointLight.diffuse = glm::vec3(0.6, 1.0, 0.6);
-                break;
-            case 2:
-                jellyfishPointLight.ambient = glm::vec3(0.1, 0.1, 0.3);
-                jellyfishPointLight.diffuse = glm::vec3(0.6, 0.6, 1.0);
-                break;
+        {
+            rg::ProfileZone zone("input");
+            // input
+            // -----
+            processInput(window);
         }
 
+        // the next frame is simulated while this one is drawn, so what is on screen lags the input by a frame
+        framePipeline.Kick(frameInput(deltaTime));
+        const FramePacket &packet = framePipeline.Current();
+        renderPacket = &packet;
 
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) Width / (float) Height, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
+        // every pass drawing a skinned model binds its palette from this
+        boneBuffer->Upload(packet.bonePalettes);
 
+        // the passes that get cheaper with fewer pixels decide the scale
+        float renderScale = dynamicResolution.Update(gpuTimers->FrameAverageMs({"upscale", "imgui"}));
+        sceneTarget.Resize(Width, Height);
+        sceneTarget.Bind(renderScale);
+        renderHeight = sceneTarget.ScaledHeight();
 
-        //light inside of jellyfish moves as jellyfish moves
-        jellyfishPointLight.position = glm::vec3(-15.0f, 4.0f + 4*sin(0.5*currentFrame), -5.0f);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
         // render metal box
 
-        boxShader.use();
-        setShaderLights(boxShader);
-
-        glm::mat4 model  = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-20.0f, 30.0f -40.0f + step, -20.0f));
-        model = glm::rotate(model, glm::radians(30.0f), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::rotate(model, glm::radians(10.0f), glm::vec3(0.0, 1.0, 0.0));
-        model = glm::rotate(model, glm::radians(40.0f), glm::vec3(0.0, 0.0, 1.0));
-//        model = glm::rotate(model, sin(currentFrame), glm::vec3(0.3, 0.0, 0.7));
-        model = glm::scale(model, glm::vec3(10.0f));
+        if (!rg::pipelinePending(pendingWarmups, &boxShader)) {
+            rg::ProfileZone zone("metal box");
+            rg::GpuZone gpuZone(*gpuTimers, "metal box", "box");
+            boxShader.use();
+            setShaderLights(boxShader, packet);
 
-        boxShader.setMat4("model", model);
-        boxShader.setMat4("view", view);
-        boxShader.setMat4("projection", projection);
+            boxShader.setMat4("model", packet.boxModel);
+            boxShader.setMat4("view", packet.view);
+            boxShader.setMat4("projection", packet.projection);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, boxDiffuseMap);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, boxSpecularMap);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, boxDiffuseMap);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, boxSpecularMap);
 
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+            glBindVertexArray(VAO);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
 
 
 
         // render models
 
-        modelShader.use();
-        setShaderLights(modelShader);
-
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-
-
-        //render submarine
-
-        model = glm::mat4(1.0f);
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::scale(model, glm::vec3(2.0f));
-
-        modelShader.setMat4("model", model);
-        submarineModel.Draw(modelShader);
-
-
-        //render fish
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(10.0f, 5.0f + 0.1*cos(currentFrame), 10.0f));
-        model = glm::rotate(model, glm::radians( -90.0f - 2*cos(currentFrame)), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::rotate(model, glm::radians(- 2*sin(7*currentFrame)), glm::vec3(0.0, 0.0, 1.0));
-        model = glm::scale(model, glm::vec3(0.7f));
-
-        modelShader.setMat4("model", model);
-        fishModel.Draw(modelShader);
-
-
-        //render fish2
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(8.0f, 2.0f + 0.5*cos(currentFrame), 15.0f));
-        model = glm::rotate(model, glm::radians(0.0f - 2*sin(currentFrame)), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::rotate(model, glm::radians(-90.0f + 8*sin(5*currentFrame)), glm::vec3(0.0, 1.0, 0.0));
-        model = glm::rotate(model, glm::radians(10.0f - 3*sin(currentFrame)), glm::vec3(0.0, 0.0, 1.0));
-        model = glm::scale(model, glm::vec3(0.8f));
-
-        modelShader.setMat4("model", model);
-        fish2Model.Draw(modelShader);
-
-
-        //render jellyfish
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-15.0f, 4.0f + 4*sin(0.5*currentFrame), -5.0f));
-        model = glm::rotate(model, glm::radians(-100.0f), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::rotate(model, glm::radians(-10.0f), glm::vec3(0.0, 1.0, 0.0));
-        model = glm::rotate(model, glm::radians(-20.0f), glm::vec3(0.0, 0.0, 1.0));
-        model = glm::scale(model, glm::vec3(0.2f));
+        frameTriangles = rg::TriangleCount();
+        meshLodSelector.SetView(packet.cameraPosition, glm::radians(packet.cameraZoom), renderHeight);
+        for (Shader *shader : modelShaders) {
+            if (rg::pipelinePending(pendingWarmups, shader)) {
+                continue;
+            }
+            shader->use();
+            setShaderLights(*shader, packet);
+
+            shader->setMat4("projection", packet.projection);
+            shader->setMat4("view", packet.view);
+            shader->setFloat("time", packet.time);
+        }
 
-        modelShader.setMat4("model", model);
-        jellyfishModel.Draw(modelShader);
+        for (const ModelDraw &draw : packet.models) {
+            drawModel(draw, worldStreamer->Get(modelObjects[draw.model]), modelShaders, modelLods[draw.model],
+                      modelMeshLods[draw.model]);
+        }
 
+        if (!rg::pipelinePending(pendingWarmups, &crowdShader)) {
+            rg::ProfileZone zone("crowds");
+            rg::GpuZone gpuZone(*gpuTimers, "crowds", "models");
+            crowdShader.use();
+            setShaderLights(crowdShader, packet);
+            crowdShader.setMat4("projection", packet.projection);
+            crowdShader.setMat4("view", packet.view);
+            // the crowds switch to impostors once both programs are ready
+            meshLodSelector.Impostors = impostors && !rg::pipelinePending(pendingWarmups, &impostorBakeShader) &&
+                                        !rg::pipelinePending(pendingWarmups, &impostorShader);
+            if (meshLodSelector.Impostors) {
+                impostorShader.use();
+                setShaderLights(impostorShader, packet);
+                impostorShader.setMat4("projection", packet.projection);
+                impostorShader.setMat4("view", packet.view);
+            }
+            sharkCrowd.SetCount(sharkCrowdCount);
+            fishCrowd.SetCount(fishCrowdCount);
+            fishSchool.SetCount(fishSchoolCount);
+            jellyfishSwarm.SetCount(jellyfishSwarmCount);
+            if (Model *shark = worldStreamer->Get(sharkObject)) {
+                sharkCrowd.Draw(crowdShader, *shark, modelSwimBodies[MODEL_SHARK], sharkCrowdOrientation,
+                                packet.time, meshLodSelector);
+                frameTriangles += sharkCrowd.Triangles();
+            }
+            if (Model *fish = worldStreamer->Get(fish2Object)) {
+                fishCrowd.Draw(crowdShader, *fish, modelSwimBodies[MODEL_FISH2], fishCrowdOrientation,
+                               packet.time, meshLodSelector);
+                frameTriangles += fishCrowd.Triangles();
+            }
+            if (Model *fish = worldStreamer->Get(fishObject)) {
+                fishSchool.Draw(crowdShader, *fish, modelSwimBodies[MODEL_FISH], fishSchoolOrientation,
+                                packet.time, meshLodSelector);
+                frameTriangles += fishSchool.Triangles();
+            }
+            if (Model *jellyfish = worldStreamer->Get(jellyfishObject)) {
+                jellyfishSwarm.Draw(crowdShader, *jellyfish, modelSwimBodies[MODEL_JELLYFISH],
+                                    jellyfishSwarmOrientation, packet.time, meshLodSelector);
+                frameTriangles += jellyfishSwarm.Triangles();
+            }
+            barrelRainCrowd.Place(packet.rainedBarrels);
+            if (Model *barrels = worldStreamer->Get(barrelsObject)) {
+                barrelRainCrowd.Draw(crowdShader, *barrels, modelSwimBodies[MODEL_BARRELS], glm::mat4(1.0f),
+                                     packet.time, meshLodSelector);
+                frameTriangles += barrelRainCrowd.Triangles();
+            }
+        }
 
-        //render shark
+        // every model reported its size on screen while drawing
+        {
+            rg::ProfileZone zone("texture streaming");
+            textureStreamer->Update();
+        }
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(10.0f, 10.0f + 0.8*sin(0.2*currentFrame), 20.0f));
-        model = glm::rotate(model, glm::radians(- 4*cos(3*currentFrame)), glm::vec3(0.0, 1.0, 0.0));
-        model = glm::rotate(model, glm::radians(-5.0f), glm::vec3(1.0, 0.0, 0.0));
 
-        modelShader.setMat4("model", model);
-        sharkModel.Draw(modelShader);
 
+        //render quad
 
-        //render anglerfish
+        glDisable(GL_CULL_FACE);
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(0.0f, -3.0f, 70.0f));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
-        model = glm::scale(model, glm::vec3(0.1f));
+        // render parallax-mapped quad
+        // the quad spans [-1, 1] in x and y
+        Shader &quadLodShader = *quadShaders[selectShadingLod(quadLod, packet.quadModel, glm::vec3(0.0f),
+                                                              glm::sqrt(2.0f))];
+        if (!rg::pipelinePending(pendingWarmups, &quadLodShader)) {
+            rg::ProfileZone zone("quad");
+            rg::GpuZone gpuZone(*gpuTimers, "parallax quad", "quad");
+            quadLodShader.use();
+            quadLodShader.setMat4("projection", packet.projection);
+            quadLodShader.setMat4("view", packet.view);
+            quadLodShader.setMat4("model", packet.quadModel);
+            quadLodShader.setVec3("viewPos", packet.cameraPosition);
+            quadLodShader.setVec3("lightPos", packet.jellyfishPointLight.position);
+            quadLodShader.setVec3("lightColor", packet.jellyfishPointLight.ambient);
+            quadLodShader.setFloat("heightScale", heightScale);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, diffuseMap);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, normalMap);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, heightMap);
+
+            renderQuad();
+        }
 
-        modelShader.setMat4("model", model);
-        anglerfishModel.Draw(modelShader);
 
+        glEnable(GL_CULL_FACE);
 
-        //render seashell
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-14.0f, 30.0 -38.0f + step, -17.0f));
-        model = glm::rotate(model, glm::radians(10.0f), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::rotate(model, glm::radians(60.0f), glm::vec3(0.0, 1.0, 0.0));
-        model = glm::scale(model, glm::vec3(0.05f));
+        // render skybox
 
-        modelShader.setMat4("model", model);
-        seashellModel.Draw(modelShader);
+        {
+            rg::ProfileZone zone("skybox");
+            rg::GpuZone gpuZone(*gpuTimers, "skybox", "skybox");
+            glDepthFunc(GL_LEQUAL);
+            skyboxShader.use();
+            glm::mat4 skyboxView = glm::mat4(glm::mat3(packet.view)); // remove translation from the view matrix
+            skyboxShader.setMat4("view", skyboxView);
+            skyboxShader.setMat4("projection", packet.projection);
+            // skybox cube
+            glBindVertexArray(skyboxVAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glBindVertexArray(0);
+            glDepthFunc(GL_LESS); // set depth function back to default
+        }
 
 
-        //render barrels
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-40.0f, 30.0f -25.0f + step, -18.0f));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::rotate(model, glm::radians(10.0f), glm::vec3(0.0, 1.0, 0.0));
+        // render tentacles
 
-        modelShader.setMat4("model", model);
-        barrelsModel.Draw(modelShader);
+        if (!rg::pipelinePending(pendingWarmups, &tentacleShader)) {
+            rg::ProfileZone zone("tentacles");
+            rg::GpuZone gpuZone(*gpuTimers, "tentacles", "tentacles");
+            tentacleShader.use();
+            tentacleShader.setMat4("projection", packet.projection);
+            tentacleShader.setMat4("view", packet.view);
+            tentacleShader.setVec3("lightPos", packet.jellyfishPointLight.position);
+            tentacleShader.setVec3("lightColor", packet.jellyfishPointLight.diffuse);
+            drawTentacles(tentacleStream, (rg::StreamMode) tentacleStreamMode, tentacleVAO, packet.tentacleVertices,
+                          packet.tentacleParticles);
+        }
 
 
 
-        //render quad
+        // render seaweed
 
         glDisable(GL_CULL_FACE);
 
-        quadShader.use();
-        quadShader.setMat4("projection", projection);
-        quadShader.setMat4("view", view);
-        // render parallax-mapped quad
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-20.0f, 30.0f -10.0f + step, -15.0f));
-        model = glm::rotate(model, glm::radians(-60.0f), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(10.0f), glm::vec3(1.0, 0.0, 1.0));
-        model = glm::scale(model, glm::vec3(3.0f));
-        quadShader.setMat4("model", model);
-        quadShader.setVec3("viewPos", programState->camera.Position);
-        quadShader.setVec3("lightPos", jellyfishPointLight.position);
-        quadShader.setVec3("lightColor", jellyfishPointLight.ambient);
-        quadShader.setFloat("heightScale", heightScale);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, normalMap);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, heightMap);
-
-        renderQuad();
-
-
-        glEnable(GL_CULL_FACE);
+        if (!rg::pipelinePending(pendingWarmups, &glassShader)) {
+            rg::ProfileZone zone("seaweed");
+            rg::GpuZone gpuZone(*gpuTimers, "seaweed", "seaweed");
+            glassShader.use();
 
+            glassShader.setMat4("projection", packet.projection);
+            glassShader.setMat4("view", packet.view);
+            glassShader.setMat4("model", packet.seaweedModel);
 
-        // render skybox
 
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        glm::mat4 skyboxView = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        glm::mat4 skyboxProjection = glm::perspective(glm::radians(programState->camera.Zoom), (float)Width / (float)Height, 0.1f, 100.0f);
-        skyboxShader.setMat4("view", skyboxView);
-        skyboxShader.setMat4("projection", skyboxProjection);
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, glassTexture);
 
+            glBindVertexArray(glassVAO);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        }
 
+        glEnable(GL_CULL_FACE);
 
-        // render seaweed
 
-        glDisable(GL_CULL_FACE);
 
-        glassShader.use();
+        // render particles, simulated first; they fade out against a copy of the depth drawn so far
+
+        if (!rg::pipelinePending(pendingWarmups, &particleUpdateShader) &&
+            !rg::pipelinePending(pendingWarmups, &particleShader)) {
+            rg::ProfileZone zone("particles");
+            rg::GpuZone gpuZone(*gpuTimers, "particles", "particles");
+            float particleSeconds = lastParticleTime < 0.0f ? 0.0f : packet.time - lastParticleTime;
+            lastParticleTime = packet.time;
+            rg::ParticleEmitters emitters;
+            emitters.cameraPosition = packet.cameraPosition;
+            emitters.bubbleSources[0] = packet.bubbleSources[0];
+            emitters.bubbleSources[1] = packet.bubbleSources[1];
+            emitters.impacts = packet.particleImpacts;
+            particles.SetCounts(snowCount, bubbleCount, sedimentCount);
+            particles.Update(particleUpdateShader, emitters, glm::clamp(particleSeconds, 0.0f, 0.1f), packet.time);
+
+            sceneTarget.CopyDepth();
+            particleShader.use();
+            setShaderLights(particleShader, packet);
+            particleShader.setMat4("projection", packet.projection);
+            particleShader.setMat4("view", packet.view);
+            particleShader.setVec3("cameraPosition", packet.cameraPosition);
+            particleShader.setVec3("snowBox", emitters.snowBox);
+            particles.Draw(particleShader, sceneTarget.DepthTexture(),
+                           glm::vec2(1.0f / sceneTarget.Width(), 1.0f / sceneTarget.Height()), NEAR_PLANE,
+                           FAR_PLANE);
+        }
 
-        glassShader.setMat4("projection", projection);
-        glassShader.setMat4("view", view);
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-20.0f, 30.0f -9.5f + step, -15.0f));
-        model = glm::rotate(model, glm::radians(200.0f), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::rotate(model, glm::radians(30.0f), glm::vec3(0.0, 1.0, 0.0));
-        model = glm::rotate(model, glm::radians(-15.0f), glm::vec3(0.0, 0.0, 1.0));
-        model = glm::scale(model, glm::vec3(4.0f));
 
-        glassShader.setMat4("model", model);
+        // upscale to the window
 
+        {
+            rg::ProfileZone zone("upscale");
+            rg::GpuZone gpuZone(*gpuTimers, "upscale", "upscale");
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, Width, Height);
+            glDepthFunc(GL_ALWAYS);
+            upscaleShader.use();
+            float targetWidth = (float) sceneTarget.Width(), targetHeight = (float) sceneTarget.Height();
+            upscaleShader.setVec2("uvScale", glm::vec2(sceneTarget.ScaledWidth() / targetWidth,
+                                                       sceneTarget.ScaledHeight() / targetHeight));
+            upscaleShader.setVec2("texelSize", glm::vec2(1.0f / targetWidth, 1.0f / targetHeight));
+            upscaleShader.setVec2("maxCoords", glm::vec2((sceneTarget.ScaledWidth() - 0.5f) / targetWidth,
+                                                         (sceneTarget.ScaledHeight() - 0.5f) / targetHeight));
+            upscaleShader.setFloat("sharpness", dynamicResolution.UpscaleSharpness());
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, sceneTarget.Texture());
+            glBindVertexArray(fullscreenVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+            glDepthFunc(GL_LESS);
+        }
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, glassTexture);
 
-        glBindVertexArray(glassVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-        glEnable(GL_CULL_FACE);
+        if (programState->ImGuiEnabled) {
+            rg::ProfileZone zone("imgui");
+            rg::GpuZone gpuZone(*gpuTimers, "imgui", "imgui");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+            profilerOverlay.Draw();
+            ImGui::Begin("Resolution");
+            ImGui::Checkbox("dynamic", &dynamicResolution.Enabled);
+            ImGui::SliderFloat("GPU budget (ms)", &dynamicResolution.BudgetMs, 2.0f, 33.0f);
+            ImGui::SliderFloat("sharpness", &dynamicResolution.Sharpness, 0.0f, 1.0f);
+            ImGui::Text("scale %.2f, %dx%d of %dx%d", dynamicResolution.Scale(), sceneTarget.ScaledWidth(),
+                        sceneTarget.ScaledHeight(), sceneTarget.Width(), sceneTarget.Height());
+            ImGui::End();
+            ImGui::Begin("Crowds");
+            ImGui::SliderInt("sharks", &sharkCrowdCount, 0, 4000);
+            ImGui::SliderInt("fish", &fishCrowdCount, 0, 10000);
+            ImGui::SliderInt("swimming fish", &fishSchoolCount, 0, 10000);
+            ImGui::SliderInt("jellyfish", &jellyfishSwarmCount, 0, 4000);
+            ImGui::End();
+            ImGui::Begin("Mesh LOD");
+            ImGui::Checkbox("levels of detail", &meshLodSelector.Enabled);
+            ImGui::SliderFloat("error (pixels)", &meshLodSelector.Threshold, 0.25f, 8.0f);
+            ImGui::SliderFloat("hysteresis", &meshLodSelector.Hysteresis, 0.0f, 0.5f);
+            ImGui::Checkbox("impostors", &impostors);
+            ImGui::SliderFloat("impostor size (pixels)", &meshLodSelector.ImpostorPixels, 8.0f, 256.0f);
+            ImGui::Text("%lld triangles submitted, %lld at full detail (%.0f%%)", frameTriangles.submitted,
+                        frameTriangles.full, 100.0 * frameTriangles.submitted / std::max(frameTriangles.full, 1LL));
+            ImGui::End();
+            ImGui::Begin("Particles");
+            ImGui::SliderInt("marine snow", &snowCount, 0, 1000000);
+            ImGui::SliderInt("bubbles", &bubbleCount, 0, 100000);
+            ImGui::SliderInt("sediment", &sedimentCount, 0, 500000);
+            ImGui::SliderFloat("soft fade", &particles.FadeDistance, 0.01f, 4.0f);
+            ImGui::Text("%d particles, %.2f ms on the GPU", particles.Total(), gpuTimers->PassAverageMs("particles"));
+            ImGui::End();
+            ImGui::Begin("Debris");
+            ImGui::Checkbox("fall (F)", &fall);
+            ImGui::SliderInt("barrel rain", &barrelRain, 0, 5000);
+            const rg::RigidBodyWorld::Stats &debrisStats = packet.debrisStats;
+            ImGui::Text("%d bodies, %d awake in %d islands on %d threads", debrisStats.bodies, debrisStats.awake,
+                        debrisStats.islands, workerPool->Threads());
+            ImGui::Text("largest island %d bodies", debrisStats.largestIsland);
+            ImGui::Text("%d pairs, %d contacts", debrisStats.pairs, debrisStats.contacts);
+            ImGui::Text("broadphase %.2f ms, narrowphase %.2f ms, solve %.2f ms", debrisStats.broadphaseMs,
+                        debrisStats.narrowphaseMs, debrisStats.solveMs);
+            if (packet.barrelRainHeld) {
+                ImGui::Text("rain held: %.1f ms per step, %.1f ms budget", debrisStepMs(debrisStats),
+                            DEBRIS_BUDGET_MS);
+            }
+            ImGui::End();
+            ImGui::Begin("Tentacles");
+            int streamMode = tentacleStreamMode;
+            ImGui::RadioButton("orphan", &tentacleStreamMode, rg::STREAM_ORPHAN);
+            if (rg::StreamBuffer::PersistentSupported()) {
+                ImGui::SameLine();
+                ImGui::RadioButton("persistent", &tentacleStreamMode, rg::STREAM_PERSISTENT);
+            }
+            if (tentacleStreamMode != streamMode) {
+                tentacleStream.ResetStats();
+            }
+            ImGui::Text("%d x %d particles on %d threads", TENTACLE_COUNT, packet.tentacleParticles,
+                        workerPool->Threads());
+            if (packet.tentacleStepSeconds > 0.0) {
+                ImGui::Text("step: %.0f particles/ms",
+                            packet.tentacleParticleSteps / (packet.tentacleStepSeconds * 1000.0));
+            }
+            if (tentacleStream.UploadSeconds() > 0.0) {
+                ImGui::Text("upload: %.0f MB/s, %d waits",
+                            tentacleStream.UploadedBytes() / tentacleStream.UploadSeconds() / 1e6, tentacleStream.Waits());
+            }
+            ImGui::End();
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
+        {
+            rg::ProfileZone zone("swap");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        rg::pollOpenGLErrors(__FILE__, __LINE__);
 
+        {
+            rg::ProfileZone zone("wait for update");
+            framePipeline.Wait();
+        }
 
+        if (firstFrameMs < 0.0) {
+            firstFrameMs = rg::millisecondsSince(startupBegin);
+            rg::StartupProfiler::Instance().Instant("first frame");
+        }
+        if (fullSceneMs < 0.0 && pendingWarmups.empty() && assetLoader.Pending() == 0 && worldStreamer->Complete()) {
+            fullSceneMs = rg::millisecondsSince(startupBegin);
+            std::cout << "[Startup] first frame after " << firstFrameMs << " ms, full scene after " << fullSceneMs
+                      << " ms" << std::endl;
+            rg::MeshCache::Instance().PrintReport();
+            rg::StartupProfiler::Instance().Instant("full scene");
+            rg::StartupProfiler::Instance().Finish();
+            if (benchmark) {
+                benchmark->Start(*gpuTimers);
+            }
+        }
+        if (benchmark && benchmark->Frame(deltaTime, *gpuTimers, frameTriangles)) {
+            glfwSetWindowShouldClose(window, true);
+        }
+    }
+    framePipeline.Stop();
+    delete workerPool;
+    std::cout << "[Simulation] " << simulationClock.Steps() << " steps of " << SIMULATION_STEP * 1000.0 << " ms, "
+              << simulationClock.DroppedSeconds() << " s dropped after stalls" << std::endl;
+
+    // what is on screen now is loaded first on the next start
+    glm::mat4 lastViewProjection = glm::perspective(glm::radians(programState->camera.Zoom),
+                                                    (float) Width / (float) Height, NEAR_PLANE, FAR_PLANE) *
+                                   programState->camera.GetViewMatrix();
+    programState->visibleObjects = worldStreamer->VisibleObjects(lastViewProjection);
+
+    assetLoader.Stop();
+    // closed before the scene was complete, write what there is
+    rg::StartupProfiler::Instance().Finish();
+    worldStreamer->PrintReport();
+    delete worldStreamer;
+    textureStreamer->PrintReport();
+    delete textureStreamer;
 
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
@@ -794,6 +1524,18 @@ int main() {
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVBO);
 
+    glDeleteVertexArrays(1, &fullscreenVAO);
+    glDeleteVertexArrays(1, &tentacleVAO);
+    tentacleStream.Release();
+    sceneTarget.Release();
+    sharkCrowd.Release();
+    barrelRainCrowd.Release();
+    particles.Release();
+    fishCrowd.Release();
+    fishSchool.Release();
+    jellyfishSwarm.Release();
+    programState->frameBudgetMs = dynamicResolution.BudgetMs;
+
     glDeleteTextures(1, &boxDiffuseMap);
     glDeleteTextures(1,&boxSpecularMap);
     glDeleteTextures(1, &glassTexture);
@@ -801,11 +1543,21 @@ int main() {
     glDeleteTextures(1, &normalMap);
     glDeleteTextures(1, &heightMap);
     glDeleteTextures(1, &cubemapTexture);
+    glDeleteTextures(1, &placeholderTexture);
+    glDeleteTextures(1, &placeholderTextureArray);
 
 
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
 
+    delete gpuTimers;
+    boneBuffer->Release();
+    delete boneBuffer;
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -891,15 +1643,24 @@ unsigned int loadCubemap(vector<std::string> faces)
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    rg::labelObject(GL_TEXTURE, textureID, faces.empty() ? "cubemap" : "cubemap " + faces[0]);
 
     stbi_set_flip_vertically_on_load(false);
 
-    int width, height, nrChannels;
+    int width = 0, height = 0, nrChannels = 0;
     for (unsigned int i = 0; i < faces.size(); i++)
     {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+        unsigned char *data;
+        {
+            rg::StartupZone zone("stbi_load", "texture");
+            data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+            zone.Arg("path", faces[i]).Arg("width", width).Arg("height", height).Arg("channels", nrChannels);
+        }
         if (data)
         {
+            rg::StartupZone zone("upload cubemap face", "texture");
+            zone.Arg("path", faces[i]).Arg("width", width).Arg("height", height)
+                .Arg("bytes", (long long) width * height * nrChannels);
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
             stbi_image_free(data);
         }
@@ -926,10 +1687,18 @@ unsigned int loadTexture(char const * path)
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+    int width = 0, height = 0, nrComponents = 0;
+    unsigned char *data;
+    {
+        rg::StartupZone zone("stbi_load", "texture");
+        data = stbi_load(path, &width, &height, &nrComponents, 0);
+        zone.Arg("path", path).Arg("width", width).Arg("height", height).Arg("channels", nrComponents);
+    }
     if (data)
     {
+        rg::StartupZone zone("upload texture", "texture");
+        zone.Arg("path", path).Arg("width", width).Arg("height", height)
+            .Arg("bytes", (long long) width * height * nrComponents);
         GLenum format;
         if (nrComponents == 1)
             format = GL_RED;
@@ -939,6 +1708,7 @@ unsigned int loadTexture(char const * path)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
+        rg::labelObject(GL_TEXTURE, textureID, path);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -953,6 +1723,8 @@ unsigned int loadTexture(char const * path)
     {
         std::cout << "Texture failed to load at path: " << path << std::endl;
         stbi_image_free(data);
+        glDeleteTextures(1, &textureID);
+        textureID = 0;
     }
 
     return textureID;
@@ -962,8 +1734,16 @@ unsigned int loadTexture(char const * path)
 void renderQuad()
 {
     if (quadVAO == 0)
-    {
+        setupQuad();
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindVertexArray(0);
+}
 
+void setupQuad()
+{
+    if (quadVAO == 0)
+    {
 
         // positions
         glm::vec3 pos1(-1.0f,  1.0f, 0.0f);
@@ -1037,6 +1817,7 @@ void renderQuad()
         glBindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+        rg::labelObject(GL_BUFFER, quadVBO, "parallax quad vertices");
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
@@ -1048,45 +1829,722 @@ void renderQuad()
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(11 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
 }
 
-void setShaderLights(Shader &shader){
-    shader.setVec3("pointLights[0].position", programState->jellyfishPointLight.position);
-    shader.setVec3("pointLights[0].ambient", programState->jellyfishPointLight.ambient);
-    shader.setVec3("pointLights[0].diffuse", programState->jellyfishPointLight.diffuse);
-    shader.setVec3("pointLights[0].specular", programState->jellyfishPointLight.specular);
-    shader.setFloat("pointLights[0].constant", programState->jellyfishPointLight.constant);
-    shader.setFloat("pointLights[0].linear", programState->jellyfishPointLight.linear);
-    shader.setFloat("pointLights[0].quadratic", programState->jellyfishPointLight.quadratic);
-
-    shader.setVec3("pointLights[1].position", programState->anglerfishPointLight.position);
-    shader.setVec3("pointLights[1].ambient", programState->anglerfishPointLight.ambient);
-    shader.setVec3("pointLights[1].diffuse", programState->anglerfishPointLight.diffuse);
-    shader.setVec3("pointLights[1].specular", programState->anglerfishPointLight.specular);
-    shader.setFloat("pointLights[1].constant", programState->anglerfishPointLight.constant);
-    shader.setFloat("pointLights[1].linear", programState->anglerfishPointLight.linear);
-    shader.setFloat("pointLights[1].quadratic", programState->anglerfishPointLight.quadratic);
-
-    shader.setVec3("viewPosition", programState->camera.Position);
+// where the debris lies until it falls, the seashell and the barrels on top of the box
+glm::mat4 debrisPlacement(Debris object) {
+    glm::mat4 model = glm::mat4(1.0f);
+    switch (object) {
+        case DEBRIS_BOX:
+            model = glm::translate(model, glm::vec3(-20.0f, 30.0f - 40.0f, -20.0f));
+            model = glm::rotate(model, glm::radians(30.0f), glm::vec3(1.0, 0.0, 0.0));
+            model = glm::rotate(model, glm::radians(10.0f), glm::vec3(0.0, 1.0, 0.0));
+            model = glm::rotate(model, glm::radians(40.0f), glm::vec3(0.0, 0.0, 1.0));
+            model = glm::scale(model, glm::vec3(10.0f));
+            break;
+        case DEBRIS_SEASHELL:
+            model = glm::translate(model, glm::vec3(-14.0f, 30.0f - 38.0f, -17.0f));
+            model = glm::rotate(model, glm::radians(10.0f), glm::vec3(1.0, 0.0, 0.0));
+            model = glm::rotate(model, glm::radians(60.0f), glm::vec3(0.0, 1.0, 0.0));
+            model = glm::scale(model, glm::vec3(0.05f));
+            break;
+        case DEBRIS_BARRELS:
+            model = glm::translate(model, glm::vec3(-40.0f, 30.0f - 25.0f, -18.0f));
+            model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
+            model = glm::rotate(model, glm::radians(10.0f), glm::vec3(0.0, 1.0, 0.0));
+            break;
+        case DEBRIS_QUAD:
+            model = glm::translate(model, glm::vec3(-20.0f, 30.0f - 10.0f, -15.0f));
+            model = glm::rotate(model, glm::radians(-60.0f), glm::vec3(1.0, 0.0, 0.0));
+            model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::rotate(model, glm::radians(10.0f), glm::vec3(1.0, 0.0, 1.0));
+            model = glm::scale(model, glm::vec3(3.0f));
+            break;
+        case DEBRIS_SEAWEED:
+            model = glm::translate(model, glm::vec3(-20.0f, 30.0f - 9.5f, -15.0f));
+            model = glm::rotate(model, glm::radians(200.0f), glm::vec3(1.0, 0.0, 0.0));
+            model = glm::rotate(model, glm::radians(30.0f), glm::vec3(0.0, 1.0, 0.0));
+            model = glm::rotate(model, glm::radians(-15.0f), glm::vec3(0.0, 0.0, 1.0));
+            model = glm::scale(model, glm::vec3(4.0f));
+            break;
+        default:
+            break;
+    }
+    return model;
+}
+
+// model space bounds of what the debris is drawn with; a model that isn't loaded when things start
+// falling gets the placeholder's box and keeps it
+void debrisBounds(Debris object, const FrameInput &input, glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+    switch (object) {
+        case DEBRIS_SEASHELL:
+            boundsMin = input.boundsMin[MODEL_SEASHELL];
+            boundsMax = input.boundsMax[MODEL_SEASHELL];
+            break;
+        case DEBRIS_BARRELS:
+            boundsMin = input.boundsMin[MODEL_BARRELS];
+            boundsMax = input.boundsMax[MODEL_BARRELS];
+            break;
+        case DEBRIS_QUAD:
+            // the parallax quad spans -1..1 in its plane
+            boundsMin = glm::vec3(-1.0f, -1.0f, 0.0f);
+            boundsMax = glm::vec3(1.0f, 1.0f, 0.0f);
+            break;
+        case DEBRIS_SEAWEED:
+            boundsMin = glm::vec3(-0.5f, -0.5f, -0.5f);
+            boundsMax = glm::vec3(0.5f, 0.5f, -0.5f);
+            break;
+        default:
+            // the box's cube
+            boundsMin = glm::vec3(-0.5f);
+            boundsMax = glm::vec3(0.5f);
+            break;
+    }
+}
+
+// count barrels scattered over the sky above the seabed next to the box, tumbling as they start
+void rainBarrels(rg::RigidBodyWorld &world, std::vector<glm::mat4> &offsets, std::mt19937 &random,
+                 glm::vec3 boundsMin, glm::vec3 boundsMax, int count) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < count; ++i) {
+        glm::vec3 position(-30.0f + 60.0f * (unit(random) - 0.5f), world.GroundHeight + 40.0f + 20.0f * unit(random),
+                           -18.0f + 60.0f * (unit(random) - 0.5f));
+        glm::vec3 tiltAxis = glm::normalize(glm::vec3(unit(random) - 0.5f, 0.0f, unit(random) - 0.5f) +
+                                            glm::vec3(1e-3f, 0.0f, 0.0f));
+        glm::mat4 placement = glm::translate(glm::mat4(1.0f), position);
+        placement = glm::rotate(placement, unit(random) * 6.2831853f, glm::vec3(0.0f, 1.0f, 0.0f));
+        placement = glm::rotate(placement, unit(random) * 1.5f, tiltAxis);
+        placement = glm::rotate(placement, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        placement = glm::scale(placement, glm::vec3(BARREL_RAIN_SCALE));
+        rg::BoxCollider box = rg::boxFromBounds(boundsMin, boundsMax, placement);
+        int body = world.Add(box, 1.0f);
+        offsets.resize(body + 1);
+        offsets[body] = box.offset;
+    }
+}
+
+// update stage: runs the simulation steps the frame's time adds up to, then animates the lights and
+// places every object at the simulation time being drawn. Runs on the update thread, so it touches
+// neither GL nor anything the render thread writes.
+void updateFrame(const FrameInput &input, FramePacket &packet) {
+    int steps = simulationClock.Advance(input.deltaTime);
+    // the state after n steps is the one at n steps' time, the tentacles start hanging from where the roots are
+    std::int64_t stepsBefore = simulationClock.Steps() - steps;
+    if (tentacles.Tentacles() == 0) {
+        tentacleAnchors((float) (stepsBefore * SIMULATION_STEP), tentacleRoots);
+        tentacles.Reset(tentacleRoots, TENTACLE_PARTICLES, TENTACLE_SEGMENT);
+    }
+    packet.particleImpacts.clear();
+    // things start falling from where they lie, and are back there once F is pressed again
+    if (input.fall && debris.Count() == 0) {
+        debrisOffsets.resize(DEBRIS_COUNT);
+        for (int i = 0; i < DEBRIS_COUNT; ++i) {
+            glm::vec3 boundsMin, boundsMax;
+            debrisBounds((Debris) i, input, boundsMin, boundsMax);
+            rg::BoxCollider box = rg::boxFromBounds(boundsMin, boundsMax, debrisPlacement((Debris) i));
+            debris.Add(box, 1.0f);
+            debrisOffsets[i] = box.offset;
+        }
+    } else if (!input.fall && debris.Count() > 0) {
+        debris.Clear();
+        debrisOffsets.clear();
+    }
+    packet.barrelRainHeld = false;
+    for (int i = 0; i < steps; ++i) {
+        if (debris.Count() > 0) {
+            int rain = std::min(input.barrelRain - (debris.Count() - DEBRIS_COUNT), BARREL_RAIN_PER_STEP);
+            if (rain > 0 && debrisStepMs(debris.LastStep()) > DEBRIS_BUDGET_MS) {
+                packet.barrelRainHeld = true;
+            } else if (rain > 0) {
+                rainBarrels(debris, debrisOffsets, barrelRainRandom, input.boundsMin[MODEL_BARRELS],
+                            input.boundsMax[MODEL_BARRELS], rain);
+            }
+            debris.Step((float) SIMULATION_STEP, *workerPool);
+            for (const rg::RigidBodyWorld::Impact &impact : debris.Impacts()) {
+                if ((int) packet.particleImpacts.size() < rg::ParticleSystem::MAX_IMPACTS) {
+                    packet.particleImpacts.push_back(glm::vec4(impact.point, impact.speed));
+                }
+            }
+        }
+        float stepTime = (float) ((stepsBefore + i + 1) * SIMULATION_STEP);
+        tentacleAnchors(stepTime, tentacleRoots);
+        tentacles.Step((float) SIMULATION_STEP, stepTime, tentacleRoots, *workerPool);
+    }
+    float alpha = simulationClock.Alpha();
+    tentacles.Interpolate(alpha, packet.tentacleVertices, *workerPool);
+    packet.tentacleParticles = tentacles.ParticlesPerTentacle();
+    packet.tentacleParticleSteps = tentacles.ParticleSteps();
+    packet.tentacleStepSeconds = tentacles.StepSeconds();
+    packet.debrisStats = debris.LastStep();
+    float currentFrame = (float) simulationClock.Time();
+
+    // view/projection transformations
+    Camera camera = input.camera;
+    packet.time = currentFrame;
+    packet.cameraPosition = camera.Position;
+    packet.cameraFront = camera.Front;
+    packet.cameraZoom = camera.Zoom;
+    packet.view = camera.GetViewMatrix();
+    packet.projection = glm::perspective(glm::radians(camera.Zoom), (float) input.width / (float) input.height,
+                                         NEAR_PLANE, FAR_PLANE);
+
+    PointLight &anglerfishPointLight = packet.anglerfishPointLight;
+    anglerfishPointLight = input.anglerfishPointLight;
+    if (input.blink) {
+        anglerfishPointLight.ambient = glm::vec3(0.1f + 0.0005f*cos(currentFrame));
+        anglerfishPointLight.diffuse = glm::vec3(0.2f + 0.02f*tan(200*currentFrame));
+        anglerfishPointLight.specular = glm::vec3(0.005f*(1/tan(100*currentFrame)));
+    }
+
+    PointLight &jellyfishPointLight = packet.jellyfishPointLight;
+    jellyfishPointLight = input.jellyfishPointLight;
+    switch (input.jellyfishColor) {
+        case 0:
+            jellyfishPointLight.ambient = glm::vec3(0.3, 0.1, 0.1);
+            jellyfishPointLight.diffuse = glm::vec3(1.0, 0.6, 0.6);
+            break;
+        case 1:
+            jellyfishPointLight.ambient = glm::vec3(0.1, 0.3, 0.1);
+            jellyfishPointLight.diffuse = glm::vec3(0.6, 1.0, 0.6);
+            break;
+        case 2:
+            jellyfishPointLight.ambient = glm::vec3(0.1, 0.1, 0.3);
+            jellyfishPointLight.diffuse = glm::vec3(0.6, 0.6, 1.0);
+            break;
+    }
+    //light inside of jellyfish moves as jellyfish moves
+    jellyfishPointLight.position = glm::vec3(-15.0f, 4.0f + 4*sin(0.5*currentFrame), -5.0f);
+
+    packet.dirLight = input.dirLight;
+    packet.spotLight = input.spotLight;
+
+    // the debris where the bodies are between the last two steps, or where it lies
+    auto placeDebris = [alpha](Debris object) {
+        if (debris.Count() == 0) {
+            return debrisPlacement(object);
+        }
+        return debris.Transform(object, alpha) * debrisOffsets[object];
+    };
+    packet.rainedBarrels.clear();
+    for (int i = DEBRIS_COUNT; i < debris.Count(); ++i) {
+        packet.rainedBarrels.push_back(debris.Transform(i, alpha) * debrisOffsets[i]);
+    }
+
+    // metal box
+    glm::mat4 model = placeDebris(DEBRIS_BOX);
+    packet.boxModel = model;
+
+    // the draw list keeps its capacity from frame to frame
+    packet.models.clear();
+
+    //submarine
+    model = glm::mat4(1.0f);
+    model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
+    model = glm::scale(model, glm::vec3(2.0f));
+    packet.models.push_back({MODEL_SUBMARINE, model});
+
+    // bubbles stream from two points either side of the end of the submarine's longest axis
+    glm::vec3 submarineMin = input.boundsMin[MODEL_SUBMARINE], submarineMax = input.boundsMax[MODEL_SUBMARINE];
+    glm::vec3 submarineSize = submarineMax - submarineMin;
+    int length = submarineSize.x >= submarineSize.y && submarineSize.x >= submarineSize.z ? 0
+                 : submarineSize.y >= submarineSize.z ? 1 : 2;
+    glm::vec3 stern = 0.5f * (submarineMin + submarineMax);
+    stern[length] = submarineMin[length];
+    glm::vec3 side(0.0f);
+    side[(length + 1) % 3] = 0.15f * submarineSize[(length + 1) % 3];
+    packet.bubbleSources[0] = glm::vec3(model * glm::vec4(stern + side, 1.0f));
+    packet.bubbleSources[1] = glm::vec3(model * glm::vec4(stern - side, 1.0f));
+
+    // the fish and the shark swim in model.vs (modelSwims), their placement never changes and only
+    // bobs up and down
+    static const glm::mat4 fishPlacement = glm::scale(
+            glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, 5.0f, 10.0f)), glm::radians(-90.0f),
+                        glm::vec3(1.0f, 0.0f, 0.0f)), glm::vec3(0.7f));
+    static const glm::mat4 fish2Placement = glm::scale(
+            glm::rotate(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(8.0f, 2.0f, 15.0f)),
+                                    glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+                        glm::radians(10.0f), glm::vec3(0.0f, 0.0f, 1.0f)), glm::vec3(0.8f));
+    static const glm::mat4 sharkPlacement = glm::rotate(
+            glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, 10.0f, 20.0f)), glm::radians(-5.0f),
+            glm::vec3(1.0f, 0.0f, 0.0f));
+
+    //fish
+    model = fishPlacement;
+    model[3].y += 0.1f * cos(currentFrame);
+    packet.models.push_back({MODEL_FISH, model});
+
+    //fish2
+    model = fish2Placement;
+    model[3].y += 0.5f * cos(currentFrame);
+    packet.models.push_back({MODEL_FISH2, model});
+
+    //jellyfish
+    model = jellyfishTransform(currentFrame);
+    packet.models.push_back({MODEL_JELLYFISH, model, -1, jellyfishPulse.Sample(currentFrame)});
+
+    //shark
+    model = sharkPlacement;
+    model[3].y += 0.8f * sin(0.2f * currentFrame);
+    packet.models.push_back({MODEL_SHARK, model});
+
+    //anglerfish
+    model = glm::mat4(1.0f);
+    model = glm::translate(model,glm::vec3(0.0f, -3.0f, 70.0f));
+    model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
+    model = glm::scale(model, glm::vec3(0.1f));
+    packet.models.push_back({MODEL_ANGLERFISH, model});
+
+    //seashell
+    model = placeDebris(DEBRIS_SEASHELL);
+    packet.models.push_back({MODEL_SEASHELL, model});
+
+    //barrels
+    model = placeDebris(DEBRIS_BARRELS);
+    packet.models.push_back({MODEL_BARRELS, model});
+
+    // parallax-mapped quad
+    model = placeDebris(DEBRIS_QUAD);
+    packet.quadModel = model;
+
+    // seaweed
+    model = placeDebris(DEBRIS_SEAWEED);
+    packet.seaweedModel = model;
+
+    // skinned models get their pose at the same time, the palettes keep their capacity as well
+    packet.bonePalettes.clear();
+    int slots = 0;
+    for (ModelDraw &draw : packet.models) {
+        const rg::Skeleton *skeleton = input.skeletons[draw.model].get();
+        if (!skeleton) {
+            continue;
+        }
+        draw.boneSlot = slots++;
+        packet.bonePalettes.resize(slots * rg::MAX_BONES);
+        int clip = skeleton->FindClip(modelClips[draw.model]);
+        glm::mat4 *palette = &packet.bonePalettes[draw.boneSlot * rg::MAX_BONES];
+        if (clip < 0) {
+            poseEvaluator.Evaluate(*skeleton, palette);
+        } else {
+            poseEvaluator.Evaluate(*skeleton, skeleton->compressedClips[clip], clipCursors[draw.model], currentFrame,
+                                   palette);
+        }
+    }
+}
+
+void setShaderLights(Shader &shader, const FramePacket &packet){
+    shader.setVec3("pointLights[0].position", packet.jellyfishPointLight.position);
+    shader.setVec3("pointLights[0].ambient", packet.jellyfishPointLight.ambient);
+    shader.setVec3("pointLights[0].diffuse", packet.jellyfishPointLight.diffuse);
+    shader.setVec3("pointLights[0].specular", packet.jellyfishPointLight.specular);
+    shader.setFloat("pointLights[0].constant", packet.jellyfishPointLight.constant);
+    shader.setFloat("pointLights[0].linear", packet.jellyfishPointLight.linear);
+    shader.setFloat("pointLights[0].quadratic", packet.jellyfishPointLight.quadratic);
+
+    shader.setVec3("pointLights[1].position", packet.anglerfishPointLight.position);
+    shader.setVec3("pointLights[1].ambient", packet.anglerfishPointLight.ambient);
+    shader.setVec3("pointLights[1].diffuse", packet.anglerfishPointLight.diffuse);
+    shader.setVec3("pointLights[1].specular", packet.anglerfishPointLight.specular);
+    shader.setFloat("pointLights[1].constant", packet.anglerfishPointLight.constant);
+    shader.setFloat("pointLights[1].linear", packet.anglerfishPointLight.linear);
+    shader.setFloat("pointLights[1].quadratic", packet.anglerfishPointLight.quadratic);
+
+    shader.setVec3("viewPosition", packet.cameraPosition);
     shader.setFloat("material.shininess", 128.0f);  //32
 
-    shader.setVec3("dirLight.direction", programState->dirLight.direction);
-    shader.setVec3("dirLight.ambient", programState->dirLight.ambient);
-    shader.setVec3("dirLight.diffuse", programState->dirLight.diffuse);
-    shader.setVec3("dirLight.specular", programState->dirLight.specular);
-
-    shader.setVec3("spotLight.position",programState->camera.Position);
-    shader.setVec3("spotLight.direction", programState->camera.Front);
-    shader.setVec3("spotLight.ambient", programState->spotLight.ambient);
-    shader.setVec3("spotLight.diffuse", programState->spotLight.diffuse);
-    shader.setVec3("spotLight.specular", programState->spotLight.specular);
-    shader.setFloat("spotLight.constant", programState->spotLight.constant);
-    shader.setFloat("spotLight.linear", programState->spotLight.linear);
-    shader.setFloat("spotLight.quadratic", programState->spotLight.quadratic);
-    shader.setFloat("spotLight.cutOff", programState->spotLight.cutOff);
-    shader.setFloat("spotLight.outerCutOff", programState->spotLight.outerCutOff);
-
-}
\ No newline at end of file
+    shader.setVec3("dirLight.direction", packet.dirLight.direction);
+    shader.setVec3("dirLight.ambient", packet.dirLight.ambient);
+    shader.setVec3("dirLight.diffuse", packet.dirLight.diffuse);
+    shader.setVec3("dirLight.specular", packet.dirLight.specular);
+
+    shader.setVec3("spotLight.position",packet.cameraPosition);
+    shader.setVec3("spotLight.direction", packet.cameraFront);
+    shader.setVec3("spotLight.ambient", packet.spotLight.ambient);
+    shader.setVec3("spotLight.diffuse", packet.spotLight.diffuse);
+    shader.setVec3("spotLight.specular", packet.spotLight.specular);
+    shader.setFloat("spotLight.constant", packet.spotLight.constant);
+    shader.setFloat("spotLight.linear", packet.spotLight.linear);
+    shader.setFloat("spotLight.quadratic", packet.spotLight.quadratic);
+    shader.setFloat("spotLight.cutOff", packet.spotLight.cutOff);
+    shader.setFloat("spotLight.outerCutOff", packet.spotLight.outerCutOff);
+
+}
+
+// pixels covered on screen by the radius of a model space bounding sphere
+float screenSize(const glm::mat4 &model, glm::vec3 center, float radius) {
+    glm::vec3 worldCenter;
+    float worldRadius;
+    rg::transformBoundingSphere(model, center, radius, worldCenter, worldRadius);
+    return rg::projectedScreenSize(worldCenter, worldRadius, renderPacket->cameraPosition,
+                                   glm::radians(renderPacket->cameraZoom), renderHeight);
+}
+
+// picks the shading level for an object from the screen size of its model space bounding sphere
+rg::ShadingLod selectShadingLod(rg::ShadingLodSelector &lodSelector, const glm::mat4 &model, glm::vec3 center,
+                                float radius) {
+    return lodSelector.Update(screenSize(model, center, radius));
+}
+
+// draws a model with the shader variant matching its current shading level,
+// nothing is drawn for models whose world cell isn't loaded
+// the model's name labels the draw in the frame profiler
+// and with the mesh level of detail its error on screen allows, meshLod holds the one it was drawn at
+void drawModel(const ModelDraw &draw, Model *modelToDraw, Shader *shaders[], rg::ShadingLodSelector &lodSelector,
+               int &meshLod) {
+    const char *name = modelNames[draw.model];
+    const glm::mat4 &model = draw.transform;
+    if (!modelToDraw) {
+        return;
+    }
+    rg::ProfileZone zone(name);
+    rg::GpuZone gpuZone(*gpuTimers, name, "models");
+    if (!modelToDraw->Ready()) {
+        drawPlaceholder(*shaders[rg::SHADING_LOD_NEAR], model);
+        return;
+    }
+    float size = screenSize(model, modelToDraw->BoundingCenter(), modelToDraw->BoundingRadius());
+    textureStreamer->Request(*modelToDraw, size);
+    Shader *lodShader = shaders[lodSelector.Update(size)];
+    // the cheaper programs may still be compiling during startup, the near one is always ready
+    Shader &shader = rg::pipelinePending(pendingWarmups, lodShader) ? *shaders[rg::SHADING_LOD_NEAR] : *lodShader;
+    shader.use();
+    shader.setMat4("model", model);
+    shader.setBool("skinned", draw.boneSlot >= 0);
+    if (draw.boneSlot >= 0) {
+        boneBuffer->Bind(draw.boneSlot);
+    }
+    modelSwimBodies[draw.model].SetUniforms(shader, *modelToDraw);
+    modelSwims[draw.model].Set();
+    rg::setMorphWeights(draw.morphWeights);
+    meshLod = meshLodSelector.Select(meshLod, model, modelToDraw->BoundingCenter(), modelToDraw->BoundingRadius(),
+                                     modelToDraw->lodErrors);
+    modelToDraw->Draw(shader, meshLod);
+    frameTriangles += modelToDraw->Triangles(meshLod);
+}
+
+// a grey unit cube at the model's transform
+void drawPlaceholder(Shader &shader, const glm::mat4 &model) {
+    shader.use();
+    shader.setMat4("model", model);
+    shader.setBool("skinned", false);
+    shader.setBool("morphed", false);
+    rg::SwimBody::Disable(shader);
+    shader.setInt("material.texture_diffuse1", 0);
+    shader.setInt("material.texture_specular1", 1);
+    for (unsigned int unit = 0; unit < 2; unit++) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, placeholderTextureArray);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    // the placeholder has no layer attribute, its constant default (0, 0) selects layer 0
+    glBindVertexArray(placeholderVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glBindVertexArray(0);
+}
+
+// texture keeps its current (placeholder) value until the upload on the loader thread is complete,
+// and for good if the file can't be loaded
+void loadTextureAsync(rg::AssetLoader &loader, const std::string &path, bool flipVertically, unsigned int &texture) {
+    std::shared_ptr<unsigned int> loaded = std::make_shared<unsigned int>(0);
+    loader.Submit([path, flipVertically, loaded]() {
+                      stbi_set_flip_vertically_on_load(flipVertically);
+                      *loaded = loadTexture(path.c_str());
+                  },
+                  [&texture, loaded]() {
+                      if (*loaded)
+                          texture = *loaded;
+                  });
+}
+
+// The jellyfish's pulse as morph targets, in its model space where z is up: the bell above the arms
+// contracts, its rim the most, while the dome rises; the arms hanging below stream down behind the
+// stroke and sway to the side. Runs on the loader thread for every load.
+void bakeJellyfishPulse(Model &model) {
+    // 1 at the tips of the arms, 0 where they leave the bell
+    auto arms = [](float z) { return 1.0f - glm::smoothstep(2.0f, 36.0f, z); };
+    model.SetMorphTargets({
+            model.BakeMorphTarget("contract", [](glm::vec3 p) {
+                float squeeze = 0.25f * glm::smoothstep(30.0f, 37.0f, p.z)
+                              * (1.0f - 0.6f * glm::smoothstep(38.0f, 44.0f, p.z));
+                return glm::vec3(-squeeze * p.x, -squeeze * p.y, 1.5f * glm::smoothstep(34.0f, 44.0f, p.z));
+            }),
+            model.BakeMorphTarget("trail", [&arms](glm::vec3 p) {
+                float along = arms(p.z);
+                return glm::vec3(-0.15f * along * p.x, -0.15f * along * p.y, -3.0f * along);
+            }),
+            model.BakeMorphTarget("sway", [&arms](glm::vec3 p) {
+                float along = arms(p.z);
+                return glm::vec3(1.5f, 0.8f, 0.0f) * (along * along);
+            })
+    });
+}
+
+glm::mat4 jellyfishTransform(float time) {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model,glm::vec3(-15.0f, 4.0f + 4*sin(0.5*time), -5.0f));
+    model = glm::rotate(model, glm::radians(-100.0f), glm::vec3(1.0, 0.0, 0.0));
+    model = glm::rotate(model, glm::radians(-10.0f), glm::vec3(0.0, 1.0, 0.0));
+    model = glm::rotate(model, glm::radians(-20.0f), glm::vec3(0.0, 0.0, 1.0));
+    model = glm::scale(model, glm::vec3(0.2f));
+    return model;
+}
+
+// where the tentacles hang from in world space: a ring just inside the rim of the bell, at z = 36.5 in the
+// jellyfish's model space, pulled in as the bell contracts (see bakeJellyfishPulse)
+void tentacleAnchors(float time, std::vector<glm::vec3> &anchors) {
+    glm::mat4 model = jellyfishTransform(time);
+    float radius = 7.5f * (1.0f - 0.25f * jellyfishPulse.Sample(time).x);
+    anchors.resize(TENTACLE_COUNT);
+    for (int i = 0; i < TENTACLE_COUNT; ++i) {
+        float angle = 6.2831853f * i / TENTACLE_COUNT;
+        anchors[i] = glm::vec3(model * glm::vec4(radius * cos(angle), radius * sin(angle), 36.5f, 1.0f));
+    }
+}
+
+// uploads the strips of particles vertices each into a new region of stream and draws them as line strips
+void drawTentacles(rg::StreamBuffer &stream, rg::StreamMode mode, unsigned int vao,
+                   const std::vector<glm::vec4> &vertices, int particles) {
+    if (vertices.empty() || particles <= 0) {
+        return;
+    }
+    GLintptr offset = stream.Upload(vertices.data(), vertices.size() * sizeof(glm::vec4), mode);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.Buffer());
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *) offset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // the strips only change when the tentacles do, render thread only
+    static std::vector<GLint> firsts;
+    static std::vector<GLsizei> counts;
+    int strips = (int) (vertices.size() / particles);
+    if ((int) firsts.size() != strips || (strips > 0 && counts[0] != particles)) {
+        firsts.resize(strips);
+        counts.assign(strips, particles);
+        for (int i = 0; i < strips; ++i) {
+            firsts[i] = i * particles;
+        }
+    }
+    glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(), strips);
+    glBindVertexArray(0);
+}
+
+// The tentacles are our test case for dynamic geometry: tentacleCount of them hang from a grid of roots
+// bobbing out of step, and for each stream mode 600 steps are simulated, interpolated, uploaded and drawn.
+// Every frame is presented and waited for, with the swap interval at 0 so the display's refresh doesn't
+// hold it back. Reports particles per millisecond of each stage, the upload bandwidth and the frame times.
+int runTentacleBenchmark(GLFWwindow *window, Shader &shader, int tentacleCount) {
+    const int FRAMES = 600;
+    int side = (int) std::ceil(std::sqrt((float) tentacleCount));
+    std::vector<glm::vec3> roots(tentacleCount);
+    auto placeRoots = [&roots, side](float time) {
+        for (int i = 0; i < (int) roots.size(); ++i) {
+            roots[i] = glm::vec3((i % side) * 0.5f, 2.0f * sin(time + 0.1f * i), (i / side) * 0.5f);
+        }
+    };
+
+    unsigned int vao;
+    glGenVertexArrays(1, &vao);
+    rg::warmUpPipelines({{&shader, vao, false, false, GL_LESS, nullptr}});
+    glDisable(GL_CULL_FACE);
+    float extent = side * 0.5f;
+    shader.use();
+    shader.setMat4("projection", glm::perspective(glm::radians(45.0f), (float) SCR_WIDTH / (float) SCR_HEIGHT,
+                                                  0.1f, 4.0f * extent + 40.0f));
+    shader.setMat4("view", glm::lookAt(glm::vec3(0.5f * extent, 0.5f * extent + 10.0f, 1.5f * extent + 20.0f),
+                                       glm::vec3(0.5f * extent, -5.0f, 0.5f * extent), glm::vec3(0.0f, 1.0f, 0.0f)));
+    shader.setVec3("lightPos", glm::vec3(0.5f * extent, 0.0f, 0.5f * extent));
+    shader.setVec3("lightColor", glm::vec3(0.6f, 0.6f, 1.0f));
+    glfwSwapInterval(0);
+
+    std::cout << "[Tentacles] " << tentacleCount << " x " << TENTACLE_PARTICLES << " particles, " << FRAMES
+              << " frames on " << workerPool->Threads() << " threads" << std::endl;
+    std::vector<glm::vec4> vertices;
+    for (rg::StreamMode mode : {rg::STREAM_ORPHAN, rg::STREAM_PERSISTENT}) {
+        const char *name = mode == rg::STREAM_ORPHAN ? "orphan" : "persistent";
+        if (mode == rg::STREAM_PERSISTENT && !rg::StreamBuffer::PersistentSupported()) {
+            std::cout << "[Tentacles] " << name << ": not supported" << std::endl;
+            continue;
+        }
+        rg::TentacleSimulation simulation;
+        placeRoots(0.0f);
+        simulation.Reset(roots, TENTACLE_PARTICLES, TENTACLE_SEGMENT);
+        rg::StreamBuffer stream("tentacle benchmark vertices");
+        double interpolateSeconds = 0.0;
+        double totalMs = 0.0, maxMs = 0.0;
+        for (int frame = 1; frame <= FRAMES; ++frame) {
+            auto start = std::chrono::steady_clock::now();
+            float time = (float) (frame * SIMULATION_STEP);
+            placeRoots(time);
+            simulation.Step((float) SIMULATION_STEP, time, roots, *workerPool);
+            auto interpolateStart = std::chrono::steady_clock::now();
+            simulation.Interpolate(0.5f, vertices, *workerPool);
+            interpolateSeconds += rg::millisecondsSince(interpolateStart) / 1000.0;
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            drawTentacles(stream, mode, vao, vertices, TENTACLE_PARTICLES);
+            glfwSwapBuffers(window);
+            glFinish();
+            double ms = rg::millisecondsSince(start);
+            totalMs += ms;
+            maxMs = std::max(maxMs, ms);
+        }
+        double particles = (double) simulation.Particles() * FRAMES;
+        std::cout << "[Tentacles] " << name << ": step " << particles / (simulation.StepSeconds() * 1000.0)
+                  << " particles/ms, interpolate " << particles / (interpolateSeconds * 1000.0)
+                  << " particles/ms, upload " << stream.UploadedBytes() / stream.UploadSeconds() / 1e6 << " MB/s ("
+                  << stream.Waits() << " waits), " << totalMs / FRAMES << " ms per presented frame, " << maxMs
+                  << " ms at most" << std::endl;
+        stream.Release();
+    }
+    glDeleteVertexArrays(1, &vao);
+    glEnable(GL_CULL_FACE);
+    return 0;
+}
+
+double debrisStepMs(const rg::RigidBodyWorld::Stats &stats) {
+    return stats.broadphaseMs + stats.narrowphaseMs + stats.solveMs;
+}
+
+// The debris stress test: barrels as big as the barrels model's bounds at BARREL_RAIN_SCALE rain onto the
+// seabed at the rate of the scene until there are barrels of them, and are simulated until every one of
+// them sleeps or two simulated minutes are up. Reports each simulated second, and how many steps took
+// longer than DEBRIS_BUDGET_MS, past which the scene would hold the rain; here it never holds, so the
+// load is the same on any machine. Runs once on the calling thread alone and once on the whole worker
+// pool, the same rain both times, to show how far the steps scale with the threads.
+int runDebrisBenchmark(int barrels) {
+    const int MAX_STEPS = 120 * 60;
+    // only the meshes are imported, for their bounds
+    Model barrelsModel;
+    barrelsModel.Load(BARRELS_MODEL);
+    if (barrelsModel.meshes.empty()) {
+        return 1;
+    }
+    rg::WorkerPool callerOnly(0);
+    std::vector<rg::WorkerPool *> pools = {&callerOnly};
+    if (workerPool->Threads() > 1) {
+        pools.push_back(workerPool);
+    }
+    double averageMs[2];
+    for (size_t pass = 0; pass < pools.size(); ++pass) {
+        rg::WorkerPool &pool = *pools[pass];
+        rg::RigidBodyWorld world;
+        std::vector<glm::mat4> offsets;
+        std::mt19937 random(59);
+        std::cout << "[Debris] " << barrels << " barrels on " << pool.Threads() << " threads" << std::endl;
+        double totalMs = 0.0, maxMs = 0.0;
+        int overBudget = 0;
+        rg::RigidBodyWorld::Stats second;
+        int step = 0;
+        for (; step < MAX_STEPS; ++step) {
+            int rain = std::min(barrels - world.Count(), BARREL_RAIN_PER_STEP);
+            if (rain > 0) {
+                rainBarrels(world, offsets, random, barrelsModel.boundsMin, barrelsModel.boundsMax, rain);
+            }
+            auto start = std::chrono::steady_clock::now();
+            world.Step((float) SIMULATION_STEP, pool);
+            double ms = rg::millisecondsSince(start);
+            totalMs += ms;
+            maxMs = std::max(maxMs, ms);
+            overBudget += ms > DEBRIS_BUDGET_MS;
+            const rg::RigidBodyWorld::Stats &stats = world.LastStep();
+            second.broadphaseMs += stats.broadphaseMs;
+            second.narrowphaseMs += stats.narrowphaseMs;
+            second.solveMs += stats.solveMs;
+            bool settled = world.Count() == barrels && stats.awake == 0;
+            if ((step + 1) % 60 == 0 || settled) {
+                int steps = step % 60 + 1;
+                std::cout << "[Debris] " << (step + 1) / 60.0 << " s: " << stats.bodies << " bodies, " << stats.awake
+                          << " awake in " << stats.islands << " islands (largest " << stats.largestIsland << "), "
+                          << stats.pairs << " pairs, " << stats.contacts << " contacts; broadphase "
+                          << second.broadphaseMs / steps << " ms, narrowphase " << second.narrowphaseMs / steps
+                          << " ms, solve " << second.solveMs / steps << " ms per step" << std::endl;
+                second = rg::RigidBodyWorld::Stats();
+            }
+            if (settled) {
+                step++;
+                break;
+            }
+        }
+        averageMs[pass] = totalMs / step;
+        std::cout << "[Debris] " << (step == MAX_STEPS ? "still moving" : "all asleep") << " after " << step / 60.0
+                  << " s, " << averageMs[pass] << " ms per step on average, " << maxMs << " ms at most, "
+                  << overBudget << " steps over the " << DEBRIS_BUDGET_MS << " ms budget" << std::endl;
+    }
+    if (pools.size() > 1) {
+        std::cout << "[Debris] " << averageMs[0] / averageMs[1] << "x faster on " << workerPool->Threads()
+                  << " threads than on one" << std::endl;
+    }
+    return 0;
+}
+
+// The particles at the scale they are meant to hold: particleCount of them, nine tenths marine snow and
+// the rest bubbles and sediment kicked up by an impact every half second, simulated and drawn for 600
+// frames into a scene target the camera looks down into. Reports the milliseconds per frame of the
+// update and of the draw, each waited for on its own.
+int runParticleBenchmark(Shader &updateShader, Shader &shader, int particleCount) {
+    const int FRAMES = 600;
+    unsigned int vao;
+    glGenVertexArrays(1, &vao);
+    rg::warmUpPipelines({{&updateShader, vao, false, false, GL_LESS, nullptr},
+                         {&shader, vao, false, false, GL_LESS, [&shader]() { rg::ParticleSystem::SetSamplers(shader); }}});
+    rg::ScaledRenderTarget target;
+    target.Resize(SCR_WIDTH, SCR_HEIGHT);
+    target.Bind(1.0f);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    target.CopyDepth();
+
+    rg::ParticleSystem particles("particle benchmark");
+    int snow = particleCount * 9 / 10;
+    int bubbles = (particleCount - snow) / 2;
+    particles.SetCounts(snow, bubbles, particleCount - snow - bubbles);
+    rg::ParticleEmitters emitters;
+    emitters.cameraPosition = glm::vec3(0.0f, -10.0f, 25.0f);
+    emitters.bubbleSources[0] = glm::vec3(-1.0f, -15.0f, 0.0f);
+    emitters.bubbleSources[1] = glm::vec3(1.0f, -15.0f, 0.0f);
+    shader.use();
+    shader.setMat4("projection", glm::perspective(glm::radians(45.0f), (float) SCR_WIDTH / (float) SCR_HEIGHT,
+                                                  NEAR_PLANE, FAR_PLANE));
+    shader.setMat4("view", glm::lookAt(emitters.cameraPosition, glm::vec3(0.0f, -18.0f, 0.0f),
+                                       glm::vec3(0.0f, 1.0f, 0.0f)));
+    shader.setVec3("cameraPosition", emitters.cameraPosition);
+    shader.setVec3("snowBox", emitters.snowBox);
+    shader.setVec3("dirLight.ambient", glm::vec3(0.2f));
+    shader.setVec3("dirLight.diffuse", glm::vec3(0.4f));
+    // the other lights stay dark, but their attenuation has to be defined
+    shader.setFloat("pointLights[0].constant", 1.0f);
+    shader.setFloat("pointLights[1].constant", 1.0f);
+    shader.setFloat("spotLight.constant", 1.0f);
+    shader.setFloat("spotLight.cutOff", 1.0f);
+
+    std::cout << "[Particles] " << snow << " snow, " << bubbles << " bubbles, " << particleCount - snow - bubbles
+              << " sediment, " << FRAMES << " frames" << std::endl;
+    std::mt19937 random(61);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    double updateMs = 0.0, drawMs = 0.0;
+    for (int frame = 0; frame < FRAMES; ++frame) {
+        float time = (float) (frame * SIMULATION_STEP);
+        emitters.impacts.clear();
+        if (frame % 30 == 0) {
+            emitters.impacts.push_back(glm::vec4(10.0f * unit(random), emitters.seabedHeight, 10.0f * unit(random),
+                                                 5.0f));
+        }
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        particles.Update(updateShader, emitters, (float) SIMULATION_STEP, time);
+        glFinish();
+        updateMs += rg::millisecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        glClear(GL_COLOR_BUFFER_BIT);
+        shader.use();
+        particles.Draw(shader, target.DepthTexture(), glm::vec2(1.0f / target.Width(), 1.0f / target.Height()),
+                       NEAR_PLANE, FAR_PLANE);
+        glFinish();
+        drawMs += rg::millisecondsSince(start);
+    }
+    std::cout << "[Particles] " << particleCount << " particles: update " << updateMs / FRAMES << " ms, draw "
+              << drawMs / FRAMES << " ms per frame" << std::endl;
+    particles.Release();
+    target.Release();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteVertexArrays(1, &vao);
+    return 0;
+}